@@ -10,6 +10,8 @@
 #include <cctype>
 #include <dirent.h>
 #include <ctime>
+#include <chrono>
+#include <thread>
 #ifdef __linux__
 #include <cerrno>
 #endif
@@ -17,18 +19,53 @@
 #include "SystemErrorHandlers.h"
 #include "Stack.h"
 #include "List.h"
+#include "Instruction.h"
+#include "CallFrame.h"
+#include "JumpTable.h"
+#include "CodeImage.h"
+#include "Value.h"
+#include "NumericArray.h"
 #include "BinaryFileReader.h"
 #include "JsonParser.h"
 
 
-/// \desc TICKS are every 1/10th of a second.
-#define TICKS_PER_SECOND 100
+/// \desc Default on tick rate, TICKS are every 1/10th of a second.
+#define TICKS_PER_SECOND 10
+
+/// \desc Default number of jumps and calls run between checks of the on tick timer.
+#define EVENT_CHECK_INTERVAL 1024
+
+/// \desc The direct threaded dispatch engine needs the labels as values extension which is only
+///       available with GCC and Clang. Other compilers always use the switch dispatch engine.
+#if defined(__GNUC__) || defined(__clang__)
+#define THREADED_DISPATCH 1
+#endif
+
+/// \desc Number of times a quickened instruction can fall back to its generic instruction
+///       before the CPU stops quickening it.
+#define MAX_DEOPTIMIZATIONS 4
+
+/// \desc Default maximum number of nested script function calls.
+#define DEFAULT_MAX_CALL_DEPTH 10000
+
+/// \desc Parameter stack slots kept free above the verified maximum stack growth for the values
+///       built in functions push while they run.
+#define STACK_RESERVE 8
 
 /// \desc The CPU class forms a software CPU runtime engine for a compiled program. The CPU
 ///       reads a serialized set if intermediate language instructions consisting of an
 ///       opcode and any data needed by the opcode to perform its function. The deserialized
 ///       instructions are stored in an instructions list which is then executed in a manner
 ///       similar to how a hardware CPU would run.
+/// \remark Thread safety: all run time state, the registers, the parameter stack, the error
+///         code and message, the native function parameter count and the random number
+///         generator, belongs to the CPU object. Any number of CPUs can run at the same time
+///         as long as each CPU is only used by one thread at a time. Init, Run and RunComponent
+///         make the CPU the current CPU of the calling thread, run time errors raised by
+///         DslValue and the containers while they run are sent to it. The compiler, the lexer,
+///         the parser and the data in ParseData.h, is not thread safe and must not run while
+///         CPUs are running. Globals the CPU reads, such as traceInfoLevel, must be set before
+///         the first CPU starts.
 class CPU
 {
 public:
@@ -39,6 +76,18 @@ public:
     ~CPU()
     {
         delete A;
+        for(int64_t ii=0; ii<boxes.Count(); ++ii)
+        {
+            delete boxes[ii];
+        }
+        for(int64_t ii=0; ii<globals.Count(); ++ii)
+        {
+            delete globals[ii];
+        }
+        if ( image != nullptr )
+        {
+            image->Release();
+        }
     }
 
     /// \desc Raises an error which puts the cpu into error mode
@@ -46,12 +95,24 @@ public:
     ///       present. If an error handler for the current
     ///       module is not present the default error handler is
     ///       called.
+    /// \remark The error is raised on the current CPU of the calling thread, if no CPU is
+    ///         running on the thread the error message is printed.
     static void RaiseError(int64_t errorId, const char *msg)
     {
-        errorCode = errorId;
-        szErrorMsg.CopyFromCString(msg);
+        CPU *cpu = current;
+        if ( cpu == nullptr )
+        {
+            printf("%s", msg);
+            return;
+        }
+        cpu->errorCode = errorId;
+        cpu->szErrorMsg.CopyFromCString(msg);
+        cpu->interruptPending = true;
     }
 
+    /// \desc CPU that is running on this thread, nullptr if none.
+    static thread_local CPU *current;
+
     /// \desc Displays the lines of code in the program.
     /// \param programInstructions list of dsl values containing the compiled program.
     static void DisplayASMCodeLines(List<DslValue *> &programInstructions);
@@ -61,6 +122,14 @@ public:
     /// \param symFile Pointer to u8String containing the full path name to the symbol file name.
     bool Init(U8String *ilFile, U8String *symFile);
 
+    /// \desc Initializes the CPU to run a program already loaded by another CPU. The CPU shares
+    ///       the other CPU's code image and only creates its own global variables.
+    /// \param codeImage Code image of the program, see Image.
+    bool Init(CodeImage *codeImage);
+
+    /// \desc Gets the code image of the loaded program so other CPUs can run it.
+    CodeImage *Image() { return image; }
+
     /// \desc Runs the compiled program.
     bool Run();
 
@@ -70,8 +139,25 @@ public:
     ///         will be fixed shortly.
     bool RunComponent(U8String *function);
 
+    /// \desc Runs a component found with FindComponent.
+    /// \param component Index of the component in the program.
+    /// \returns True if the component exists and was called.
+    bool RunComponent(int64_t component);
+
+    /// \desc Finds the component that runs a function so it can be run without looking it up
+    ///       again. Components are found by hash so this does not depend on their number.
+    /// \param function Pointer to a U8String that names the component's function.
+    /// \returns Index of the component or -1 if no component runs the function.
+    int64_t FindComponent(U8String *function);
+
+    /// \desc Finds a global variable of the program by its full name.
+    /// \param name Full name of the variable, for example TMScriptScope.script.result.
+    /// \return The variable or nullptr if the program does not define it.
+    DslValue *FindVariable(const char *name);
+
     /// \desc Gets a json formatted string that contains the component information for each
-    ///       component defined in the program.
+    ///       component defined in the program. The string is built the first time it is asked
+    ///       for and kept with the program until it is reloaded.
     void GetComponents(U8String &out);
 
     //for testing
@@ -81,12 +167,39 @@ public:
     /// \param addr address of the instruction to show.
     static int64_t DisplayASMCodeLine(List<DslValue *> &programInstructions, int64_t addr, bool newline = true);
 
+    /// \desc Displays the lines of code loaded in this CPU, fused instructions are shown as a single line.
+    void DisplayASMCodeLines();
+
+    /// \desc Displays an instruction loaded in this CPU, used for testing and debugging.
+    /// \param addr address of the instruction to show.
+    /// \return The address of the last instruction displayed, for fused instructions this is the
+    ///         last instruction of the fused sequence.
+    int64_t DisplayASMCodeLine(int64_t addr, bool newline = true);
+
     /// \desc built in array of function pointers. Order is same as lexers built in function names list.
     typedef void (CPU::*method_function)();
 
     /// \desc This list is the parameter stack used for calculations and parameter passing to string and
     ///       native functions.
-    List<DslValue> params;
+    List<Value> params;
+
+    /// \desc Number of parameters passed to the running native function, -1 when no native
+    ///       function has opened the parameter stack.
+    int64_t totalParameters;
+
+    /// \desc Gets the DslValue that holds the data of a parameter stack slot with the slot's current
+    ///       value written into it. Built in functions and DslValue operators work on this DslValue.
+    /// \param slot Index of the slot in the parameter stack.
+    DslValue *SlotValue(int64_t slot);
+
+    /// \desc Reads the slot's DslValue back into the slot after an operation changed it.
+    /// \param slot Index of the slot in the parameter stack.
+    void LoadSlot(int64_t slot);
+
+    /// \desc Sets a slot from a DslValue following the same rules as DslValue::LiteCopy.
+    /// \param slot Index of the slot in the parameter stack.
+    /// \param dslValue Value to copy into the slot.
+    void SetSlot(int64_t slot, DslValue *dslValue);
 
     /// \desc Contains the returned json string for the components defined in the program after
     ///       a call to get component info.
@@ -105,6 +218,47 @@ public:
     ///           within the current function or method in which it is used.
     DslValue *A;
 
+    /// \desc If true common instruction sequences are replaced with fused instructions when
+    ///       the program is loaded. Must be set before calling Init.
+    bool fuseInstructions;
+
+    /// \desc If true generic arithmetic and test instructions are rewritten into versions
+    ///       specialized for integer or double operands the first time they run with them.
+    bool quickenInstructions;
+
+    /// \desc If true the program is run with the direct threaded dispatch engine instead of the
+    ///       switch dispatch engine. Ignored when tracing or when the compiler does not support
+    ///       the threaded engine.
+    bool threadedDispatch;
+
+    /// \desc Maximum number of nested script function calls, calling a function when this many
+    ///       calls are active raises a run time error instead of running out of memory.
+    int64_t maxCallDepth;
+
+    /// \desc Number of jumps and calls run between checks of the on tick timer.
+    int64_t eventCheckInterval;
+
+    /// \desc Number of times the run loop stopped to check for events, used to measure the
+    ///       cost of event checking.
+    int64_t eventChecks;
+
+    /// \desc Number of on tick events per second of real or simulated time.
+    int64_t ticksPerSecond;
+
+    /// \desc When true on tick events are driven by a simulated clock instead of the real time
+    ///       clock. Each event check advances the simulated clock by one tick, the event checks
+    ///       happen after a fixed number of jumps and calls, so the ticks happen at the same
+    ///       points in the program on every run.
+    bool virtualTime;
+
+    /// \desc When true the simulated clock runs as fast as the program does, otherwise each tick
+    ///       waits until the same amount of real time has passed. Only used with virtualTime.
+    bool maxSpeed;
+
+    /// \desc Time in nanoseconds since the program was started, simulated time if virtualTime
+    ///       is set, otherwise the real time of the last tick.
+    int64_t simulatedTime;
+
 private:
     /// \desc Stack frame for local variables defined, passed and used within DSL function calls.
     int64_t BP;
@@ -112,8 +266,15 @@ private:
     /// \desc Instruction pointer, always points at the next instruction to be executed.
     int64_t PC;
 
-    /// \desc Time at which the next on tick event call should occur.
-    long nextTick;
+    /// \desc Time on the monotonic clock, in nanoseconds, at which the next on tick event call
+    ///       should occur.
+    int64_t nextTick;
+
+    /// \desc Time on the monotonic clock, in nanoseconds, at which the program was started.
+    int64_t clockStart;
+
+    /// \desc Jumps and calls left to run before the on tick timer is checked.
+    int64_t eventBudget;
 
     /// \desc Module id of the last instruction to be executed.
     int64_t lastModuleId;
@@ -122,19 +283,94 @@ private:
     ///       before the instruction which has a different module id is executed.
     int64_t onTickEvent;
 
-    /// \desc Location of each component in the program.
-    List<int64_t> comInstAddr = {};
+    /// \desc Code of the program run by this CPU, possibly shared with other CPUs.
+    CodeImage *image;
+
+    /// \desc The image's code array, cached as it is used by every instruction.
+    Instruction *code;
+
+    /// \desc Number of instructions in the code array, not counting the END sentinel.
+    int64_t codeCount;
+
+    /// \desc This CPU's copy of each global variable of the program, indexed by the operand of
+    ///       the instructions that use the variable.
+    List<DslValue *> globals;
+
+    /// \desc Gets the global variable an instruction refers to.
+    /// \param instruction PSV, PVA, PCV, INC, DEC or DCS instruction.
+    inline DslValue *Global(Instruction *instruction)
+    {
+        return globals.At(instruction->operand);
+    }
+
+    /// \desc Gets the image's definition of the global variable an instruction refers to, the
+    ///       value the variable has when the program starts.
+    /// \param instruction PSV, PVA, PCV, INC, DEC or DCS instruction.
+    inline DslValue *Definition(Instruction *instruction)
+    {
+        return image->instructions[image->globalAddr[instruction->operand]];
+    }
+
+    /// \desc Creates this CPU's global variables from the image and sizes the parameter stack.
+    void AttachImage();
+
+    /// \desc Copies a global variable's definition, a collection shares its elements with the
+    ///       definition until it is changed.
+    /// \param variable DEF instruction to copy.
+    /// \return The new variable.
+    static DslValue *CopyGlobal(DslValue *variable);
+
+    /// \desc Largest top of stack that leaves the image's maxStack free slots in the parameter
+    ///       stack.
+    int64_t stackLimit;
+
+    /// \desc stackLimit if jumps check the stack, else the largest possible value.
+    int64_t jumpStackLimit;
+
+    /// \desc DslValue for each parameter stack slot that holds the data of strings, collections
+    ///       and other non scalar values in the slot, and the variable address set by the push
+    ///       variable address instruction. Created the first time the slot needs one.
+    List<DslValue *> boxes;
 
-    /// \desc This list contains the instructions that make up the program that is being executed by
-    ///       this CPU. Multiple CPUs can all be running programs at the same time without
-    ///       without conflicting with each other.
-    List<DslValue *> instructions = {};   //The deserialized program instructions to execute.
+    /// \desc Call frame for each active script function call.
+    List<CallFrame> frames;
+
+    /// \desc Number of call frames that belong to the run loop that called the running event
+    ///       handler. A RET with no frames above this ends the handler.
+    int64_t frameBase;
+
+    /// \desc Gets the DslValue for a parameter stack slot, creating it if needed.
+    /// \param slot Index of the slot in the parameter stack.
+    DslValue *Box(int64_t slot);
+
+    /// \desc Copies a slot into another slot following the same rules as DslValue::LiteCopy.
+    /// \param to Index of the slot to copy to.
+    /// \param from Index of the slot to copy from.
+    void CopySlot(int64_t to, int64_t from);
+
+    /// \desc Stores the value in a slot to a variable following the same rules as DslValue::SAV.
+    /// \param variable Variable or collection element to store to.
+    /// \param slot Index of the slot in the parameter stack.
+    void StoreSlot(DslValue *variable, int64_t slot);
+
+    /// \desc Runs a DslValue binary operator on the two values on the top of the parameter
+    ///       stack, leaving the result in place of the left value.
+    /// \param operation DslValue operator to run.
+    void StackOperation(void (DslValue::*operation)(DslValue *));
 
     /// \desc last error code that was raised.
-    static int64_t  errorCode;
+    int64_t  errorCode;
+
+    /// \desc Set when the run loop needs to stop before the next instruction, either because an
+    ///       error was raised or because it is time to check the on tick timer. This is the only
+    ///       thing the run loops test before each instruction.
+    bool interruptPending;
+
+    /// \desc State of the random number generator used by random and seed.
+    uint64_t randomState;
 
     /// \desc last error message that was raised.
-    static U8String szErrorMsg;
+    U8String szErrorMsg;
 
     /// \desc Reads a file current using the local file system. The file is returned
     ///       int the A dsl value. In case of an error the A dsl value will contain
@@ -211,8 +447,8 @@ private:
     static int64_t ExpressionLength(U8String *expression);
 
     /// \desc Ensures that the on tick event pointer is set to the correct module function.
-    /// \param dslValue Instruction about to be run.
-    void SetTickEvent(DslValue *dslValue);
+    /// \param instruction Instruction about to be run.
+    void SetTickEvent(Instruction *instruction);
 
     /// \desc Deserializes the program symbol file and adds those symbols to the
     ///       internal program.
@@ -226,38 +462,198 @@ private:
     void SetProgramLocationsAsSymbols();
 
     /// \desc Calls one of the standard built in functions.
-    void JumpToBuiltInFunction(DslValue *dslValue);
+    void JumpToBuiltInFunction(Instruction *instruction);
 
-    /// \desc Calls a script function.
-    /// \param dslValue Pointer to the dsl value containing the information needed to call script function.
-    void JumpToSubroutine(DslValue *dslValue);
+    /// \desc Calls a script function by pushing a call frame and jumping to it. When the call is
+    ///       directly followed by a RET and the caller's parameters are on top of the stack the
+    ///       caller's frame is reused instead.
+    /// \param instruction Pointer to the instruction containing the information needed to call script function.
+    void JumpToSubroutine(Instruction *instruction);
+
+    /// \desc Returns from a script function by popping its call frame.
+    /// \return True if the run loop continues with the caller, false if the RET ends the run loop.
+    bool ReturnFromSubroutine();
 
     /// \desc processes the switch jump instruction.
-    /// \param dslValue Pointer to the index containing the JTB opcode.
-    void ProcessJumpTable(DslValue *dslValue);
+    /// \param instruction Pointer to the JTB instruction.
+    void ProcessJumpTable(Instruction *instruction);
 
     /// \desc Reads a list of bytes and translates them into dsl value runnable instructions.
-    void DeSerializeIL(BinaryFileReader *binaryFileReader);
+    /// \return True if successful, false if the program is malformed.
+    bool DeSerializeIL(BinaryFileReader *binaryFileReader);
+
+    /// \desc Builds the dense code array from the deserialized instructions list.
+    void BuildInstructionStream();
+
+    /// \desc Builds the json description of the components returned by GetComponents.
+    /// \param out U8String that receives the json.
+    void BuildManifest(U8String &out);
+
+    /// \desc Gets the index in the image's globalAddr of the variable defined at addr, adding it
+    ///       the first time an instruction refers to it.
+    /// \param addr Location of the DEF instruction of the variable.
+    /// \param globalIndex Index assigned to each instruction, -1 if none yet.
+    /// \return The index or -1 if addr is outside the program.
+    int64_t GlobalIndex(int64_t addr, int64_t *globalIndex);
+
+    /// \desc Verifies the code array before it is fused. Rejects malformed instructions and
+    ///       programs that remove values from the stack below a function's frame, see
+    ///       VerifyStack.
+    /// \return True if the program can be run, false if it is malformed.
+    bool VerifyProgram();
+
+    /// \desc Walks the program and each function from its entry, the start of the program and
+    ///       the targets of JSR, EFI and COM instructions, and sets the image's frameDepth and
+    ///       maxStack.
+    /// \return False if an instruction can remove values below the stack of its function.
+    bool VerifyStack();
+
+    /// \desc Computes the largest depth of the parameter stack above the stack at a function's
+    ///       entry along any path through the function and checks that no path goes below it.
+    /// \param entry Location of the function's first instruction.
+    /// \param checkJumps True if jumps are stack checks, used when the depth is unbounded
+    ///        without them. The depth is then the growth between two stack checks.
+    /// \param lowest, highest, queued Work arrays of codeCount elements, set to INT64_MAX, -1 and
+    ///        false and returned that way.
+    /// \return The depth, -1 if it is unbounded or -2 if the function underflows its frame.
+    int64_t FrameDepth(int64_t entry, bool checkJumps, int64_t *lowest, int64_t *highest, bool *queued);
+
+    /// \desc Grows the parameter stack so there is room for depth more slots above top and
+    ///       moves the stack limits.
+    void GrowStack(int64_t depth);
+
+    /// \desc Stack check done when a function is entered, there must be room for the deepest
+    ///       the function's stack can get, the functions it calls check their own. The depth
+    ///       includes the program's local slots so every local of the frame is in the stack.
+    /// \param entry Location of the function's first instruction.
+    inline void CheckFrame(int64_t entry)
+    {
+        int64_t depth = image->frameDepth[entry];
+        if ( top + depth + STACK_RESERVE >= params.Size() )
+        {
+            GrowStack(depth);
+        }
+    }
+
+    /// \desc Stack check done by instructions whose change to the stack depends on the values
+    ///       they find at run time, such as PVA on a variable that became a collection.
+    inline void CheckStack()
+    {
+        if ( top > stackLimit )
+        {
+            GrowStack(image->maxStack);
+        }
+    }
+
+    /// \desc Stack check done by jump instructions, only needed when the program's stack growth
+    ///       could not be bounded without it.
+    inline void CheckJumpStack()
+    {
+        if ( top > jumpStackLimit )
+        {
+            GrowStack(image->maxStack);
+        }
+    }
+
+    /// \desc Counts a jump or call against the event budget, requesting an event check when
+    ///       the budget runs out. Every loop and recursion runs a jump or a call, so the timer is
+    ///       checked regularly without testing it on every instruction.
+    inline void CountBranch()
+    {
+        if ( --eventBudget < 0 )
+        {
+            interruptPending = true;
+        }
+    }
 
-    //Gets the position id for the event handler for the current script module.
-    static int64_t GetEventLocation(SystemErrorHandlers errorHandler, int64_t moduleId);
+    /// \desc Gets the parameter stack slot of a local variable whose index was read from the stack.
+    ///       The slot is always in the stack, VerifyProgram limits local indexes to the image's
+    ///       localSlots and CheckFrame makes room for them when the frame is set up.
+    /// \param operand Index of the local variable.
+    inline int64_t LocalSlot(int64_t operand)
+    {
+        return BP + operand;
+    }
+
+    /// \desc Peephole pass that replaces common instruction sequences in the code array with
+    ///       fused instructions. Sequences that contain a jump target after their first
+    ///       instruction are not fused.
+    void FuseInstructions();
+
+    /// \desc Gets the number of instructions a fused instruction replaces.
+    /// \param opcode Opcode to check.
+    /// \return The length of the fused sequence or 0 if opcode is not a fused instruction.
+    static int64_t FusedLength(OPCODES opcode);
+
+    /// \desc Runs a fused instruction. The fast path handles integer and double operands
+    ///       directly, anything else runs the original instruction sequence.
+    /// \param instruction Pointer to the fused instruction, PC must point at the next instruction.
+    void RunFusedInstruction(Instruction *instruction);
+
+    /// \desc Rewrites a generic arithmetic or test instruction into its quickened version when
+    ///       both operands on the stack are integers or both are doubles, then runs it.
+    /// \param instruction Pointer to the generic instruction.
+    /// \return True if the instruction was quickened and run, false if the generic instruction
+    ///         must be run.
+    bool QuickenInstruction(Instruction *instruction);
+
+    /// \desc Runs a quickened instruction.
+    /// \param instruction Pointer to the quickened instruction.
+    /// \return True if it was run, false if the operand types did not match.
+    bool RunQuickenedInstruction(Instruction *instruction);
+
+    /// \desc Rewrites a quickened instruction back into its generic instruction. After
+    ///       MAX_DEOPTIMIZATIONS the instruction stays generic. The instruction is left as it is
+    ///       if the image is shared with other CPUs.
+    /// \param instruction Pointer to the quickened instruction.
+    /// \return The generic opcode to run instead.
+    OPCODES DeoptimizeInstruction(Instruction *instruction);
+
+    /// \desc Gets the location of a module's handler for a system event from the EFI instructions
+    ///       that follow the end of the program.
+    /// \param errorHandler Event to get the handler of.
+    /// \param moduleId Id of the module the handler is defined in.
+    /// \return Location of the handler's first instruction or 0 if the module has no handler.
+    int64_t GetEventLocation(SystemErrorHandlers errorHandler, int64_t moduleId);
 
     /// \desc Handles on error events.
     void JumpToOnErrorHandler();
 
-    /// \desc Executes the single instruction in dsl value.
-    /// \param dslValue Instruction to be executed.
-    bool RunInstruction(DslValue *dslValue);
+    /// \desc Runs an event handler as a call with no parameters on a new frame above the stack
+    ///       and locals of the interrupted code. The handler runs until it returns on its own
+    ///       frame, then the registers are restored so the interrupted code continues.
+    /// \param location Location of the handler's first instruction.
+    /// \param result Receives the value the handler returns, nullptr if it is not needed.
+    /// \return True if the handler returned, false if it ended the program.
+    bool RunEventHandler(int64_t location, DslValue *result);
+
+    /// \desc Executes a single packed instruction.
+    /// \param instruction Instruction to be executed.
+    bool RunInstruction(Instruction *instruction);
 
     /// \desc Called when its time to call the on tick handler.
     void JumpToOnTick();
 
+    /// \desc Advances the on tick clock.
+    /// \return True if an on tick event is due.
+    bool TickDue();
+
+    /// \desc Handles a pending interrupt, runs the on error handler if an error was raised,
+    ///       otherwise checks the on tick timer and refills the event budget.
+    void ProcessInterrupt();
+
     /// \desc Runs and traces the execution of the compiled program.
     void RunTrace();
 
     /// \desc Runs the compiled program without trace information.
     void RunNoTrace();
 
+    /// \desc Runs the compiled program without trace information using direct threaded dispatch.
+    ///       Each instruction handler jumps straight to the handler of the next instruction so
+    ///       there is no function call or switch per instruction.
+    /// \remark Falls back to RunNoTrace when the compiler does not support labels as values.
+    void RunThreaded();
+
     /// \desc Gets the operands for an instruction. Only active when the trace flag is
     ///       set to 1.
     /// \param instruction Pointer to the next instruction to be executed.
@@ -265,7 +661,7 @@ private:
     ///             for unary or no operand instructions.
     /// \param right Right side of the instruction for binary instructions or position
     ///              for conditional jump instructions.
-    int64_t GetInstructionOperands(DslValue *instruction, DslValue *left, DslValue *right);
+    int64_t GetInstructionOperands(Instruction *instruction, DslValue *left, DslValue *right);
 
     /// \desc Extends the number of elements in a collection at runtime.
     /// \param collection Collection to extend.
@@ -275,9 +671,9 @@ private:
     /// \desc Sets the collection element referenced in the dsl value with the value on
     ///       the top of the parameter stack. This is used when dynamically initializing
     ///       a collection with non-static expressions.
-    /// \param dslValue Pointer to the dslValue value that contains the collection and
-    ///                 element to set information.
-    void SetCollectionElementDirect(DslValue *dslValue);
+    /// \param instruction Pointer to the DCS instruction that contains the collection and
+    ///                    element to set information.
+    void SetCollectionElementDirect(Instruction *instruction);
 
     /// \desc Gets the referenced element in a collection.
     /// \param dslValue Pointer to the dslValue containing the collection.
@@ -285,6 +681,34 @@ private:
     /// \remark This call can extend a collection.
     DslValue *GetCollectionElement(DslValue *dslValue);
 
+    /// \desc Starts a foreach loop by sharing the collection on the top of the parameter stack with
+    ///       the loop's iterator variable, the elements are walked in place without any keys
+    ///       being looked up.
+    /// \param instruction Pointer to the ITS instruction, operand is the iterator variable.
+    void StartIteration(Instruction *instruction);
+
+    /// \desc Moves a foreach loop to its next element or jumps to the end of the loop when
+    ///       there are no more elements.
+    /// \param instruction Pointer to the ITN instruction, location is the end of the loop.
+    void NextIteration(Instruction *instruction);
+
+    /// \desc Saves the key of the current element of a foreach loop in a variable.
+    /// \param instruction Pointer to the ITK instruction, operand is the variable and location
+    ///                    the iterator variable.
+    void IterationKey(Instruction *instruction);
+
+    /// \desc Saves a copy of the current element of a foreach loop in a variable.
+    /// \param instruction Pointer to the ITV instruction, operand is the variable and location
+    ///                    the iterator variable.
+    void IterationValue(Instruction *instruction);
+
+    /// \desc Returns a copy of a collection in A with a math function applied to every element,
+    ///       used by the math functions so they accept whole collections.
+    /// \param param Parameter of the math function.
+    /// \param function Function to apply, see NumericArray::Apply.
+    /// \return True if the parameter is a collection, otherwise A is not changed.
+    bool MathOnCollection(DslValue *param, double (*function)(double));
+
     /// \desc Evaluates the variable instruction and pushes a dsl value
     ///       that contains the address of the dsl value to be updated by
     ///       a store instruction.
@@ -0,0 +1,28 @@
+/// \file   CallFrame.h
+///         Call frame pushed by the CPU runtime when a script function is called.
+
+#ifndef DSL_CPP_CALL_FRAME_H
+#define DSL_CPP_CALL_FRAME_H
+
+#include "dsl_types.h"
+
+/// \desc Saved state of the caller of a script function. JSR pushes a frame on the CPU's call
+///       frame stack and jumps to the function, RET pops it and continues the caller in the same
+///       dispatch loop, so script function calls do not use the native stack.
+struct CallFrame
+{
+    /// \desc Position of the instruction after the JSR, where the caller continues.
+    int64_t returnPC;
+
+    /// \desc Stack frame of the caller, restored on return.
+    int64_t BP;
+
+    /// \desc Number of parameters passed to the function, removed from the stack on return.
+    int64_t totalParams;
+
+    /// \desc If true the run loop that called the function is left when it returns. Set for
+    ///       functions called from outside the program, such as components.
+    bool exitOnReturn;
+};
+
+#endif //DSL_CPP_CALL_FRAME_H
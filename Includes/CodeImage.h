@@ -0,0 +1,129 @@
+/// \file   CodeImage.h
+///         Loaded program code that can be shared by any number of CPUs.
+
+#ifndef DSL_CPP_CODEIMAGE_H
+#define DSL_CPP_CODEIMAGE_H
+
+#include <atomic>
+#include <mutex>
+#include "dsl_types.h"
+#include "List.h"
+#include "DslValue.h"
+#include "Instruction.h"
+#include "JumpTable.h"
+#include "Collection.h"
+
+/// \desc The loaded form of a compiled program, the deserialized instructions, the packed code
+///       array and everything computed from them when the program is loaded. Global variables
+///       are not part of the image, each CPU copies them from the image's DEF instructions into
+///       its own globals list, so any number of CPUs can run the same image and each one only
+///       pays for its own variables. The image is reference counted, every CPU that uses it
+///       holds a reference and it is deleted when the last one is released.
+/// \remark The image is not changed while CPUs run it except by quickening, which rewrites
+///         instructions while the image is used by a single CPU only. CPUs should share an
+///         image before any of them runs.
+class CodeImage
+{
+public:
+    /// \desc Creates an empty image with one reference.
+    CodeImage()
+    {
+        references = 1;
+        code = nullptr;
+        codeCount = 0;
+        maxStack = 0;
+        frameDepth = nullptr;
+        localSlots = 0;
+        stackVerified = false;
+    }
+
+    /// \desc Adds a reference to the image.
+    void AddReference()
+    {
+        references.fetch_add(1);
+    }
+
+    /// \desc Releases a reference to the image, deleting it when no references are left.
+    void Release()
+    {
+        if ( references.fetch_sub(1) == 1 )
+        {
+            delete this;
+        }
+    }
+
+    /// \desc Checks if more than one CPU uses the image.
+    [[nodiscard]] bool IsShared() const
+    {
+        return references.load(std::memory_order_relaxed) > 1;
+    }
+
+    /// \desc The deserialized program instructions. Used for symbols, display and as the side
+    ///       table storage referenced by the packed instructions.
+    List<DslValue *> instructions = {};
+
+    /// \desc Dense array of packed instructions built from the deserialized instructions. This
+    ///       is what the CPU executes.
+    Instruction *code;
+
+    /// \desc Number of instructions in the code array, not counting the END sentinel.
+    int64_t codeCount;
+
+    /// \desc Case lookup table for each JTB instruction, indexed by the instruction's operand.
+    List<JumpTable *> jumpTables;
+
+    /// \desc Location of each component in the program.
+    List<int64_t> comInstAddr = {};
+
+    /// \desc COM instruction of each component by the name of its function. The operand of the
+    ///       COM instruction is the index of the component in comInstAddr.
+    Collection componentIndex;
+
+    /// \desc JSON description of the components, built the first time it is asked for.
+    U8String manifest;
+
+    /// \desc Makes sure the manifest is only built once when CPUs sharing the image ask for it.
+    std::once_flag manifestBuilt;
+
+    /// \desc Location of the instruction that defines each global variable, indexed by the
+    ///       operand of the packed instructions that use the variable.
+    List<int64_t> globalAddr = {};
+
+    /// \desc Largest frameDepth of the program's functions. Instructions whose change to the
+    ///       stack depends on run time values, JBF, PVA and PCV, keep this many slots free.
+    int64_t maxStack;
+
+    /// \desc Number of slots the parameter stack can grow above top in the function that starts
+    ///       at each location, 0 for locations that do not start a function. A call makes sure
+    ///       there is room for its function's depth so the function accesses the stack without
+    ///       bounds checks. Indexed by location up to codeCount.
+    int64_t *frameDepth;
+
+    /// \desc Number of local variable slots above BP used by the program's functions.
+    int64_t localSlots;
+
+    /// \desc True if the depth of every function is bounded without checking the stack on jumps.
+    ///       Programs with loops that leave values on the stack need jumps to check it.
+    bool stackVerified;
+
+private:
+    /// \desc Only deleted by Release.
+    ~CodeImage()
+    {
+        delete []code;
+        delete []frameDepth;
+        for(int64_t ii=0; ii<jumpTables.Count(); ++ii)
+        {
+            delete jumpTables[ii];
+        }
+        for(int64_t ii=0; ii<instructions.Count(); ++ii)
+        {
+            delete instructions[ii];
+        }
+    }
+
+    /// \desc Number of CPUs using the image.
+    std::atomic<int64_t> references;
+};
+
+#endif //DSL_CPP_CODEIMAGE_H
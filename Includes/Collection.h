@@ -14,14 +14,21 @@
 #ifndef DSL_CPP_COLLECTION_H
 #define DSL_CPP_COLLECTION_H
 
-#ifndef COLLECTION_BUCKETS
-#undef COLLECTION_BUCKETS
+#ifndef COLLECTION_INLINE_KEYS
+#define COLLECTION_INLINE_KEYS 8
 #endif
-#define COLLECTION_BUCKETS 512
+
+#ifndef COLLECTION_MIN_SLOTS
+#define COLLECTION_MIN_SLOTS 32
+#endif
+#include <atomic>
 #include "../Includes/U8String.h"
+#include "../Includes/SymbolTable.h"
 
 
 /// \desc The Key Data class contains the key and data information for a single element in the hash table.
+/// \remark The key is an interned symbol so key data can be copied without copying the key's text.
+///         Each key data holds a reference to its symbol.
 class KeyData
 {
 public:
@@ -29,22 +36,27 @@ public:
     /// \desc Creates a new empty key data instance.
     KeyData()
     {
-        m_key   = new U8String();
+        m_symbol = SymbolTable::Intern("");
         m_keyIndex = -1;
         m_data = nullptr;
     }
 
-    ~KeyData()
-    {
-        delete m_key;
-    }
+    /// \desc Gets a reference to the Key value for this key index info. The key is shared with every
+    ///       other key data that has the same key so it must not be changed.
+    U8String *Key() { return &m_symbol->text; }
 
-    /// \desc Gets a reference to the Key value for this key index info.
-    U8String *Key() { return m_key; }
+    /// \desc Gets the interned symbol of the key.
+    Symbol *KeySymbol() { return m_symbol; }
 
-    /// \desc Gets the index of the key in the bucketList list.
+    /// \desc Gets the index of the key in the order the keys were added.
     [[nodiscard]] int64_t KeyIndex() const { return m_keyIndex; }
 
+    /// \desc Sets the index of the key in the order the keys were added.
+    void KeyIndex(int64_t keyIndex) { m_keyIndex = keyIndex; }
+
+    /// \desc Gets the hash of the key.
+    [[nodiscard]] uint32_t Hash() const { return m_symbol->hash; }
+
     /// \desc Consumer supplied and managed data.
     void *Data()
     {
@@ -62,7 +74,8 @@ public:
     /// \param keyData Pointer to the key data to copy.
     explicit KeyData(KeyData *keyData)
     {
-        m_key = new U8String(keyData->Key());
+        m_symbol = keyData->m_symbol;
+        m_symbol->AddReference();
         m_keyIndex = keyData->m_keyIndex;
         m_data = keyData->Data();
     }
@@ -70,55 +83,173 @@ public:
     /// \desc Creates a new empty key data instance with the provided information.
     KeyData(U8String *key, int64_t keyIndex, void *data)
     {
-        m_key = new U8String(key);
+        m_symbol = SymbolTable::Intern(key);
         m_keyIndex = keyIndex;
         m_data = data;
     }
 
+    /// \desc Creates a new empty key data instance with the provided information.
+    KeyData(Symbol *symbol, int64_t keyIndex, void *data)
+    {
+        m_symbol = symbol;
+        m_symbol->AddReference();
+        m_keyIndex = keyIndex;
+        m_data = data;
+    }
+
+    KeyData(const KeyData &) = delete;
+    KeyData &operator=(const KeyData &) = delete;
+
+    /// \desc Releases the key's symbol.
+    ~KeyData()
+    {
+        SymbolTable::Release(m_symbol);
+    }
+
 private:
-    /// \desc U8String key associated with this element.
-    U8String *m_key;
+    /// \desc Interned key associated with this element.
+    Symbol *m_symbol;
 
-    /// \desc Index in the keys list where the actual U8String is stored.
+    /// \desc Index of the key in the order the keys were added.
     int64_t  m_keyIndex;
 
     /// \desc Caller managed data associated with this key value.
     void *m_data;
 };
 
-/// \desc Describes the content of a single bucket or element in the bucket list for the hash table.
-class CollectionBucket
+/// \desc The keys of a collection. Up to COLLECTION_INLINE_KEYS keys are stored in the table itself
+///       and found by a linear scan of their hashes. Larger tables move the keys to an array and
+///       index them with an open addressing hash table whose size is a power of two, it is doubled
+///       when it is three quarters full. A table is reference counted so collections copied from
+///       each other share it until one of them is changed, see Collection::Detach.
+/// \remark Keys appended by their position are not indexed, the table is a plain array of them
+///         until a key is searched for, the keys are indexed then. The hash of each key is
+///         computed once when its symbol is interned and is shared by every table with the key.
+class CollectionTable
 {
 public:
-    List<KeyData *> bucketList;
-
-    CollectionBucket()
+    /// \desc Creates an empty table with one reference.
+    CollectionTable()
     {
-        bucketList = {};
+        entries = inlineEntries;
+        count = 0;
+        indexed = 0;
+        capacity = COLLECTION_INLINE_KEYS;
+        slots = nullptr;
+        slotMask = 0;
+        references = 1;
     }
 
-    ~CollectionBucket()
-    {
-        for(int ii=0; ii < bucketList.Count(); ++ii)
-        {
-            delete bucketList[ii];
-        }
-    }
+    /// \desc Creates a copy of a table with one reference. The key data is copied, the data
+    ///       pointers are not changed.
+    explicit CollectionTable(CollectionTable *source);
+
+    /// \desc Frees the key data and the arrays.
+    ~CollectionTable();
+
+    /// \desc Finds a key.
+    /// \param key Pointer to the U8String that contains the key.
+    /// \param hash Hash of the key.
+    /// \return The key's data or nullptr if the table does not have the key.
+    KeyData *Find(U8String *key, uint32_t hash);
+
+    /// \desc Finds a key by its symbol, keys are compared by their symbols instead of their text.
+    /// \param symbol Interned key.
+    /// \return The key's data or nullptr if the table does not have the key.
+    KeyData *Find(Symbol *symbol);
+
+    /// \desc Adds a key that is not in the table.
+    /// \param keyData Key data to add, owned by the table from now on.
+    /// \return True if added or false if out of memory.
+    bool Add(KeyData *keyData);
+
+    /// \desc Adds a key that is not in the table without indexing it.
+    /// \param keyData Key data to add, owned by the table from now on.
+    /// \return True if added or false if out of memory.
+    bool Append(KeyData *keyData);
+
+    /// \desc Removes a key and deletes its key data.
+    /// \param index Index of the key in the order the keys were added.
+    void Remove(int64_t index);
+
+    /// \desc Approximate number of bytes used by the table and its key data, not counting the
+    ///       keys' symbols or the data.
+    int64_t Bytes();
+
+    /// \desc Key data in the order the keys were added, inlineEntries until it needs to grow.
+    KeyData **entries;
+
+    /// \desc Number of keys.
+    int64_t count;
+
+    /// \desc Number of keys that have been indexed, the keys after them were appended by Append.
+    int64_t indexed;
+
+    /// \desc Number of keys entries can hold.
+    int64_t capacity;
+
+    /// \desc Open addressing index of the entries, each slot is the entry's index plus one or
+    ///       0 if the slot is empty. nullptr while the keys fit in inlineEntries.
+    int32_t *slots;
+
+    /// \desc Number of slots minus one.
+    int64_t slotMask;
+
+    /// \desc Storage of small tables.
+    KeyData *inlineEntries[COLLECTION_INLINE_KEYS];
+
+    /// \desc Number of collections using the table.
+    std::atomic<int64_t> references;
+
+private:
+    /// \desc Adds key data to the end of the entries.
+    /// \return True if successful or false if out of memory.
+    bool Push(KeyData *keyData);
+
+    /// \desc Indexes the keys added by Append.
+    /// \return True if successful or false if out of memory.
+    bool IndexAppended();
+
+    /// \desc Rebuilds the slots.
+    /// \param slotCount New number of slots, a power of two.
+    /// \return True if successful or false if out of memory.
+    bool Rehash(int64_t slotCount);
+
+    /// \desc Adds an entry to the slots.
+    void Place(int64_t index);
 };
 
 /// \desc Creates an efficient hashmap for quickly looking up keys and dsl values.
+/// \remark The data of each key is a pointer to a DslValue. Copying a collection shares its table
+///         so it is O(1), the table and its elements are copied the first time either collection
+///         is changed. Elements are changed in place by the runtime so code that changes an
+///         element must call Detach first. Collections that share a table can be used from
+///         different threads as long as each collection is only used by one of them.
 class Collection
 {
 private:
-    /// \desc internal array of hashmap buckets, memory managed by the hashmap class.
-    CollectionBucket buckets[COLLECTION_BUCKETS];
+    /// \desc Table with the keys and data, nullptr until the first key is set.
+    CollectionTable *table;
 
 public:
-    List<U8String *>keys;   //List of the unique bucketList in the hash table.
     /// \desc Creates an empty hashmap.
     Collection()
     {
-        keys = {};
+        table = nullptr;
+    }
+
+    /// \desc Creates a collection sharing the table of another collection.
+    Collection(const Collection &source)
+    {
+        table = nullptr;
+        Share(source.table);
+    }
+
+    /// \desc Shares the table of another collection.
+    Collection &operator=(const Collection &source)
+    {
+        Share(source.table);
+        return *this;
     }
 
     /// \desc Frees up the resources used by the hashmap.
@@ -131,7 +262,7 @@ public:
     /// \param keyData Pointer to the class containing the key, index, and data information.
     bool Set(KeyData *keyData)
     {
-        return Set(keyData->Key(), keyData->Data());
+        return Set(keyData->KeySymbol(), keyData->Data());
     }
 
     /// \desc Sets a new key in the hashmap with the specified token.
@@ -140,27 +271,49 @@ public:
     /// \return True if the key and token are added or false if out of memory.
     bool Set(U8String *key, void *data = nullptr)
     {
-        size_t hashed_key = HashFunction(key);
-        for(int ii=0; ii<buckets[hashed_key].bucketList.Count(); ++ii)
+        if ( !Detach() )
         {
-            if ( buckets[hashed_key].bucketList[ii]->Key()->IsEqual(key))
-            {
-                buckets[hashed_key].bucketList[ii]->Data(data);
-                return true;
-            }
+            return false;
         }
-        //Key does not exist so add it to the end of the buckets key index info list.
-        int64_t keyCount = keys.Count();
-        if ( !keys.push_back(key) )
+
+        uint32_t hash = key->Hash();
+        KeyData *keyData = table->Find(key, hash);
+        if ( keyData != nullptr )
+        {
+            keyData->Data(data);
+            return true;
+        }
+
+        //Key does not exist so add it to the end of the keys.
+        Symbol *symbol = SymbolTable::Intern(key, hash);
+        if ( symbol == nullptr )
         {
             return false;
         }
-        if (!buckets[hashed_key].bucketList.
-            push_back(new KeyData(keys[keyCount], keyCount, data)))
+        bool added = Add(symbol, data);
+        SymbolTable::Release(symbol);
+        return added;
+    }
+
+    /// \desc Sets a key in the hashmap by its interned symbol, no characters are hashed or compared.
+    /// \param symbol Interned key.
+    /// \param data optional data to associated with this key valid pair.
+    /// \return True if the key and token are added or false if out of memory.
+    bool Set(Symbol *symbol, void *data = nullptr)
+    {
+        if ( !Detach() )
         {
             return false;
         }
-        return true;
+
+        KeyData *keyData = table->Find(symbol);
+        if ( keyData != nullptr )
+        {
+            keyData->Data(data);
+            return true;
+        }
+
+        return Add(symbol, data);
     }
 
     /// \desc Gets a token stored in the hashmap by its key.
@@ -169,21 +322,70 @@ public:
     ///         nullptr if the key does not exist om the hashmap.
     KeyData *Get(U8String *key)
     {
-        size_t hashed_key = HashFunction(key);
+        if ( table == nullptr )
+        {
+            return nullptr;
+        }
+
+        return table->Find(key, key->Hash());
+    }
+
+    /// \desc Gets a token stored in the hashmap by its interned key.
+    /// \param symbol Interned key.
+    /// \return Pointer to the KeyData class of the key or nullptr if the key does not exist in the hashmap.
+    KeyData *Get(Symbol *symbol)
+    {
+        if ( table == nullptr )
+        {
+            return nullptr;
+        }
+
+        return table->Find(symbol);
+    }
+
+    /// \desc Adds a key after the last key. Used for elements that are found by their position,
+    ///       the key is not indexed until a key is searched for so a collection that is only
+    ///       indexed by position is a plain array.
+    /// \param key Pointer to the U8String key, it must not be in the collection.
+    /// \param data optional data to associated with this key valid pair.
+    /// \return True if the key is added or false if out of memory.
+    bool Append(U8String *key, void *data = nullptr)
+    {
+        if ( !Detach() )
+        {
+            return false;
+        }
+        if ( table->indexed > 0 )
+        {
+            return Set(key, data);
+        }
 
-        for(int ii=0; ii<buckets[hashed_key].bucketList.Count(); ++ii)
+        Symbol *symbol = SymbolTable::Intern(key);
+        if ( symbol == nullptr )
         {
-            if ( buckets[hashed_key].bucketList[ii]->Key()->IsEqual(key))
-            {
-                return buckets[hashed_key].bucketList[ii];
-            }
+            return false;
+        }
+        auto *keyData = new KeyData(symbol, table->count, data);
+        SymbolTable::Release(symbol);
+        if ( !table->Append(keyData) )
+        {
+            delete keyData;
+            return false;
         }
-        return nullptr;
+        return true;
     }
 
-    /// \desc Returns the number of bucketList stored in the hashmap.
-    /// \return Total bucketList stored in the hashmap.
-    int64_t Count() { return keys.Count();  }
+    /// \desc Returns the number of keys stored in the hashmap.
+    /// \return Total keys stored in the hashmap.
+    int64_t Count() { return table == nullptr ? 0 : table->count; }
+
+    /// \desc Gets a key by the order it was added in.
+    /// \param index Index of the key, must be less than Count.
+    U8String *Key(int64_t index) { return table->entries[index]->Key(); }
+
+    /// \desc Gets the key data of a key by the order it was added in.
+    /// \param index Index of the key, must be less than Count.
+    KeyData *Entry(int64_t index) { return table->entries[index]; }
 
     /// \desc Gets a list of all of the key and data information in the collection.
     List<KeyData *> GetKeyData();
@@ -198,77 +400,76 @@ public:
     /// \return True if the key and it's index was removed, else false if the key was not removed.
     [[maybe_unused]] bool Remove(U8String *key)
     {
-        size_t hashed_key = HashFunction(key);
-        for(int ii=0; ii<buckets[hashed_key].bucketList.Count(); ++ii)
+        if ( !Exists(key) || !Detach() )
         {
-            if ( buckets[hashed_key].bucketList[ii]->Key()->IsEqual(key))
-            {
-                KeyData *tmp = buckets[hashed_key].bucketList[ii];
-                buckets[hashed_key].bucketList.Remove(ii);
-                keys.Remove(tmp->KeyIndex());
-                delete []tmp;
-                break;
-            }
+            return false;
         }
 
-        return false;
+        table->Remove(Get(key)->KeyIndex());
+        return true;
     }
 
-    /// \desc Sets the number of keys in the bucket list to 0, does not free the memory used by
-    /// the key index info class and its list used in each bucket so that it can be reused.
+    /// \desc Removes all of the keys, the table is freed when no other collection shares it.
     void Clear()
     {
-        keys.Clear();
-
-        for(auto & bucket : buckets)
+        if ( table != nullptr && table->references.fetch_sub(1) == 1 )
         {
-            bucket.bucketList.Clear();
+            delete table;
         }
+        table = nullptr;
     }
 
-    /// \desc Copies the provided collection information to this collection.
+    /// \desc Copies the provided collection information to this collection. The collections share
+    ///       the same table until one of them is changed.
     /// \param source Collection to copy to this collection.
     /// \return True if successful or false if out of memory.
     bool CopyFrom(Collection *source)
     {
-        Clear();
+        Share(source->table);
+        return true;
+    }
 
-        for(int64_t ii=0; ii < source->Count(); ++ii)
-        {
-            U8String *s = source->keys[ii];
+    /// \desc Checks if the table is shared with another collection.
+    [[nodiscard]] bool IsShared() const
+    {
+        return table != nullptr && table->references.load() > 1;
+    }
 
-            if ( !Set(source->Get(s)) )
-            {
-                return false;
-            }
-        }
+    /// \desc Makes sure this collection has a table of its own before it is changed. A shared
+    ///       table is copied along with its elements, the copied elements share any collections
+    ///       they contain so nested collections are only copied when they are changed.
+    /// \return True if successful or false if out of memory.
+    bool Detach();
 
-        return true;
-    }
+    /// \desc Approximate number of bytes used by the collection's table, see CollectionTable::Bytes.
+    int64_t Bytes() { return table == nullptr ? 0 : table->Bytes(); }
 
 private:
-    /// \desc Key index information used when getting a list of the key index information in the collection.
-
-    /// \desc Jenkins hash function.
-    /// \param key The key to search for.</param>
-    /// \return The hash value mod against the number of BUCKETS.
-    /// \remark The Jenkins hash function us used since it is one of the hash that is quite good at avoiding
-    /// key collisions when used with non-deterministic string values.
-    static uint32_t HashFunction(U8String *key)
+    /// \desc Adds a key that is not in the table to the end of the keys.
+    bool Add(Symbol *symbol, void *data)
     {
-        uint32_t hash = 0;
-        for (int64_t ii = 0; ii < key->Count(); ++ii)
+        auto *keyData = new KeyData(symbol, table->count, data);
+        if ( !table->Add(keyData) )
         {
-            //Walk backwards as the variable values change the most from the end of the value.
-            hash += key->get(ii);
-            hash += hash << 10;
-            hash ^= hash >> 6;
+            delete keyData;
+            return false;
         }
-        hash += hash << 3;
-        hash ^= hash >> 11;
-        hash += hash << 15;
+        return true;
+    }
 
-        return hash % COLLECTION_BUCKETS;
+    /// \desc Releases the current table and uses the provided table.
+    void Share(CollectionTable *source)
+    {
+        if ( source == table )
+        {
+            return;
+        }
+        if ( source != nullptr )
+        {
+            source->references.fetch_add(1);
+        }
+        Clear();
+        table = source;
     }
 };
 
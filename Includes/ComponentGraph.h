@@ -0,0 +1,85 @@
+/// \file   ComponentGraph.h
+///         Runs the components of a program as a dataflow graph wired by their slots.
+
+#ifndef DSL_CPP_COMPONENT_GRAPH_H
+#define DSL_CPP_COMPONENT_GRAPH_H
+
+#include "dsl_types.h"
+#include "List.h"
+#include "CPU.h"
+#include "CodeImage.h"
+#include "ComponentScheduler.h"
+
+/// \desc Runs every component of a program once per frame as a graph. Each component is a node
+///       with its own CPU sharing the program's code image. A component with an input slot
+///       waits for the component with an output slot for the same variable, and the variable
+///       is copied from the output component's CPU to the input component's CPU before it runs.
+///       Components that do not wait for each other run in parallel on the scheduler's workers.
+/// \remark Input slots that no component outputs are not connected, the host sets them through
+///         the node's CPU between frames.
+class ComponentGraph
+{
+public:
+    /// \desc Creates an empty graph.
+    /// \param workers Number of worker threads, 0 for one per hardware thread.
+    explicit ComponentGraph(int64_t workers = 0);
+
+    /// \desc Deletes the nodes.
+    ~ComponentGraph();
+
+    /// \desc Creates a node for every component of the program and connects their slots. The
+    ///       outputs are found from the component data of the image, see FindOutput, and the
+    ///       program is not run. The variables of each node start with the values they are
+    ///       defined with, a host that needs the program's own code to run first calls Run on
+    ///       the nodes before the first frame.
+    /// \param image Code image of the program, see CPU::Image.
+    /// \return True if successful, false if a node can't be created, two components output the
+    ///         same variable or the components wait for each other.
+    bool Init(CodeImage *image);
+
+    /// \desc Runs every component once, in the order of their connections.
+    void RunFrame()
+    {
+        scheduler->RunFrame();
+    }
+
+    /// \desc Number of nodes, one per component in the order of the program.
+    int64_t Nodes()
+    {
+        return nodes.Count();
+    }
+
+    /// \desc Gets the CPU of a node.
+    CPU *Node(int64_t component)
+    {
+        return nodes[component];
+    }
+
+    /// \desc Gets the scheduler running the graph, its jobs are the nodes and have the timing of
+    ///       the last frame.
+    ComponentScheduler *Scheduler()
+    {
+        return scheduler;
+    }
+
+private:
+    /// \desc Finds the component with an output slot for a variable.
+    /// \param variable Full name of the variable.
+    /// \param component Set to the component.
+    /// \return False if more than one component outputs the variable.
+    bool FindOutput(U8String *variable, int64_t &component);
+
+    /// \desc Deletes the nodes and the jobs.
+    void Clear();
+
+    /// \desc Code image of the program.
+    CodeImage *image;
+
+    /// \desc Runs the nodes.
+    ComponentScheduler *scheduler;
+
+    /// \desc CPU of each component.
+    List<CPU *> nodes;
+};
+
+#endif //DSL_CPP_COMPONENT_GRAPH_H
@@ -0,0 +1,269 @@
+/// \file   ComponentScheduler.h
+///         Runs frames of component functions on a work stealing pool of threads.
+
+#ifndef DSL_CPP_COMPONENT_SCHEDULER_H
+#define DSL_CPP_COMPONENT_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "dsl_types.h"
+#include "List.h"
+#include "U8String.h"
+#include "CPU.h"
+
+/// \desc A component function to run on a CPU each frame and how its last run went.
+struct ComponentJob
+{
+    /// \desc CPU the component runs on.
+    CPU *cpu;
+
+    /// \desc Index of the component in the CPU's program, found once when the job is added.
+    int64_t component;
+
+    /// \desc True if the component ran in the last frame.
+    bool ran;
+
+    /// \desc Time the component took to run in the last frame.
+    int64_t nanoseconds;
+
+    /// \desc Worker that ran the component in the last frame.
+    int64_t worker;
+};
+
+/// \desc A value copied from the CPU of one job to the CPU of a job that runs after it.
+struct SlotLink
+{
+    /// \desc Job the value is copied to, it is copied just before the job runs.
+    int64_t job;
+
+    /// \desc Variable of the job that runs first.
+    DslValue *output;
+
+    /// \desc Variable of the job the value is copied to.
+    DslValue *input;
+};
+
+/// \desc The jobs of a frame that run on the same CPU. A CPU can only be used by one thread at
+///       a time so its jobs are run one after the other, in the order they were added, by the
+///       worker that takes the task.
+struct ComponentTask
+{
+    /// \desc CPU the jobs run on.
+    CPU *cpu;
+
+    /// \desc Index of each job in the scheduler.
+    List<int64_t> jobs;
+
+    /// \desc Values copied into the task's jobs before they run.
+    List<SlotLink> links;
+
+    /// \desc Tasks that wait for this task to finish.
+    List<int64_t> next;
+
+    /// \desc Number of tasks this task waits for.
+    int64_t waitsFor;
+
+    /// \desc Number of tasks this task still waits for in the current frame.
+    std::atomic<int64_t> pending;
+};
+
+/// \desc Tasks waiting to run on a worker. The worker takes tasks from the back, idle workers
+///       steal them from the front.
+/// \remark This is not a lock free deque, the owner and the thieves take the same mutex so a
+///         steal blocks the owner for as long as it takes to remove one task. A task runs every
+///         component of a CPU so it takes far longer than the lock is held and the queue is
+///         rarely contended.
+class WorkerQueue
+{
+public:
+    /// \desc Adds a task, by RunFrame or by the worker that finishes the last task it waits for.
+    void Push(int64_t task)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tasks.push_back(task);
+    }
+
+    /// \desc Takes the newest task, used by the worker that owns the queue.
+    /// \param task Set to the task.
+    /// \return True if there was a task.
+    bool Pop(int64_t &task)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if ( tasks.empty() )
+        {
+            return false;
+        }
+        task = tasks.back();
+        tasks.pop_back();
+        return true;
+    }
+
+    /// \desc Takes the oldest task, used by the other workers.
+    /// \param task Set to the task.
+    /// \return True if there was a task.
+    bool Steal(int64_t &task)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if ( tasks.empty() )
+        {
+            return false;
+        }
+        task = tasks.front();
+        tasks.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex lock;
+    std::deque<int64_t> tasks;
+};
+
+/// \desc Runs a batch of component functions, each on its own CPU, once per frame on a pool of
+///       worker threads. The jobs are added once and run every time RunFrame is called. Each
+///       worker has its own queue of tasks, a worker that runs out of tasks steals them from the
+///       other workers so a few slow components do not hold up the frame. Jobs can be connected
+///       so a job runs after the jobs it depends on, a task is queued by the worker that finishes
+///       the last task it waits for. RunFrame returns when every job of the frame has run, this
+///       is the frame barrier, so the CPUs can be read and changed between frames.
+/// \remark CPUs that share a code image can be used by different jobs, see CPU::Init.
+class ComponentScheduler
+{
+public:
+    /// \desc Creates the scheduler and starts its workers.
+    /// \param workers Number of worker threads, 0 for one per hardware thread.
+    explicit ComponentScheduler(int64_t workers = 0);
+
+    /// \desc Stops the workers.
+    ~ComponentScheduler();
+
+    /// \desc Adds a component function to run every frame.
+    /// \param cpu CPU to run the component on, it must stay alive while the job is scheduled.
+    /// \param function Pointer to a U8String that names the component's function.
+    /// \return Index of the job or -1 if the CPU's program does not have the component.
+    /// \remark Must not be called while a frame runs.
+    int64_t Add(CPU *cpu, U8String *function);
+
+    /// \desc Makes a job run after another job each frame and optionally copies a variable
+    ///       from the first job's CPU to the second job's CPU before the second job runs.
+    /// \param from Job that runs first.
+    /// \param to Job that runs after it.
+    /// \param output Variable of the from job's CPU to copy, nullptr if nothing is copied.
+    /// \param input Variable of the to job's CPU that receives the copy.
+    /// \return True if connected, false if a job does not exist or the jobs would wait for
+    ///         each other.
+    /// \remark Must not be called while a frame runs.
+    bool Connect(int64_t from, int64_t to, DslValue *output = nullptr, DslValue *input = nullptr);
+
+    /// \desc Removes all of the jobs.
+    void Clear();
+
+    /// \desc Runs every job once and waits for all of them to finish.
+    void RunFrame();
+
+    /// \desc Gets a job and the results of its last run.
+    ComponentJob &Job(int64_t index)
+    {
+        return jobs[index];
+    }
+
+    /// \desc Number of jobs.
+    int64_t Jobs()
+    {
+        return jobs.Count();
+    }
+
+    /// \desc Number of worker threads.
+    int64_t Workers()
+    {
+        return queues.Count();
+    }
+
+    /// \desc Time the last frame took from the start of RunFrame until the barrier.
+    int64_t frameNanoseconds;
+
+    /// \desc Number of tasks taken from another worker's queue in the last frame.
+    int64_t steals;
+
+    /// \desc Number of frames run.
+    int64_t frames;
+
+private:
+    /// \desc Thread function of a worker, runs tasks until every task of the frame has finished.
+    /// \param worker Index of the worker.
+    void Worker(int64_t worker);
+
+    /// \desc Finds a task to steal from the other workers.
+    /// \param worker Index of the worker looking for work.
+    /// \param task Set to the task.
+    /// \return True if a task was stolen.
+    bool Steal(int64_t worker, int64_t &task);
+
+    /// \desc Runs a task's jobs, timing each one, then queues the tasks waiting for it.
+    void RunTask(int64_t worker, int64_t task);
+
+    /// \desc Wakes idle workers after tasks are queued or the last task of the frame finishes.
+    /// \param tasksQueued Number of tasks queued, 0 to wake every worker.
+    void WakeWorkers(int64_t tasksQueued);
+
+    /// \desc Checks if a task is run before another task.
+    /// \return True if the last task waits, directly or through other tasks, for the first.
+    bool Reaches(int64_t first, int64_t last);
+
+    /// \desc All of the jobs.
+    List<ComponentJob> jobs;
+
+    /// \desc Jobs grouped by CPU.
+    List<ComponentTask *> tasks;
+
+    /// \desc Index of each CPU's task.
+    std::unordered_map<CPU *, int64_t> cpuTasks;
+
+    /// \desc Task queue of each worker.
+    List<WorkerQueue *> queues;
+
+    /// \desc Worker threads.
+    List<std::thread *> threads;
+
+    /// \desc Protects frame, stopping, running and stolen.
+    std::mutex frameLock;
+
+    /// \desc Wakes the workers when a frame starts or the scheduler stops.
+    std::condition_variable frameStart;
+
+    /// \desc Wakes RunFrame when the last worker finishes the frame.
+    std::condition_variable frameDone;
+
+    /// \desc Incremented to start a frame.
+    int64_t frame;
+
+    /// \desc Set to stop the workers.
+    bool stopping;
+
+    /// \desc Number of workers still running the current frame.
+    int64_t running;
+
+    /// \desc Number of tasks of the current frame that have not finished.
+    std::atomic<int64_t> remaining;
+
+    /// \desc Task index of each job.
+    List<int64_t> jobTasks;
+
+    /// \desc Tasks stolen in the current frame.
+    int64_t stolen;
+
+    /// \desc Protects work.
+    std::mutex workLock;
+
+    /// \desc Wakes idle workers when a task is queued or every task of the frame has finished.
+    std::condition_variable workReady;
+
+    /// \desc Incremented each time idle workers are woken, a worker that found no task only
+    ///       waits if it has not changed since it started looking.
+    int64_t work;
+};
+
+#endif //DSL_CPP_COMPONENT_SCHEDULER_H
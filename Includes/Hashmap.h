@@ -195,22 +195,9 @@ public:
     /// \desc Jenkins hash function.
     /// \param key The key to search for.</param>
     /// \return The hash value mod against the number of BUCKETS.
-    /// \remark The Jenkins hash function us used since it is one of the hash that is quite good at avoiding
-    /// key collisions when used with non-deterministic string values.
     static uint32_t HashFunction(U8String *key)
     {
-        uint32_t hash = 0;
-        for (int64_t ii   = 0; ii < key->Count(); ++ii)
-        {
-            hash += key->get(ii);
-            hash += hash << 10;
-            hash ^= hash >> 6;
-        }
-        hash += hash << 3;
-        hash ^= hash >> 11;
-        hash += hash << 15;
-
-        return hash % BUCKETS;
+        return key->Hash() % BUCKETS;
     }
 };
 
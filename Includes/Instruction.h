@@ -0,0 +1,43 @@
+/// \file   Instruction.h
+///         Packed instruction record executed by the CPU runtime.
+
+#ifndef DSL_CPP_INSTRUCTION_H
+#define DSL_CPP_INSTRUCTION_H
+
+#include "dsl_types.h"
+#include "Opcodes.h"
+
+class DslValue;
+
+/// \desc A single packed instruction in the CPU's dense instruction stream. The deserialized
+///       DslValue instructions are large objects (several strings, a collection, a cases list)
+///       so the CPU copies the few fields it needs to run an instruction into this record and
+///       executes from a contiguous array of them. Anything that does not fit in the record
+///       (constants, global variable storage, jump table cases and component data) is reached
+///       through the value pointer which references the side table entry for the instruction.
+struct Instruction
+{
+    /// \desc Opcode of the instruction.
+    OPCODES opcode;
+
+    /// \desc Id of the module the instruction is part of, used to select the on tick handler.
+    int32_t moduleId;
+
+    /// \desc Additional info needed by the instruction, same meaning as DslValue::operand except
+    ///       for JTB where it is the index of the instruction's jump table in the image and for
+    ///       PSV, PVA, INC, DEC, PCV and DCS where it is the index of the global variable in the
+    ///       CPU's globals.
+    int64_t operand;
+
+    /// \desc Position to jump to for jump instructions, same meaning as DslValue::location.
+    ///       DCS instructions store the index of the collection key to set here and arithmetic
+    ///       and test instructions count how many times they were deoptimized.
+    int64_t location;
+
+    /// \desc Side table entry for the instruction. For PSI it is the constant to push, for DEF
+    ///       the variable's initial value, for JTB the jump table and for COM the component
+    ///       definition. nullptr for instructions that need nothing more than the record.
+    DslValue *value;
+};
+
+#endif //DSL_CPP_INSTRUCTION_H
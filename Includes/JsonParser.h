@@ -154,14 +154,14 @@ public:
                     DslValue *prev = current;
                     add_variable(&v->jsonKey);
                     v->type = COLLECTION;
-                    prev->indexes.Set(new U8String(v->jsonKey), current);
+                    prev->indexes.Set(&v->jsonKey, current);
                 }
                 else
                 {
                     v->type = COLLECTION;
                     DslValue *prev = current;
                     add_variable(&v->jsonKey);
-                    prev->indexes.Set(new U8String(v->jsonKey), current);
+                    prev->indexes.Set(&v->jsonKey, current);
                     nodes.push_back(prev);
                 }
             }
@@ -172,7 +172,7 @@ public:
                     add_variable(rootName);
                     DslValue *prev = current;
                 }
-                current->indexes.Set(new U8String(v->jsonKey), new DslValue(v));
+                current->indexes.Set(&v->jsonKey, new DslValue(v));
             }
         }
 
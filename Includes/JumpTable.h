@@ -0,0 +1,99 @@
+/// \file   JumpTable.h
+///         Case lookup table built by the CPU runtime for each switch jump table instruction.
+
+#ifndef DSL_CPP_JUMP_TABLE_H
+#define DSL_CPP_JUMP_TABLE_H
+
+#include "dsl_types.h"
+#include "DslValue.h"
+#include "Value.h"
+
+/// \desc Integer and char cases are placed in a dense table when the range from the smallest to
+///       the largest case is no more than this many times the number of cases.
+#define DENSE_JUMP_TABLE_SPREAD 2
+
+/// \desc How a jump table finds the case that matches a value.
+enum JumpTableKinds
+{
+    LINEAR_JUMP_TABLE = 0,  //Cases of mixed or other types, searched in order by the CPU.
+    DENSE_JUMP_TABLE  = 1,  //Integer or char cases, the value minus the smallest case is the index.
+    HASH_JUMP_TABLE   = 2   //Integer, char or string cases, found by the hash of the case value.
+};
+
+/// \desc Single case in a hash jump table.
+struct JumpTableEntry
+{
+    /// \desc Hash of the case value.
+    uint32_t hash;
+
+    /// \desc Case value for integer and char cases.
+    int64_t key;
+
+    /// \desc Case value for string cases, owned by the jump table instruction.
+    U8String *string;
+
+    /// \desc Location of the case, -1 if the entry is empty.
+    int64_t location;
+};
+
+/// \desc Lookup table for the cases of a JTB instruction. The cases are classified when the
+///       program is loaded. If every case is an integer, every case is a char or every case is a
+///       string the table finds the case for a value of the same type without comparing it to
+///       each case. Values of any other type, and tables with cases of mixed types, are left to
+///       the CPU's linear search so the conversions done by DslValue::IsEqual still apply.
+class JumpTable
+{
+public:
+    /// \desc Builds the lookup table for a jump table instruction.
+    /// \param jumpTable Pointer to the deserialized JTB instruction.
+    explicit JumpTable(DslValue *jumpTable);
+
+    /// \desc Frees the lookup table.
+    ~JumpTable()
+    {
+        delete []locations;
+        delete []entries;
+    }
+
+    /// \desc How the table finds cases.
+    JumpTableKinds kind;
+
+    /// \desc Finds the location to jump to for a value.
+    /// \param value Value being switched on.
+    /// \param location Set to the location of the matching case, or of the default case or the
+    ///        end of the switch if no case matches.
+    /// \return True if the table handled the value, false if the value has to be matched with a
+    ///         linear search of the cases.
+    bool Find(Value *value, int64_t &location);
+
+private:
+    /// \desc Type of the cases in a dense or hash table.
+    TokenTypes keyType;
+
+    /// \desc Location used when no case matches.
+    int64_t defaultLocation;
+
+    /// \desc Smallest case of a dense table.
+    int64_t minimum;
+
+    /// \desc Number of locations in a dense table or entries in a hash table.
+    int64_t size;
+
+    /// \desc Dense table locations, -1 where there is no case.
+    int64_t *locations;
+
+    /// \desc Hash table entries, size is a power of 2.
+    JumpTableEntry *entries;
+
+    /// \desc Adds a case to the hash table, a case equal to one already added is ignored as the
+    ///       first one is the one the switch jumps to.
+    void Insert(DslValue *caseValue);
+
+    /// \desc Hashes an integer or char case value.
+    static uint32_t HashKey(int64_t key);
+
+    /// \desc Hashes a string case value.
+    static uint32_t HashString(U8String *string);
+};
+
+#endif //DSL_CPP_JUMP_TABLE_H
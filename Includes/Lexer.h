@@ -229,6 +229,10 @@ private:
     bool CheckForSyntax(LocationInfo &init, LocationInfo &cond, LocationInfo &update, LocationInfo &block, LocationInfo &end);
     bool DefineForSection(TokenTypes beginToken, TokenTypes endToken, LocationInfo start, LocationInfo end);
     bool DefineFor();
+    bool GetForEachName(U8String *name);
+    bool CheckForEachSyntax(U8String *key, U8String *value, LocationInfo &collection, LocationInfo &collectionEnd);
+    bool GetForEachVariable(U8String *name, U8String *fullName);
+    bool DefineForEach();
     bool SkipToEndOfBlock(LocationInfo start, int64_t errorCode = 2500,
                           const char *errorMsg = "Missing close curly brace before end of file "
                                                  "if this happens then the lexer is missing an error check.");
@@ -10,9 +10,13 @@
 #include <memory.h>
 #include <malloc.h>
 #include <cstdio>
+#include <cstdlib>
+#include <type_traits>
 
 /// \desc This template class creates a dynamically sizable array of items. Syntax is similar to
 ///       the C# list type.
+/// \remark Elements are moved with memcpy only if their type is trivially copyable, others such as
+///         U8String, whose text can point into the object itself, are copied by assignment.
 template<class Type>
 class List
 {
@@ -79,6 +83,31 @@ public:
         return get(index);
     }
 
+    /// \desc Access to the list elements without extending the list. The caller must make sure
+    ///       index is less than Size(), debug builds raise a run time error when it is not and
+    ///       return an empty element instead.
+    Type &At(int64_t index)
+    {
+#ifndef NDEBUG
+        if ( index < 0 || index >= size )
+        {
+            PrintIssue(4009, true, false, "List index %lld is outside the list size %lld",
+                       (long long)index, (long long)size);
+            static Type outside;
+            outside = Type();
+            return outside;
+        }
+#endif
+        return array[index];
+    }
+
+    /// \desc Makes sure the list buffer can hold at least elements without changing the count.
+    /// \return True if successful, false if out of memory.
+    bool Reserve(int64_t elements)
+    {
+        return Extend(elements - 1);
+    }
+
     /// \desc Appends a new element to the list.
     bool push_back(Type type)
     {
@@ -86,7 +115,7 @@ public:
         {
             return false;
         }
-        memcpy(array + count, &type, sizeof(Type));
+        CopyElements(array + count, &type, 1);
         ++count;
         return true;
     }
@@ -115,10 +144,7 @@ public:
     /// \desc Removes the item at index, all subsequent items are moved downward.
     void Remove(int64_t index)
     {
-        for(int64_t ii=index; ii<count; ++ii)
-        {
-            memcpy(&array[ii], &array[ii+1], size * sizeof(Type));
-        }
+        CopyElements(array + index, array + index + 1, count - index - 1);
         count--;
     }
 
@@ -219,6 +245,23 @@ private:
     /// \desc count of elements in the list.
     int64_t count;
 
+    /// \desc Copies elements to a lower or separate position, the old elements are left as they are
+    ///       for the caller to destroy or overwrite.
+    static void CopyElements(Type *destination, const Type *source, int64_t elements)
+    {
+        if constexpr ( std::is_trivially_copyable<Type>::value )
+        {
+            memmove(destination, source, elements * sizeof(Type));
+        }
+        else
+        {
+            for(int64_t ii=0; ii<elements; ++ii)
+            {
+                destination[ii] = source[ii];
+            }
+        }
+    }
+
     /// \desc Extends the list.
     bool Extend(int64_t index)
     {
@@ -232,7 +275,7 @@ private:
                     PrintIssue(2502, true, false, "Failed to increase memory for list.");
                     return false;
                 }
-                memcpy(tmp, array, size * sizeof(Type));
+                CopyElements(tmp, array, size);
                 size = index + ALLOC_BLOCK_SIZE;
                 delete []array;
                 array = tmp;
@@ -7,6 +7,7 @@
 
 #include "U8String.h"
 #include "ComponentData.h"
+#include "SystemErrorHandlers.h"
 
 /// \desc Module defines a single module i.e. class in the DSL language.
 class Module
@@ -20,9 +21,10 @@ public:
     U8String file = {};
     U8String script = {};
 
-    /// \desc Run time system events that have handlers for this module.
+    /// \desc Run time system events that have handlers for this module, the name of the handler
+    ///       function or an empty string.
     /// \remark system events are kept in the same order and range as the system error handlers enumeration.
-    List<U8String> systemEvents = {};
+    U8String systemEvents[ON_RIGHT_DOWN + 1] = {};
 
     /// \desc User events are events that the program can raise to send a message to another part
     ///       of the program. This allows cross script communication.
@@ -0,0 +1,105 @@
+/// \file   NumericArray.h
+///         Element wise arithmetic on collections of numbers using vector instructions.
+
+#ifndef DSL_CPP_NUMERICARRAY_H
+#define DSL_CPP_NUMERICARRAY_H
+
+#ifndef NUMERIC_ARRAY_BLOCK
+#undef NUMERIC_ARRAY_BLOCK
+#endif
+#define NUMERIC_ARRAY_BLOCK 256
+
+#include "dsl_types.h"
+#include "TokenTypes.h"
+#include "Opcodes.h"
+#include "Collection.h"
+
+class DslValue;
+
+/// \desc A block of elements of a collection that are all integers or all doubles copied into
+///       one contiguous array so element wise operations run as vector loops instead of going
+///       through DslValue::BinaryOperation for every element. The loops use AVX2 when the
+///       processor has it, SSE2 on other x86-64 processors and plain loops elsewhere.
+/// \remark Elements are DslValues that the runtime changes through their addresses so the array
+///         is a copy of them, Load gathers the values and Store writes the results back. A
+///         collection is worked on NUMERIC_ARRAY_BLOCK elements at a time so each element is
+///         still in the cache when its result is stored.
+class NumericArray
+{
+public:
+    /// \desc Creates an empty array.
+    NumericArray()
+    {
+        type = INTEGER_VALUE;
+        count = 0;
+    }
+
+    /// \desc Runs an operation on every element of a collection if the collection is an array of
+    ///       numbers the operation has a vector loop for, see DslValue::BinaryOperation.
+    /// \param left Collection changed by the operation.
+    /// \param op Operation to run.
+    /// \param right Collection of the same size and element type or a value that is converted
+    ///        to the element type the same way the elements would convert it.
+    /// \return Number of elements changed starting with the first, the rest have to be changed
+    ///         element by element.
+    static int64_t Operation(DslValue *left, OPCODES op, DslValue *right);
+
+    /// \desc Replaces every element of a collection and the collections it contains with the
+    ///       result of a math function, elements that are not doubles are converted first.
+    /// \param collection Collection to change, it must have elements of its own.
+    /// \param function Function to call, SquareRoot and Absolute run as vector loops.
+    static void Apply(DslValue *collection, double (*function)(double));
+
+    /// \desc sqrt as a function that Apply can run as a vector loop.
+    static double SquareRoot(double value);
+
+    /// \desc fabs as a function that Apply can run as a vector loop.
+    static double Absolute(double value);
+
+    /// \desc Copies up to NUMERIC_ARRAY_BLOCK elements of a collection.
+    /// \param collection Collection to copy.
+    /// \param start Index of the first element to copy.
+    /// \param elementType INTEGER_VALUE or DOUBLE_VALUE, copying stops at the first element
+    ///        of another type.
+    /// \return Number of elements copied.
+    int64_t Load(Collection *collection, int64_t start, TokenTypes elementType);
+
+    /// \desc Writes the values back to the elements they were loaded from, the elements become
+    ///       the type of the array.
+    void Store();
+
+    /// \desc Runs an operation on each pair of elements of two arrays of the same type and size.
+    /// \return False if there is no vector loop for the operation and type.
+    bool Apply(OPCODES op, NumericArray *right);
+
+    /// \desc Runs an operation on each element and a value of the array's type.
+    /// \return False if there is no vector loop for the operation and type.
+    bool Apply(OPCODES op, int64_t right);
+
+    /// \desc Runs an operation on each element and a value of the array's type.
+    /// \return False if there is no vector loop for the operation and type.
+    bool Apply(OPCODES op, double right);
+
+    /// \desc Replaces each element of an array of doubles with the result of a function.
+    void Apply(double (*function)(double));
+
+    /// \desc Checks if an operation has a vector loop for a type of element.
+    static bool IsVectorOperation(OPCODES op, TokenTypes elementType);
+
+    /// \desc INTEGER_VALUE or DOUBLE_VALUE.
+    TokenTypes type;
+
+    /// \desc Number of elements.
+    int64_t count;
+
+    /// \desc Elements the values were loaded from.
+    DslValue *elements[NUMERIC_ARRAY_BLOCK];
+
+    /// \desc Values if the type is INTEGER_VALUE.
+    int64_t integers[NUMERIC_ARRAY_BLOCK];
+
+    /// \desc Values if the type is DOUBLE_VALUE.
+    double doubles[NUMERIC_ARRAY_BLOCK];
+};
+
+#endif //DSL_CPP_NUMERICARRAY_H
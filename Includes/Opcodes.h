@@ -66,6 +66,44 @@ enum OPCODES
     RFE,    //Return from event.
     CID,    //Change module id.
     COM,    //sValue contains packed byte data describing a component.
+    ITS,    //Iteration start, the collection on the top of the stack is shared with the iterator variable.
+    ITN,    //Iteration next, moves to the next element or jumps to location when there are no more.
+    ITK,    //Iteration key, saves the key of the current element, location is the iterator variable.
+    ITV,    //Iteration value, saves the current element, location is the iterator variable.
+
+    //Fused instructions. These are never produced by the compiler or serialized, the CPU creates them
+    //at load time by replacing the first instruction of a common instruction sequence. The rest of the
+    //sequence is left in place and supplies the operands of the fused instruction.
+    AVI,    //Assign variable immediate: PVA v; PSV v; PSI c; op; SAV  v = v op c
+    AVV,    //Assign variable variable: PVA v; PSV v; PSV w; op; SAV  v = v op w
+    SVI,    //Save variable immediate: PVA v; PSI c; SAV  v = c
+    LOI,    //Local operation immediate: PSL x; PSI c; op; SLV
+    CVI,    //Compare variable immediate and branch: PSV v; PSI c; test; JIF or JIT
+    CVV,    //Compare variable variable and branch: PSV v; PSV w; test; JIF or JIT
+    CLI,    //Compare local immediate and branch: PSL x; PSI c; test; JIF or JIT
+
+    //Quickened instructions. The CPU rewrites a generic arithmetic or test instruction into one of
+    //these when it sees both operands are integers (_II) or both are doubles (_DD). Each one checks
+    //its operand types and rewrites itself back to the generic instruction if they don't match.
+    ADD_II, //Add integers
+    SUB_II, //Subtract integers
+    MUL_II, //Multiply integers
+    TEQ_II, //Test if integers are equal
+    TNE_II, //Test if integers are not equal
+    TGR_II, //Test if integer is greater than
+    TGE_II, //Test if integer is greater than or equal
+    TLS_II, //Test if integer is less than
+    TLE_II, //Test if integer is less than or equal
+    ADD_DD, //Add doubles
+    SUB_DD, //Subtract doubles
+    MUL_DD, //Multiply doubles
+    DIV_DD, //Divide doubles
+    TEQ_DD, //Test if doubles are equal
+    TNE_DD, //Test if doubles are not equal
+    TGR_DD, //Test if double is greater than
+    TGE_DD, //Test if double is greater than or equal
+    TLS_DD, //Test if double is less than
+    TLE_DD, //Test if double is less than or equal
 };
 
 #endif //DSL_CPP_OPCODES_H
@@ -0,0 +1,103 @@
+/// \file   SymbolTable.h
+///         Process wide table of interned strings.
+
+#ifndef DSL_CPP_SYMBOLTABLE_H
+#define DSL_CPP_SYMBOLTABLE_H
+
+#ifndef SYMBOL_TABLE_MIN_SLOTS
+#define SYMBOL_TABLE_MIN_SLOTS 1024
+#endif
+
+#include <atomic>
+#include <mutex>
+#include "dsl_types.h"
+#include "U8String.h"
+
+/// \desc An interned string. There is only one symbol for each distinct text so two symbols are
+///       equal when they are the same symbol, no characters have to be compared.
+/// \remark Symbols are never changed once they are interned so they can be read by any number of
+///         threads without locking. A symbol is reference counted, it is freed when the last key
+///         using it releases it, see SymbolTable::Release.
+class Symbol
+{
+public:
+    /// \desc Creates a symbol with a copy of the text and one reference.
+    /// \param value Text of the symbol.
+    /// \param valueHash Hash of the text.
+    Symbol(U8String *value, uint32_t valueHash) : text(*value)
+    {
+        hash = valueHash;
+        references = 1;
+    }
+
+    /// \desc Adds a reference to a symbol the caller already holds a reference to.
+    void AddReference() { references.fetch_add(1, std::memory_order_relaxed); }
+
+    /// \desc Text of the symbol, it must not be changed.
+    U8String text;
+
+    /// \desc Hash of the text computed when the symbol was interned, see U8String::Hash.
+    uint32_t hash;
+
+    /// \desc Number of keys using the symbol.
+    std::atomic<int64_t> references;
+};
+
+/// \desc Interns strings so each distinct text in use is stored once. The keys of every collection
+///       are interned, copies of a key share its symbol and its hash is only computed when the
+///       symbol is looked up. The table is open addressing with a size that is a power of two,
+///       doubled when it is three quarters full.
+/// \remark Interning and releasing the last reference to a symbol lock the table, reading a
+///         symbol or adding a reference to it does not. A symbol is removed from the table when
+///         its last reference is released so the table only holds the keys that are in use.
+class SymbolTable
+{
+public:
+    /// \desc Gets the symbol for a text, adding it if it is not in the table yet.
+    /// \param text Text to intern.
+    /// \return The text's symbol with a reference for the caller or nullptr if out of memory.
+    static Symbol *Intern(U8String *text);
+
+    /// \desc Gets the symbol for a text whose hash is already known.
+    /// \param text Text to intern.
+    /// \param hash Hash of the text, see U8String::Hash.
+    /// \return The text's symbol with a reference for the caller or nullptr if out of memory.
+    static Symbol *Intern(U8String *text, uint32_t hash);
+
+    /// \desc Gets the symbol for a c string, adding it if it is not in the table yet.
+    /// \param text Null terminated text to intern.
+    /// \return The text's symbol with a reference for the caller or nullptr if out of memory.
+    static Symbol *Intern(const char *text);
+
+    /// \desc Releases a reference to a symbol, the symbol is removed from the table and freed
+    ///       when it was the last one.
+    /// \param symbol Symbol to release, nullptr is ignored.
+    static void Release(Symbol *symbol);
+
+    /// \desc Number of symbols interned.
+    static int64_t Count();
+
+private:
+    /// \desc Doubles the slots and places the symbols in them again, called with the lock held.
+    /// \return True if successful or false if out of memory.
+    static bool Grow();
+
+    /// \desc Empties a slot and moves the symbols after it that would no longer be found into
+    ///       the empty slot, called with the lock held.
+    /// \param slot Slot to empty.
+    static void Remove(int64_t slot);
+
+    /// \desc Protects the slots while a symbol is interned.
+    static std::mutex lock;
+
+    /// \desc Open addressing table of the symbols, nullptr for an empty slot.
+    static Symbol **slots;
+
+    /// \desc Number of slots minus one.
+    static int64_t slotMask;
+
+    /// \desc Number of symbols in the slots.
+    static int64_t count;
+};
+
+#endif //DSL_CPP_SYMBOLTABLE_H
@@ -241,6 +241,13 @@ enum TokenTypes
     , INVALID_EXPRESSION   = TOKEN_ERROR     | NONE          | NONE       | SET_BINDING_POWER(100) | SET_TOKEN_ID(124)
     , EVENT_RETURN         = TOKEN_STATEMENT | NONE          | NONE       | SET_BINDING_POWER(100) | SET_TOKEN_ID(125)
     , COMPONENT            = TOKEN_STATEMENT | NONE          | NONE       | SET_BINDING_POWER(100) | SET_TOKEN_ID(126)
+    , FOREACH              = TOKEN_STATEMENT | NONE          | NONE       | SET_BINDING_POWER(100) | SET_TOKEN_ID(127)
+    , FOREACH_COND_BEGIN   = TOKEN_PARSER    | NONE          | NONE       | SET_BINDING_POWER(100) | SET_TOKEN_ID(128)
+    , FOREACH_COND_END     = TOKEN_PARSER    | NONE          | NONE       | SET_BINDING_POWER(100) | SET_TOKEN_ID(129)
+    , FOREACH_KEY          = TOKEN_PARSER    | NONE          | NONE       | SET_BINDING_POWER(100) | SET_TOKEN_ID(130)
+    , FOREACH_VALUE        = TOKEN_PARSER    | NONE          | NONE       | SET_BINDING_POWER(100) | SET_TOKEN_ID(131)
+    , FOREACH_BLOCK_BEGIN  = TOKEN_PARSER    | NONE          | NONE       | SET_BINDING_POWER(100) | SET_TOKEN_ID(132)
+    , FOREACH_BLOCK_END    = TOKEN_PARSER    | NONE          | NONE       | SET_BINDING_POWER(100) | SET_TOKEN_ID(133)
 };
 #pragma clang diagnostic pop
 
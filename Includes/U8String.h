@@ -17,27 +17,40 @@
 #include "LocationInfo.h"
 #include "List.h"
 
+#ifdef U8STRING_INLINE_SIZE
+#undef U8STRING_INLINE_SIZE
+#endif
+/// \desc Number of bytes a string can hold without allocating memory.
+#define U8STRING_INLINE_SIZE 22
+
 /// \desc Implements a string Type that works with UTF8 Characters.
-/// \remark if the DEBUG macro is specified then all U8Strings will copy
-///         a cText version to an internal character buffer for ease of
-///         reading and display in the debugger.
+/// \remark The characters are stored as UTF8 bytes in one null terminated buffer, strings of up
+///         to U8STRING_INLINE_SIZE bytes are kept inside the U8String so they do not allocate
+///         any memory. Characters are indexed by position, a string that is all ASCII is
+///         indexed by byte, any other string builds an index of where each character starts
+///         the first time a character is read by position.
 class U8String
 {
 public:
     /// \desc Gets the length of the string in characters.
     /// \return The length of the string in characters.
     /// \remark A multibyte UTF8 character is considered as a single character.
-    size_t Count()  { return buffer->Count(); }
+    size_t Count()  { return count; }
+
+    /// \desc Gets the length of the string in bytes not counting the null terminator.
+    int64_t Length() { return length; }
 
     /// \desc Checks if the buffer is empty.
     /// \return True of the u8String does not contain any characters, else false.
     bool IsEmpty() { return Count() == 0; }
 
+    /// \desc Checks if every character is a single byte ASCII character.
+    bool IsAscii() { return count == length; }
+
     /// \desc Creates a blank UTF8 string.
     U8String()
     {
-        buffer = new List<u8chr>();
-        ascii = new List<char>();
+        Initialize();
     }
 
     /// \desc Creates a new UTF8 string and initializes it with the provided cString.
@@ -47,11 +60,23 @@ public:
     /// \param u8String String to use to initialize this U8String.
     explicit U8String(U8String *u8String);
 
+    /// \desc Creates a new U8String with a copy of the characters of another U8String.
+    U8String(const U8String &u8String)
+    {
+        Initialize();
+        AppendBytes(u8String.text, u8String.length, u8String.count);
+        hash = u8String.hash;
+        hashed = u8String.hashed;
+    }
+
     /// \desc Frees the resources used by the U8String.
     ~U8String()
     {
-        delete buffer;
-        delete ascii;
+        if ( text != small )
+        {
+            free(text);
+        }
+        delete offsets;
     }
 
     /// \desc Appends a single character to the end of the null terminated string in the buffer.
@@ -70,10 +95,19 @@ public:
     /// \desc Checks if the character string is equal to this UTF8 string.
     bool IsEqual(const char *string);
 
+    /// \desc Jenkins hash of the characters of the string, used by all of the string keyed tables.
+    ///       The hash is kept until the string is changed so a key is only hashed once.
+    /// \return The hash value, tables reduce it to the number of their slots.
+    /// \remark The Jenkins hash function us used since it is one of the hash that is quite good at avoiding
+    ///         key collisions when used with non-deterministic string values.
+    uint32_t Hash();
+
     /// \desc Checks if this UTF8 string is greater than the passed in UTF8 string.
+    /// \remark A longer string is greater, strings of the same length are ordered by their first
+    ///         character that is different.
     bool IsGreater(U8String *string);
 
-    /// \desc Checks if this UTF8 string is less than the passed in UTF8 string.
+    /// \desc Checks if this UTF8 string is less than the passed in UTF8 string, see IsGreater.
     bool IsLess(U8String *string);
 
     /// \desc Gets an integer representation of the numbers in the buffer.
@@ -95,41 +129,39 @@ public:
 
     /// \desc Sets the length of the UTF8String to 0.
     /// \param this Pointer to the string structure.
+    /// \remark The memory used by the characters is kept for the next characters added.
     inline void Clear()
     {
-        buffer->Clear();
-        ascii->Clear();
-        buffer->Set(0, 0);
-        ascii->Set(0,0);
+        length = 0;
+        count = 0;
+        text[0] = '\0';
+        hashed = false;
+        ClearOffsets();
     }
 
+    /// \desc Replaces the characters of this string with a copy of the characters of u8String.
     void CopyFrom(U8String *u8String)
     {
         if ( this == u8String )
         {
             return;
         }
-        buffer->Clear();
-        ascii->Clear();
-
-        for(int64_t ii=0; ii< u8String->Count(); ++ii)
-        {
-            push_back(u8String->get(ii));
-        }
+        Clear();
+        AppendBytes(u8String->text, u8String->length, u8String->count);
+        hash = u8String->hash;
+        hashed = u8String->hashed;
     }
 
-    U8String &operator=(U8String other)
+    /// \desc Replaces the characters of this string with some of the characters of u8String.
+    /// \param u8String String to copy from, it must not be this string.
+    /// \param start Index of the first character to copy.
+    /// \param characters Number of characters to copy, fewer are copied if the string ends first.
+    /// \return True if successful, or false if out of memory.
+    bool CopyFrom(U8String *u8String, int64_t start, int64_t characters);
+
+    U8String &operator=(const U8String &other)
     {
-        if ( this == &other )
-        {
-            return *this;
-        }
-        Clear();
-        size_t count = other.Count();
-        for(int64_t ii=0; ii<count; ++ii)
-        {
-            set(ii, other.get(ii));
-        }
+        CopyFrom((U8String *)&other);
         return *this;
     }
 
@@ -146,9 +178,9 @@ public:
     /// \param d Integer value to convert to a string and store in this string.
     bool CopyFromDouble(double d);
 
-    /// \desc Gets a character string representation of what is stored in the
-    ///       the U8String. Max length is MAX_STRING_LEN_SIZE
-    const char *cStr() { return ascii->Array(); }
+    /// \desc Gets the null terminated UTF8 bytes stored in the U8String.
+    /// \remark The pointer is valid until the string is changed.
+    const char *cStr() { return text; }
 
     /// \desc Gets a character at index in the UTF8 string.
     /// \param index Zero based index in the string.
@@ -159,6 +191,7 @@ public:
     /// \param index Value of the position to set the character to.
     /// \param ch character to set.
     /// \return True if the operation succeeds, else false if the index is out of range.
+    /// \remark Setting the character at index Count() appends it.
     bool set(size_t index, u8chr ch);
 
     /// \desc Gets the index of the character in the string.
@@ -170,15 +203,36 @@ public:
     /// \desc Gets the index of the string in this string.
     /// \param u8String string to check.
     /// \param ignoreCase True if a a case insensitive search should be used, else false.
+    /// \param start Index of the character to start searching at.
     /// \return The index at which the u8string begins in this string or -1 if the string is not found.
-    int64_t IndexOf(U8String *u8String, bool ignoreCase);
+    /// \remark A case insensitive search only ignores the case of ASCII letters.
+    int64_t IndexOf(U8String *u8String, bool ignoreCase, int64_t start = 0);
+
+    /// \desc Changes the ASCII upper case letters to lower case.
+    void ToLower();
+
+    /// \desc Changes the ASCII lower case letters to upper case.
+    void ToUpper();
+
+    /// \desc Gets the number of characters at the start of the string that are in a set.
+    /// \param set Null terminated ASCII characters to skip.
+    int64_t SpanStart(const char *set);
+
+    /// \desc Gets the number of characters at the end of the string that are in a set.
+    /// \param set Null terminated ASCII characters to skip.
+    int64_t SpanEnd(const char *set);
 
     /// \desc Appends the U8String to the end of this u8String.
     bool Append(U8String *u8String);
 
     /// \desc Appends the c string to the end of this u8String.
+    /// \remark The c string is read as UTF8, a byte that is not part of a valid UTF8 character
+    ///         is added as the character with the same value.
     bool Append(const char *cStr);
 
+    /// \desc Appends len bytes of UTF8 text to the end of this u8String, see Append(const char *).
+    bool Append(const char *bytes, int64_t len);
+
     /// \desc Converts the value to a string and appends it to this string.
     bool Append(int64_t i);
 
@@ -188,22 +242,14 @@ public:
     /// \return True if the string is found, else false.
     [[maybe_unused]] bool Contains(U8String *u8String, bool ignoreCase = false)
     {
-        return IndexOf(u8String, ignoreCase);
+        return IndexOf(u8String, ignoreCase) >= 0;
     }
 
     /// \desc Allocates and copies the strings contents to a u8chr array.
     /// \param data Pointer to the buffer to receive the UTF8 characters.
     /// \return True if successful else false.
     /// \remark The caller is responsible for freeing the returned array by calling free.
-    bool GetBuffer(u8chr *data)
-    {
-        for(int64_t ii=0; ii<buffer->Count(); ++ii)
-        {
-            *data++ = buffer->get(ii);
-        }
-
-        return true;
-    }
+    bool GetBuffer(u8chr *data);
 
     /// \desc Checks if the U8String ends with the cString
     /// \param cString C format string containing the characters to check for.
@@ -251,20 +297,85 @@ public:
 
     /// \desc Writes the contents of the u8string to a file.
     /// \param file full path file name of the file to write.
-    /// \param isAscii If true the file is written as a series of bytes, else its written as UTF8.
+    /// \param isAscii If true each character is written as a single byte, else its written as UTF8.
     /// \return True if successful, false if an error occurs.
     bool fwrite(const char *file, bool isAscii);
 
     /// \desc Reads the contents of a file into the u8String.
     /// \param file full path file name of the file to write.
-    /// \param isAscii If true the file is written as a series of bytes, else its written as UTF8.
+    /// \param isAscii If true the file is read as a c string, else it is read as UTF8.
     /// \return True if successful, false if an error occurs.
     bool fread(const char *file, bool isAscii);
 
 private:
-    List<u8chr> *buffer;
-    List<char> *ascii;
+    /// \desc Sets the string to empty using the inline buffer.
+    void Initialize()
+    {
+        text = small;
+        text[0] = '\0';
+        length = 0;
+        count = 0;
+        capacity = U8STRING_INLINE_SIZE;
+        offsets = nullptr;
+        hashed = false;
+    }
+
+    /// \desc Makes sure the buffer can hold bytes bytes plus the null terminator, the buffer
+    ///       at least doubles each time it grows.
+    /// \return True if successful, or false if out of memory.
+    bool Reserve(int64_t bytes);
+
+    /// \desc Appends UTF8 bytes that are known to be valid.
+    /// \param bytes Bytes to append.
+    /// \param len Number of bytes.
+    /// \param characters Number of characters in the bytes.
+    /// \return True if successful, or false if out of memory.
+    bool AppendBytes(const char *bytes, int64_t len, int64_t characters);
+
+    /// \desc Builds the index of where each character starts if it has not been built.
+    /// \return True if successful, or false if out of memory.
+    bool BuildOffsets();
+
+    /// \desc Gets the offset of the first byte of a character, the length if index is Count().
+    int64_t ByteOffset(int64_t index);
+
+    /// \desc Gets the index of the character that starts at a byte offset.
+    int64_t CharacterIndex(int64_t offset);
+
+    /// \desc Frees the character index after the string is changed.
+    void ClearOffsets()
+    {
+        if ( offsets != nullptr )
+        {
+            delete offsets;
+            offsets = nullptr;
+        }
+    }
+
+    /// \desc Null terminated UTF8 bytes, either small or allocated.
+    char *text;
+
+    /// \desc Number of bytes in text not counting the null terminator.
+    int64_t length;
+
+    /// \desc Number of characters in text.
+    int64_t count;
+
+    /// \desc Number of bytes text can hold not counting the null terminator.
+    int64_t capacity;
+
+    /// \desc Byte offset of each character, only built for strings that are not all ASCII when a
+    ///       character is read by position, nullptr if not built.
+    List<int64_t> *offsets;
+
+    /// \desc Hash of the characters, only valid when hashed is true.
+    uint32_t hash;
+
+    /// \desc True if hash has been computed since the string was last changed.
+    bool hashed;
 
+    /// \desc Inline buffer used for strings of up to U8STRING_INLINE_SIZE bytes.
+    char small[U8STRING_INLINE_SIZE + 1];
 };
 
 #endif //DSL_UTF8STRING_H
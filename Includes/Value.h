@@ -0,0 +1,142 @@
+/// \file   Value.h
+///         Compact tagged value used by the CPU runtime for the parameter stack.
+
+#ifndef DSL_CPP_VALUE_H
+#define DSL_CPP_VALUE_H
+
+#include "dsl_types.h"
+#include "TokenTypes.h"
+#include "DslValue.h"
+
+/// \desc A runtime value that fits in 16 bytes, a type tag and a payload. Integers, doubles,
+///       characters and booleans are stored directly in the payload. Strings, collections and
+///       any other value that does not fit are stored in a DslValue that is owned by whoever owns
+///       the value, for the parameter stack this is a DslValue kept per stack slot, and the payload
+///       is the handle to it. Values are plain data so they can be moved around with memcpy by
+///       List. DslValue is still used for the compiled program, global variables and collection
+///       elements.
+class Value
+{
+public:
+    /// \desc Creates an integer value of 0.
+    Value()
+    {
+        type = INTEGER_VALUE;
+        operand = 0;
+        iValue = 0;
+    }
+
+    /// \desc The type of value stored.
+    TokenTypes type;
+
+    /// \desc Local variable index set by the push local instruction and read by the save local
+    ///       instruction. It is not changed when a new value is stored in the slot.
+    int32_t operand;
+
+    union
+    {
+        /// \desc If an integer type this field contains the value.
+        int64_t iValue;
+
+        /// \desc If a double type this field contains the value.
+        double dValue;
+
+        /// \desc If a UTF8 character type this field contains the value.
+        u8chr cValue;
+
+        /// \desc If a boolean type this field contains the value.
+        bool bValue;
+
+        /// \desc For strings, collections and other non scalar types the DslValue holding the data.
+        DslValue *object;
+    };
+
+    /// \desc Checks if values of the type are stored directly in the payload.
+    static bool IsScalar(TokenTypes valueType)
+    {
+        return valueType == INTEGER_VALUE || valueType == DOUBLE_VALUE || valueType == CHAR_VALUE
+               || valueType == BOOL_VALUE;
+    }
+
+    /// \desc Checks if the value is stored directly in the payload.
+    [[nodiscard]] bool IsScalar() const
+    {
+        return IsScalar(type);
+    }
+
+    /// \desc Checks if the value is true, used by the conditional jump instructions.
+    [[nodiscard]] bool IsTrue() const
+    {
+        switch( type )
+        {
+            case BOOL_VALUE:
+                return bValue;
+            case INTEGER_VALUE:
+                return iValue != 0;
+            case DOUBLE_VALUE:
+                return dValue != 0.0;
+            case CHAR_VALUE:
+                return cValue != 0;
+            default:
+                return object->bValue;
+        }
+    }
+
+    /// \desc Sets this value from a DslValue following the same rules as DslValue::LiteCopy.
+    /// \param dslValue DslValue to copy.
+    /// \param box DslValue that stores the data if it is not a scalar, becomes the value's handle.
+    void Load(DslValue *dslValue, DslValue *box)
+    {
+        switch( dslValue->type )
+        {
+            case INTEGER_VALUE:
+                iValue = dslValue->iValue;
+                break;
+            case DOUBLE_VALUE:
+                dValue = dslValue->dValue;
+                break;
+            case CHAR_VALUE:
+                cValue = dslValue->cValue;
+                break;
+            case BOOL_VALUE:
+                bValue = dslValue->bValue;
+                break;
+            default:
+                if ( box != dslValue )
+                {
+                    box->LiteCopy(dslValue);
+                }
+                object = box;
+                break;
+        }
+        type = dslValue->type;
+    }
+
+    /// \desc Writes a scalar value into a DslValue following the same rules as DslValue::LiteCopy.
+    /// \param dslValue DslValue to write to.
+    void Store(DslValue *dslValue) const
+    {
+        dslValue->type = type;
+        switch( type )
+        {
+            default:
+                break;
+            case INTEGER_VALUE:
+                dslValue->iValue = iValue;
+                break;
+            case DOUBLE_VALUE:
+                dslValue->dValue = dValue;
+                break;
+            case CHAR_VALUE:
+                dslValue->cValue = cValue;
+                break;
+            case BOOL_VALUE:
+                dslValue->bValue = bValue;
+                break;
+        }
+    }
+};
+
+static_assert(sizeof(Value) <= 16, "Value must fit in 16 bytes.");
+
+#endif //DSL_CPP_VALUE_H
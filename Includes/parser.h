@@ -72,6 +72,11 @@ private:
 
     List<Token *> switches;
 
+    /// \desc Stack of the foreach loops being generated. switchIndex of each one is the
+    ///       location of its ITN instruction and switchCaseIndex the number of continue
+    ///       locations there were when the loop started.
+    List<Token *> foreachLoops;
+
     /// \desc Function call stack used while processing function calls in expression.
     List<Token *> functionCalls;
 
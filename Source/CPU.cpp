@@ -4,7 +4,7 @@
 // Created by krw10 on 9/7/2023.
 //
 
-#include "../Includes/cpu.h"
+#include "../Includes/CPU.h"
 
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "OCDFAInspection"
@@ -69,41 +69,95 @@ const char *OpCodeNames[] =
         "EFI",    //Event function information
         "RFE",    //Return from event.
         "CID",    //Change module id.
-        "COM"
+        "COM",
+        "ITS",    //Iteration start
+        "ITN",    //Iteration next
+        "ITK",    //Iteration key
+        "ITV",    //Iteration value
+        "AVI",    //Fused assign variable immediate
+        "AVV",    //Fused assign variable variable
+        "SVI",    //Fused save variable immediate
+        "LOI",    //Fused local operation immediate
+        "CVI",    //Fused compare variable immediate and branch
+        "CVV",    //Fused compare variable variable and branch
+        "CLI",    //Fused compare local immediate and branch
+        "ADD_II", //Quickened instructions
+        "SUB_II",
+        "MUL_II",
+        "TEQ_II",
+        "TNE_II",
+        "TGR_II",
+        "TGE_II",
+        "TLS_II",
+        "TLE_II",
+        "ADD_DD",
+        "SUB_DD",
+        "MUL_DD",
+        "DIV_DD",
+        "TEQ_DD",
+        "TNE_DD",
+        "TGR_DD",
+        "TGE_DD",
+        "TLS_DD",
+        "TLE_DD"
 };
 
-int64_t  CPU::errorCode;
-U8String CPU::szErrorMsg;
+thread_local CPU *CPU::current = nullptr;
+
+/// \desc Makes a CPU the current CPU of the calling thread for as long as the object exists,
+///       the previous current CPU is restored when it is destroyed.
+class CurrentCPU
+{
+public:
+    explicit CurrentCPU(CPU *cpu)
+    {
+        previous = CPU::current;
+        CPU::current = cpu;
+    }
+
+    ~CurrentCPU()
+    {
+        CPU::current = previous;
+    }
+
+private:
+    CPU *previous;
+};
+
+/// \desc Reads the monotonic clock used to schedule on tick events.
+/// \return Time in nanoseconds.
+static int64_t MonotonicTime()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 /////////////////////////////////////////////////////
 /// library allows adding external function calls ///
 /////////////////////////////////////////////////////
 
-int64_t totalParameters = -1;
-
 int64_t OpenParameterStack(CPU *cpu)
 {
-    if ( totalParameters == -1 )
+    if ( cpu->totalParameters == -1 )
     {
-        totalParameters = cpu->params[cpu->top].iValue;
+        cpu->totalParameters = cpu->params.At(cpu->top).iValue;
     }
 
-    return totalParameters;
+    return cpu->totalParameters;
 }
 
 void CloseParameterStack(CPU *cpu, DslValue *returnValue)
 {
-    cpu->top -= totalParameters + 1;
+    cpu->top -= cpu->totalParameters + 1;
     ++cpu->top;
-    cpu->params[cpu->top].LiteCopy(returnValue);
+    cpu->SetSlot(cpu->top, returnValue);
 
-    totalParameters = -1;
+    cpu->totalParameters = -1;
 }
 
 DslValue *GetParameter(CPU *cpu, int64_t number)
 {
-    DslValue *v = &cpu->params[(cpu->top - totalParameters) + number];
-    return &cpu->params[(cpu->top - totalParameters) + number];
+    return cpu->SlotValue((cpu->top - cpu->totalParameters) + number);
 }
 
 /*
@@ -117,7 +171,7 @@ void CPU::DisplayASMCodeLines(List<DslValue *> &programInstructions)
 {
     int64_t addr = 0;
 
-    while(addr < program.Count() )
+    while(addr < programInstructions.Count() )
     {
         addr = DisplayASMCodeLine(programInstructions, addr) + 1;
     }
@@ -154,6 +208,9 @@ int64_t CPU::DisplayASMCodeLine(List<DslValue *> &programInstructions, int64_t a
         case TEQ:  case TNE: case TGR:  case TGE: case TLS:
         case TLE: case AND: case LOR: case ADA: case SUA: case MUA: case DIA: case MOA:
         case RFE:
+        case ADD_II: case SUB_II: case MUL_II: case TEQ_II: case TNE_II: case TGR_II: case TGE_II:
+        case TLS_II: case TLE_II: case ADD_DD: case SUB_DD: case MUL_DD: case DIV_DD: case TEQ_DD:
+        case TNE_DD: case TGR_DD: case TGE_DD: case TLS_DD: case TLE_DD:
             break;
         case EFI:
             putchar('\t');
@@ -165,6 +222,12 @@ int64_t CPU::DisplayASMCodeLine(List<DslValue *> &programInstructions, int64_t a
         case PVA:
             printf("\t&%s", dslValue->variableName.cStr());
             break;
+        case ITS: case ITK: case ITV:
+            printf("\t%s", dslValue->variableName.cStr());
+            break;
+        case ITN:
+            printf("\t%s, end:%4.4llx", dslValue->variableName.cStr(), (long long int)dslValue->location);
+            break;
         case DCS:
             printf("\t&%s[%llx]", dslValue->variableName.cStr(), (long long int)dslValue->iValue);
             break;
@@ -214,6 +277,10 @@ int64_t CPU::DisplayASMCodeLine(List<DslValue *> &programInstructions, int64_t a
         case JMP: case JSR:
             printf("\t%4.4llx", (long long int)dslValue->location);
             break;
+        case AVI: case AVV: case SVI: case LOI: case CVI: case CVV: case CLI:
+            //Only in a loaded CPU's code, DisplayASMCodeLine(addr) shows their operands.
+            printf("\t;fused, operands in the instructions that follow");
+            break;
     }
     if (newline)
     {
@@ -223,6 +290,89 @@ int64_t CPU::DisplayASMCodeLine(List<DslValue *> &programInstructions, int64_t a
     return addr;
 }
 
+/// \desc Displays the IL Assembly for the program loaded in this CPU.
+void CPU::DisplayASMCodeLines()
+{
+    int64_t addr = 0;
+
+    while(addr < codeCount )
+    {
+        addr = DisplayASMCodeLine(addr) + 1;
+    }
+}
+
+/// \desc Displays a single instruction loaded in this CPU. Fused instructions are shown
+///       with the operands of the sequence they replace.
+int64_t CPU::DisplayASMCodeLine(int64_t addr, bool newline)
+{
+    Instruction *instruction = &code[addr];
+    int64_t length = FusedLength(instruction->opcode);
+
+    if ( length == 0 )
+    {
+        //A quickened instruction is shown by the name of the typed version the CPU runs, its
+        //image instruction is still the generic one.
+        if ( instruction->opcode != image->instructions[addr]->opcode )
+        {
+            printf("%4.4llx\t%s", (long long int)addr, OpCodeNames[instruction->opcode]);
+            if (newline)
+            {
+                printf("\n");
+            }
+            return addr;
+        }
+        return DisplayASMCodeLine(image->instructions, addr, newline);
+    }
+
+    printf("%4.4llx\t%s\t", (long long int)addr, OpCodeNames[instruction->opcode]);
+    switch( instruction->opcode )
+    {
+        default:
+            break;
+        case AVI: case AVV:
+            printf("%s = %s %s ",
+                   image->instructions[addr]->variableName.cStr(),
+                   image->instructions[addr+1]->variableName.cStr(),
+                   OpCodeNames[code[addr+3].opcode]);
+            if ( instruction->opcode == AVI )
+            {
+                image->instructions[addr+2]->Print(true);
+            }
+            else
+            {
+                printf("%s", image->instructions[addr+2]->variableName.cStr());
+            }
+            break;
+        case SVI:
+            printf("%s = ", image->instructions[addr]->variableName.cStr());
+            image->instructions[addr+1]->Print(true);
+            break;
+        case LOI:
+            printf("%s %s ", image->instructions[addr]->variableName.cStr(), OpCodeNames[code[addr+2].opcode]);
+            image->instructions[addr+1]->Print(true);
+            printf(", SLV");
+            break;
+        case CVI: case CVV: case CLI:
+            printf("%s %s ", image->instructions[addr]->variableName.cStr(), OpCodeNames[code[addr+2].opcode]);
+            if ( instruction->opcode == CVV )
+            {
+                printf("%s", image->instructions[addr+1]->variableName.cStr());
+            }
+            else
+            {
+                image->instructions[addr+1]->Print(true);
+            }
+            printf(", %s %4.4llx", OpCodeNames[code[addr+3].opcode], (long long int)code[addr+3].location);
+            break;
+    }
+    if (newline)
+    {
+        printf("\n");
+    }
+
+    return addr + length - 1;
+}
+
 /// \desc Raised an error event, currently only prints but will be changed as soon
 ///       as the eventing system is in place.
 void CPU::Error(DslValue *dslError)
@@ -315,6 +465,12 @@ int64_t CPU::Find(U8String *search, U8String *expression, int64_t start)
         return -1;
     }
 
+    //An expression without special characters is plain text and can be searched for as bytes.
+    if ( strpbrk(expression->cStr(), "CBSUuADNPGpX?%") == nullptr )
+    {
+        return search->IndexOf(expression, false, start);
+    }
+
     int64_t offset = 0;
     bool caselessCompare = false;
     int64_t location = -1;
@@ -471,6 +627,7 @@ void CPU::pfn_string_len()
     auto *param1 = GetParameter(this, 0);
 
     param1->Convert(STRING_VALUE);
+    A->type = INTEGER_VALUE;
     A->iValue = (int64_t)param1->sValue.Count();
 
     CloseParameterStack(this, A);
@@ -562,14 +719,8 @@ void CPU::pfn_string_tolower()
     search.CopyFrom(&param1->sValue);
 
     A->type = STRING_VALUE;
-    A->sValue.Clear();
-
-    for(int64_t ii=0; ii<search.Count(); ++ii)
-    {
-        u8chr ch = search.get(ii);
-        ch = tolower((int)ch);
-        A->sValue.push_back(ch);
-    }
+    A->sValue.CopyFrom(&search);
+    A->sValue.ToLower();
 
     CloseParameterStack(this, A);
 }
@@ -585,16 +736,35 @@ void CPU::pfn_string_toupper()
     search.CopyFrom(&param1->sValue);
 
     A->type = STRING_VALUE;
-    A->sValue.Clear();
+    A->sValue.CopyFrom(&search);
+    A->sValue.ToUpper();
+
+    CloseParameterStack(this, A);
+}
 
-    for(int64_t ii=0; ii<search.Count(); ++ii)
+/// \desc Gets the characters a trim expression character matches if they are a small set of
+///       ASCII characters that U8String::SpanStart and U8String::SpanEnd can skip.
+/// \param ex Expression character, see IsMatch.
+/// \param literal Receives the set if ex only matches itself.
+/// \return The set or nullptr if the characters have to be checked with IsMatch.
+static const char *TrimCharacters(u8chr ex, char literal[2])
+{
+    switch( ex )
     {
-        u8chr ch = search.get(ii);
-        ch = toupper((int)ch);
-        A->sValue.push_back(ch);
+        case 'S': return " \t\n\v\f\r";
+        case 'B': return " \t";
+        case 'C': case 'U': case 'u': case 'A': case 'D': case 'N':
+        case 'P': case 'G': case 'p': case 'X': case '?': case U8_NULL_CHR:
+            return nullptr;
+        default:
+            if ( ex >= 0x80 )
+            {
+                return nullptr;
+            }
+            literal[0] = (char)ex;
+            literal[1] = '\0';
+            return literal;
     }
-
-    CloseParameterStack(this, A);
 }
 
 void CPU::pfn_string_trimEnd()
@@ -616,26 +786,24 @@ void CPU::pfn_string_trimEnd()
 
     int64_t offset = 0;
     u8chr ex = GetExChar(&expression, offset);
-    bool copy = false;
-    A->type = STRING_VALUE;
-    A->sValue.Clear();
-
-    for(int64_t ii=(int64_t)search.Count()-1; ii>=0; --ii)
+    char literal[2];
+    const char *set = TrimCharacters(ex, literal);
+    int64_t count = (int64_t)search.Count();
+    if ( set != nullptr )
     {
-        u8chr ch = search.get(ii);
-        if ( copy )
-        {
-            A->sValue.push_back(ch);
-            continue;
-        }
-        if (IsMatch(ch, ex, false))
+        count -= search.SpanEnd(set);
+    }
+    else
+    {
+        while( count > 0 && IsMatch(search.get(count - 1), ex, false) )
         {
-            continue;
+            --count;
         }
-        copy = true;
-        A->sValue.push_back(ch);
     }
 
+    A->type = STRING_VALUE;
+    A->sValue.CopyFrom(&search, 0, count);
+
     CloseParameterStack(this, A);
 }
 
@@ -658,26 +826,24 @@ void CPU::pfn_string_trimStart()
 
     int64_t offset = 0;
     u8chr ex = GetExChar(&expression, offset);
-    bool copy = false;
-    A->type = STRING_VALUE;
-    A->sValue.Clear();
-
-    for(int64_t ii=0; ii<search.Count(); ++ii)
+    char literal[2];
+    const char *set = TrimCharacters(ex, literal);
+    int64_t start = 0;
+    if ( set != nullptr )
     {
-        u8chr ch = search.get(ii);
-        if ( copy )
-        {
-            A->sValue.push_back(ch);
-            continue;
-        }
-        if (IsMatch(ch, ex, false))
+        start = search.SpanStart(set);
+    }
+    else
+    {
+        while( start < search.Count() && IsMatch(search.get(start), ex, false) )
         {
-            continue;
+            ++start;
         }
-        copy = true;
-        A->sValue.push_back(ch);
     }
 
+    A->type = STRING_VALUE;
+    A->sValue.CopyFrom(&search, start, (int64_t)search.Count() - start);
+
     CloseParameterStack(this, A);
 }
 
@@ -692,7 +858,7 @@ void CPU::pfn_string_toCollection()
     jsonString.CopyFrom(&param1->sValue);
 
     JsonParser jp;
-    auto *json = jp.From(&params[top].variableScriptName, &jsonString);
+    auto *json = jp.From(&SlotValue(top)->variableScriptName, &jsonString);
     if ( json->type == ERROR_TOKEN )
     {
         json->type = STRING_VALUE;
@@ -714,12 +880,32 @@ void CPU::pfn_string_fromCollection()
     CloseParameterStack(this, A);
 }
 
+bool CPU::MathOnCollection(DslValue *param, double (*function)(double))
+{
+    if ( param->type != COLLECTION )
+    {
+        return false;
+    }
+
+    A->SAV(param);
+    A->indexes.Detach();
+    NumericArray::Apply(A, function);
+
+    return true;
+}
+
 void CPU::pfn_abs()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
+    if ( MathOnCollection(param, NumericArray::Absolute) )
+    {
+        CloseParameterStack(this, A);
+        return;
+    }
+
+    A->type = DOUBLE_VALUE;
     param->Convert(DOUBLE_VALUE);
 
 #ifdef __linux__
@@ -734,10 +920,14 @@ void CPU::pfn_abs()
 void CPU::pfn_acos()
 {
     auto totalParams = OpenParameterStack(this);
-    A->type = DOUBLE_VALUE;
+
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = acos(param->dValue);
+    if ( !MathOnCollection(param, acos) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = acos(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -746,10 +936,13 @@ void CPU::pfn_asin()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = asin(param->dValue);
+    if ( !MathOnCollection(param, asin) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = asin(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -758,10 +951,13 @@ void CPU::pfn_atan()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = atan(param->dValue);
+    if ( !MathOnCollection(param, atan) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = atan(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -785,10 +981,13 @@ void CPU::pfn_cos()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = cos(param->dValue);
+    if ( !MathOnCollection(param, cos) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = cos(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -797,10 +996,13 @@ void CPU::pfn_sin()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = sin(param->dValue);
+    if ( !MathOnCollection(param, sin) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = sin(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -809,10 +1011,13 @@ void CPU::pfn_tan()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = tan(param->dValue);
+    if ( !MathOnCollection(param, tan) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = tan(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -821,10 +1026,13 @@ void CPU::pfn_cosh()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = cosh(param->dValue);
+    if ( !MathOnCollection(param, cosh) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = cosh(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -833,10 +1041,13 @@ void CPU::pfn_sinh()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = sinh(param->dValue);
+    if ( !MathOnCollection(param, sinh) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = sinh(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -845,10 +1056,13 @@ void CPU::pfn_tanh()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = tanh(param->dValue);
+    if ( !MathOnCollection(param, tanh) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = tanh(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -857,10 +1071,13 @@ void CPU::pfn_exp()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = exp(param->dValue);
+    if ( !MathOnCollection(param, exp) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = exp(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -869,10 +1086,13 @@ void CPU::pfn_log()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = log(param->dValue);
+    if ( !MathOnCollection(param, log) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = log(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -881,10 +1101,13 @@ void CPU::pfn_log10()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = log10(param->dValue);
+    if ( !MathOnCollection(param, log10) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = log10(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -893,10 +1116,13 @@ void CPU::pfn_sqrt()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = sqrt(param->dValue);
+    if ( !MathOnCollection(param, NumericArray::SquareRoot) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = sqrt(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -905,10 +1131,13 @@ void CPU::pfn_ceil()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = ceil(param->dValue);
+    if ( !MathOnCollection(param, ceil) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = ceil(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -917,10 +1146,13 @@ void CPU::pfn_fabs()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = fabs(param->dValue);
+    if ( !MathOnCollection(param, NumericArray::Absolute) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = fabs(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -929,10 +1161,13 @@ void CPU::pfn_floor()
 {
     auto totalParams = OpenParameterStack(this);
 
-    A->type = DOUBLE_VALUE;
     auto *param = GetParameter(this, 0);
-    param->Convert(DOUBLE_VALUE);
-    A->dValue = floor(param->dValue);
+    if ( !MathOnCollection(param, floor) )
+    {
+        A->type = DOUBLE_VALUE;
+        param->Convert(DOUBLE_VALUE);
+        A->dValue = floor(param->dValue);
+    }
 
     CloseParameterStack(this, A);
 }
@@ -1150,7 +1385,7 @@ void CPU::pfn_files()
                         CloseParameterStack(this, json);
                         return;
                     }
-                    files->indexes.Set(keyData[ii]->Key(), json);
+                    files->indexes.Set(keyData[ii]->KeySymbol(), json);
                 }
                 else
                 {
@@ -1158,7 +1393,7 @@ void CPU::pfn_files()
                     value->type = STRING_VALUE;
                     value->sValue.CopyFrom(&text);
 
-                    files->indexes.Set(keyData[ii]->Key(), value);
+                    files->indexes.Set(keyData[ii]->KeySymbol(), value);
                 }
             }
         }
@@ -1179,9 +1414,9 @@ void CPU::pfn_delete()
 }
 
 //Random number generator constants.
-static uint64_t       state      = 0x4d595df4d0f33173;		// Or something seed-dependent
-static uint64_t const multiplier = 6364136223846793005u;
-static uint64_t const increment  = 1442692040788163497u;	// Or an arbitrary odd constant
+static uint64_t const initialState = 0x4d595df4d0f33173;	// Or something seed-dependent
+static uint64_t const multiplier   = 6364136223846793005u;
+static uint64_t const increment    = 1442692040788163497u;	// Or an arbitrary odd constant
 
 static uint32_t RotateRight32(uint32_t x, unsigned r)
 {
@@ -1190,35 +1425,38 @@ static uint32_t RotateRight32(uint32_t x, unsigned r)
 
 void CPU::pfn_random()
 {
-    uint64_t x = state;
+    uint64_t x = randomState;
     auto count = (uint64_t)(x >> 59); // 59 = 64 - 5
 
-    state = x * multiplier + increment;
+    randomState = x * multiplier + increment;
     x ^= x >> 18; // 18 = (64 - 27)/2
     int64_t m = RotateRight32((uint32_t)(x >> 27), count); // 27 = 32 - 5
 
-    auto totalParams = params[top].iValue;
-    params[top-totalParams].Convert(INTEGER_VALUE);
-    int64_t low = params[top-totalParams].iValue;
+    auto totalParams = params.At(top).iValue;
+    DslValue *param = SlotValue(top-totalParams);
+    param->Convert(INTEGER_VALUE);
+    int64_t low = param->iValue;
 
-    params[top-totalParams+1].Convert(INTEGER_VALUE);
-    int64_t high = params[top-totalParams+1].iValue;
+    param = SlotValue(top-totalParams+1);
+    param->Convert(INTEGER_VALUE);
+    int64_t high = param->iValue;
 
     int64_t delta = (high + 1) - low;
 
     A->type = INTEGER_VALUE;
     A->iValue = low + (m % delta);
-    params[++top].LiteCopy(A);
 
     top -= totalParams + 1;
+    SetSlot(++top, A);
 }
 
 void CPU::pfn_seed()
 {
-    auto totalParams = params[top].iValue;
+    auto totalParams = params.At(top).iValue;
 
-    params[top-totalParams].Convert(INTEGER_VALUE);
-    state = params[top-totalParams].iValue;
+    DslValue *param = SlotValue(top-totalParams);
+    param->Convert(INTEGER_VALUE);
+    randomState = param->iValue;
 
     top -= totalParams;
 }
@@ -1265,36 +1503,88 @@ CPU::method_function builtInMethods[] =
          &CPU::pfn_seed
  };
 
-void CPU::JumpToBuiltInFunction(DslValue *dslValue)
+void CPU::JumpToBuiltInFunction(Instruction *instruction)
 {
-    (this->*builtInMethods[dslValue->operand])();
+    (this->*builtInMethods[instruction->operand])();
+    CheckStack();
 }
 
 /// \desc calls a compiled script function.
 /// remarks
 ///locals are set in order encountered after parameters and start at operand == 0 and
 ///each local adds 1 to the operand.
-void CPU::JumpToSubroutine(DslValue *dslValue)
+void CPU::JumpToSubroutine(Instruction *instruction)
 {
-    auto totalParams = params[top].iValue;
+    CountBranch();
 
-    int64_t pcReturn = PC;
-    int64_t saved = BP;
-    BP = top - totalParams;
-    PC = dslValue->location;
-    RunNoTrace();   //BUG-BUG: no way to run traced when calling a script function
-    A->SAV(&params[top]);
-    --top;
-    BP = saved;
-    top -= totalParams + 1;
-    params[++top].SAV(A);
-    PC = pcReturn;
+    auto totalParams = params.At(top).iValue;
+    int64_t first = top - totalParams;
+
+    //return f(...), the caller returns what the function returns so if nothing but the caller's
+    //parameters are below the function's parameters they are replaced and the caller's frame is
+    //used for the function. The value returned ends up in the same slot either way.
+    if ( code[PC].opcode == RET && frames.Count() > frameBase )
+    {
+        CallFrame *caller = &frames.Last();
+        if ( first == BP + caller->totalParams + 1 )
+        {
+            for(int64_t ii=0; ii<=totalParams; ++ii)
+            {
+                CopySlot(BP + ii, first + ii);
+                params.At(BP + ii).operand = params.At(first + ii).operand;
+            }
+            top = BP + totalParams;
+            caller->totalParams = totalParams;
+            PC = instruction->location;
+            CheckFrame(PC);
+            return;
+        }
+    }
+
+    if ( frames.Count() >= maxCallDepth )
+    {
+        PrintIssue(4006, true, false, "Maximum function call depth of %ld exceeded", (long)maxCallDepth);
+        return;
+    }
+
+    CallFrame frame = { PC, BP, totalParams, false };
+    frames.push_back(frame);
+    BP = first;
+    PC = instruction->location;
+    CheckFrame(PC);
+}
+
+bool CPU::ReturnFromSubroutine()
+{
+    if ( frames.Count() == frameBase )
+    {
+        return false;
+    }
+
+    CallFrame *frame = &frames.pop_back();
+    int64_t result = top - frame->totalParams - 1;
+    CopySlot(result, top);
+    top = result;
+    BP = frame->BP;
+    PC = frame->returnPC;
+
+    return !frame->exitOnReturn;
 }
 
 /// \desc Handles a jump table instruction.
-/// \param dslValue Pointer to the dsl value containing the information needed to execute the jump
-void CPU::ProcessJumpTable(DslValue *dslValue)
+/// \param instruction Pointer to the JTB instruction.
+void CPU::ProcessJumpTable(Instruction *instruction)
 {
+    int64_t location;
+
+    if ( image->jumpTables[instruction->operand]->Find(&params.At(top), location) )
+    {
+        PC = location;
+        --top;
+        return;
+    }
+
+    DslValue *dslValue = instruction->value;
     DslValue *defaultCase = nullptr;
 
     for(int64_t ii=0; ii<dslValue->cases.Count(); ++ii)
@@ -1305,7 +1595,7 @@ void CPU::ProcessJumpTable(DslValue *dslValue)
         }
         else
         {
-            if ( params[top].IsEqual(dslValue->cases[ii]) )
+            if ( SlotValue(top)->IsEqual(dslValue->cases[ii]) )
             {
                 PC = dslValue->cases[ii]->location;
                 --top;
@@ -1328,13 +1618,13 @@ void CPU::ProcessJumpTable(DslValue *dslValue)
 
 /// \desc Translates the IL bytes into a runnable program.
 ///       A program that can be run is a set of dslValues.
-void CPU::DeSerializeIL(BinaryFileReader *binaryFileReader)
+bool CPU::DeSerializeIL(BinaryFileReader *binaryFileReader)
 {
     DslValue *dslValue;
 
     int64_t lastModId = 1;
 
-    instructions.Clear();
+    image->instructions.Clear();
 
     while(!binaryFileReader->eof() )
     {
@@ -1387,10 +1677,17 @@ void CPU::DeSerializeIL(BinaryFileReader *binaryFileReader)
                 }
                 break;
             }
-            case DCS:
+            case DCS: case ITK: case ITV:
                 dslValue->operand = binaryFileReader->GetInt();
                 dslValue->iValue = binaryFileReader->GetInt();
                 break;
+            case ITS:
+                dslValue->operand = binaryFileReader->GetInt();
+                break;
+            case ITN:
+                dslValue->operand = binaryFileReader->GetInt();
+                dslValue->location = binaryFileReader->GetInt();
+                break;
             case CID:
                 lastModId = binaryFileReader->GetInt();
                 dslValue->moduleId = lastModId;
@@ -1414,55 +1711,1093 @@ void CPU::DeSerializeIL(BinaryFileReader *binaryFileReader)
                     binaryFileReader->GetString(&slotData.variable);
                     dslValue->component->slots.push_back(new SlotData(slotData));
                 }
+                dslValue->location = binaryFileReader->GetInt();
                 //Save the location of the com component as it contains the information
                 //about the component.
-                comInstAddr.push_back(instructions.Count());
+                dslValue->operand = image->comInstAddr.Count();
+                image->comInstAddr.push_back(image->instructions.Count());
+                if ( !image->componentIndex.Exists(&dslValue->component->function) )
+                {
+                    image->componentIndex.Set(&dslValue->component->function, dslValue);
+                }
                 break;
             }
+            case AVI: case AVV: case SVI: case LOI: case CVI: case CVV: case CLI:
+            case ADD_II: case SUB_II: case MUL_II: case TEQ_II: case TNE_II: case TGR_II: case TGE_II:
+            case TLS_II: case TLE_II: case ADD_DD: case SUB_DD: case MUL_DD: case DIV_DD: case TEQ_DD:
+            case TNE_DD: case TGR_DD: case TGE_DD: case TLS_DD: case TLE_DD:
+                //Fused and quickened instructions are created when the program is loaded and
+                //run, never serialized.
+                PrintIssue(4007, true, false, "Invalid program, %s instruction at %4.4llx",
+                           opcode < ADD_II ? "fused" : "quickened",
+                           (long long int)image->instructions.Count());
+                delete dslValue;
+                return false;
         }
 
-        instructions.push_back(dslValue);
+        image->instructions.push_back(dslValue);
     }
-}
 
-/// \desc Deserializes the program symbol file and adds those symbols to the
-///       internal program.
-/// \param binaryFileReader Pointer to the binary file reader to use.
-/// \return True if the symbols are added to the program, false if the symbol
-///         file does not exist or can't be read.
-bool CPU::DeSerializeSymbols(BinaryFileReader *binaryFileReader)
-{
-        while( !binaryFileReader->eof() )
+    BuildInstructionStream();
+    image->code = code;
+    image->codeCount = codeCount;
+
+    if ( !VerifyProgram() )
     {
-        int64_t addr = binaryFileReader->GetInt();
-        binaryFileReader->GetString(&instructions[addr]->variableName);
-        binaryFileReader->GetString(&instructions[addr]->variableScriptName);
+        return false;
+    }
+
+    if ( fuseInstructions )
+    {
+        FuseInstructions();
     }
 
     return true;
 }
 
-/// \desc Adds the locations used in the program as its symbols. Used when the symbol file
-///       can't be read or is not present.
-void CPU::SetProgramLocationsAsSymbols()
+/// \desc Packs the deserialized instructions into the dense code array executed by the CPU.
+///       Each packed instruction keeps only the opcode, module, operand and location. Global
+///       variable references are resolved to the variable's storage here so the run loop never
+///       has to index the instructions list.
+void CPU::BuildInstructionStream()
 {
-    for(int ii=0; ii<instructions.Count(); ++ii)
+    delete []code;
+
+    codeCount = image->instructions.Count();
+    //One extra END instruction is added so running off the end of the program always stops.
+    code = new Instruction[codeCount + 1];
+
+    //Index of each instruction's global variable in globalAddr, -1 if not a variable yet.
+    auto *globalIndex = new int64_t[codeCount];
+    for(int64_t ii=0; ii<codeCount; ++ii)
+    {
+        globalIndex[ii] = -1;
+    }
+
+    for(int64_t ii=0; ii<codeCount; ++ii)
     {
-        switch( instructions[ii]->opcode )
+        DslValue *dslValue = image->instructions[ii];
+        Instruction *instruction = &code[ii];
+
+        instruction->opcode = dslValue->opcode;
+        instruction->moduleId = (int32_t)dslValue->moduleId;
+        instruction->operand = dslValue->operand;
+        instruction->location = dslValue->location;
+        instruction->value = nullptr;
+
+        switch( dslValue->opcode )
         {
-            case DEF: case DFL: case EFI:
-            case PVA: case DCS: case PCV:
-            case DEC: case INC:
-            case INL: case DEL: case PSV:
-            case SAV: case SVL: case PSL:
-            case PSP: case CID: case COM:
-                instructions[ii]->variableName.printf(false, (char *)"%llx", (long long int)instructions[ii]->operand);
             default:
                 break;
-        }
-    }
-}
-
+            case PSI: case DEF: case COM:
+                instruction->value = dslValue;
+                break;
+            case JTB:
+                instruction->value = dslValue;
+                instruction->operand = image->jumpTables.Count();
+                image->jumpTables.push_back(new JumpTable(dslValue));
+                break;
+            case PVA: case PSV: case PCV: case INC: case DEC: case ITS: case ITN:
+                instruction->operand = GlobalIndex(dslValue->operand, globalIndex);
+                break;
+            case DCS:
+                instruction->operand = GlobalIndex(dslValue->operand, globalIndex);
+                instruction->location = dslValue->iValue;
+                break;
+            case ITK: case ITV:
+                instruction->operand = GlobalIndex(dslValue->operand, globalIndex);
+                instruction->location = GlobalIndex(dslValue->iValue, globalIndex);
+                break;
+            case MUL: case DIV: case ADD: case SUB:
+            case TEQ: case TNE: case TGR: case TGE: case TLS: case TLE:
+                instruction->location = 0;
+                break;
+        }
+    }
+
+    code[codeCount].opcode = END;
+    code[codeCount].moduleId = codeCount > 0 ? code[codeCount-1].moduleId : 1;
+    code[codeCount].operand = 0;
+    code[codeCount].location = 0;
+    code[codeCount].value = nullptr;
+
+    delete []globalIndex;
+}
+
+int64_t CPU::GlobalIndex(int64_t addr, int64_t *globalIndex)
+{
+    if ( addr < 0 || addr >= codeCount )
+    {
+        //Rejected by VerifyProgram.
+        return -1;
+    }
+
+    if ( globalIndex[addr] == -1 )
+    {
+        globalIndex[addr] = image->globalAddr.Count();
+        image->globalAddr.push_back(addr);
+    }
+
+    return globalIndex[addr];
+}
+
+/// \desc Gets the parameter count pushed by the instruction before a JSR, JBF, PVA or PCV.
+/// \return The count or -1 if the instruction before is not an integer push.
+static int64_t PushedCount(CodeImage *image, int64_t addr)
+{
+    if ( addr == 0 )
+    {
+        return -1;
+    }
+
+    DslValue *previous = image->instructions[addr-1];
+    if ( previous->opcode != PSI || previous->type != INTEGER_VALUE || previous->iValue < 0 )
+    {
+        return -1;
+    }
+
+    return previous->iValue;
+}
+
+/// \desc Number of slots an instruction reads from the top of the parameter stack and the number
+///       it adds to the stack, negative if it removes slots.
+/// \remark Calls, built in functions and collection elements take the number of values pushed
+///         for them from the top of the stack, the compiler always pushes it with the PSI before
+///         them. A PVA without one is the address of a variable that is not a collection.
+static void StackEffect(CodeImage *image, int64_t addr, int64_t &inputs, int64_t &effect)
+{
+    inputs = 0;
+    effect = 0;
+    switch( image->code[addr].opcode )
+    {
+        default:
+            break;
+        case PSI: case PSV: case PSL:
+            effect = 1;
+            break;
+        case SAV: case ADA: case SUA: case MUA: case DIA: case MOA:
+            inputs = 2;
+            effect = -2;
+            break;
+        case EXP: case MUL: case DIV: case ADD: case SUB: case MOD: case XOR: case BND: case BOR:
+        case SVL: case SVR: case TEQ: case TNE: case TGR: case TGE: case TLS: case TLE: case AND:
+        case LOR: case SLV:
+            inputs = 2;
+            effect = -1;
+            break;
+        case NOT: case NEG: case CTI: case CTD: case CTC: case CTS: case CTB: case RET:
+            inputs = 1;
+            break;
+        case DCS: case JIF: case JIT: case ITS: case JTB:
+            inputs = 1;
+            effect = -1;
+            break;
+        case JSR: case JBF: case PCV: case PVA:
+        {
+            int64_t count = PushedCount(image, addr);
+            if ( count >= 0 )
+            {
+                //The values and their count are replaced by the result.
+                inputs = count + 1;
+                effect = -count;
+            }
+            else
+            {
+                inputs = image->code[addr].opcode == PVA ? 0 : 1;
+                effect = image->code[addr].opcode == PVA ? 1 : 0;
+            }
+            break;
+        }
+    }
+}
+
+bool CPU::VerifyProgram()
+{
+    int64_t builtInCount = sizeof(builtInMethods) / sizeof(builtInMethods[0]);
+    int64_t maxLocal = 0;
+
+    for(int64_t ii=0; ii<codeCount; ++ii)
+    {
+        Instruction *instruction = &code[ii];
+        const char *error = nullptr;
+
+        if ( instruction->opcode < NOP || instruction->opcode > ITV )
+        {
+            error = "invalid opcode";
+        }
+        else
+        {
+            switch( instruction->opcode )
+            {
+                default:
+                    break;
+                case JMP: case JIF: case JIT: case JSR: case EFI: case COM:
+                    if ( instruction->location < 0 || instruction->location > codeCount )
+                    {
+                        error = "jump outside of the program";
+                    }
+                    break;
+                case ITN:
+                    if ( instruction->location < 0 || instruction->location > codeCount )
+                    {
+                        error = "jump outside of the program";
+                    }
+                    [[fallthrough]];
+                case ITS:
+                    if ( error == nullptr &&
+                         (instruction->operand < 0 || instruction->operand >= image->globalAddr.Count()) )
+                    {
+                        error = "variable outside of the program";
+                    }
+                    break;
+                case ITK: case ITV:
+                    if ( instruction->operand < 0 || instruction->operand >= image->globalAddr.Count() ||
+                         instruction->location < 0 || instruction->location >= image->globalAddr.Count() )
+                    {
+                        error = "variable outside of the program";
+                    }
+                    break;
+                case JTB:
+                {
+                    DslValue *jumpTable = image->instructions[ii];
+                    if ( jumpTable->location < 0 || jumpTable->location > codeCount )
+                    {
+                        error = "jump outside of the program";
+                    }
+                    for(int64_t tt=0; tt<jumpTable->cases.Count(); ++tt)
+                    {
+                        if ( jumpTable->cases[tt]->location < 0 || jumpTable->cases[tt]->location > codeCount )
+                        {
+                            error = "jump outside of the program";
+                        }
+                    }
+                    break;
+                }
+                case JBF:
+                    if ( instruction->operand < 0 || instruction->operand >= builtInCount )
+                    {
+                        error = "unknown built in function";
+                    }
+                    break;
+                case PSV: case PVA: case PCV: case INC: case DEC: case DCS:
+                    if ( instruction->operand < 0 || instruction->operand >= image->globalAddr.Count() )
+                    {
+                        error = "variable outside of the program";
+                    }
+                    else if ( instruction->opcode == DCS && ( instruction->location < 0 ||
+                              instruction->location >= Definition(instruction)->indexes.Count() ) )
+                    {
+                        error = "key outside of the collection";
+                    }
+                    break;
+                case PSL: case INL: case DEL:
+                    if ( instruction->operand < 0 )
+                    {
+                        error = "invalid local variable";
+                    }
+                    maxLocal = instruction->operand > maxLocal ? instruction->operand : maxLocal;
+                    break;
+            }
+        }
+
+        if ( error != nullptr )
+        {
+            PrintIssue(4007, true, false, "Invalid program, %s at %4.4llx", error, (long long int)ii);
+            return false;
+        }
+    }
+
+    //Locals are found from BP which is never above top.
+    image->localSlots = maxLocal + 1;
+
+    return VerifyStack();
+}
+
+bool CPU::VerifyStack()
+{
+    //Functions start at the targets of calls, components and event handlers, the program at 0.
+    auto *isEntry = new bool[codeCount + 1];
+    for(int64_t ii=0; ii<=codeCount; ++ii)
+    {
+        isEntry[ii] = ii == 0;
+    }
+    for(int64_t ii=0; ii<codeCount; ++ii)
+    {
+        OPCODES opcode = code[ii].opcode;
+        if ( opcode == JSR || opcode == EFI || opcode == COM )
+        {
+            isEntry[code[ii].location] = true;
+        }
+    }
+
+    delete []image->frameDepth;
+    image->frameDepth = new int64_t[codeCount + 1];
+    auto *lowest = new int64_t[codeCount];
+    auto *highest = new int64_t[codeCount];
+    auto *queued = new bool[codeCount];
+    for(int64_t ii=0; ii<codeCount; ++ii)
+    {
+        lowest[ii] = INT64_MAX;
+        highest[ii] = -1;
+        queued[ii] = false;
+    }
+
+    bool verified = true;
+    image->stackVerified = true;
+    image->maxStack = image->localSlots;
+    for(int64_t ii=0; ii<=codeCount; ++ii)
+    {
+        image->frameDepth[ii] = 0;
+        if ( !isEntry[ii] || ii == codeCount )
+        {
+            continue;
+        }
+
+        int64_t depth = FrameDepth(ii, false, lowest, highest, queued);
+        if ( depth == -2 )
+        {
+            verified = false;
+            break;
+        }
+        if ( depth == -1 )
+        {
+            image->stackVerified = false;
+            depth = FrameDepth(ii, true, lowest, highest, queued);
+        }
+
+        //The function's locals are also above BP.
+        depth = depth > image->localSlots ? depth : image->localSlots;
+        image->frameDepth[ii] = depth;
+        image->maxStack = depth > image->maxStack ? depth : image->maxStack;
+    }
+
+    delete []isEntry;
+    delete []lowest;
+    delete []highest;
+    delete []queued;
+
+    return verified;
+}
+
+int64_t CPU::FrameDepth(int64_t entry, bool checkJumps, int64_t *lowest, int64_t *highest, bool *queued)
+{
+    //lowest is the smallest depth an instruction can be reached with, relative to the stack at
+    //the entry, so a function never removes values below its frame. highest is the largest
+    //depth since the last stack check. Both only move one way so the search ends.
+    List<int64_t> work;
+    List<int64_t> visited;
+    int64_t maxDepth = 0;
+    bool unbounded = false;
+
+    auto visit = [&](int64_t target, int64_t low, int64_t high)
+    {
+        if ( target >= codeCount )
+        {
+            return;
+        }
+        //No path without a loop grows the stack more than once per instruction.
+        if ( high > codeCount )
+        {
+            high = codeCount + 1;
+            unbounded = true;
+        }
+        if ( lowest[target] == INT64_MAX )
+        {
+            visited.push_back(target);
+        }
+        if ( low >= lowest[target] && high <= highest[target] )
+        {
+            return;
+        }
+        lowest[target] = low < lowest[target] ? low : lowest[target];
+        highest[target] = high > highest[target] ? high : highest[target];
+        if ( !queued[target] )
+        {
+            queued[target] = true;
+            work.push_back(target);
+        }
+    };
+
+    visit(entry, 0, 0);
+    while( work.Count() > 0 )
+    {
+        int64_t ii = work.pop_back();
+        queued[ii] = false;
+
+        int64_t inputs;
+        int64_t effect;
+        StackEffect(image, ii, inputs, effect);
+        if ( lowest[ii] < inputs )
+        {
+            PrintIssue(4007, true, false, "Invalid program, stack underflow at %4.4llx", (long long int)ii);
+            maxDepth = -2;
+            break;
+        }
+
+        int64_t peak = highest[ii] + (effect > 0 ? effect : 0);
+        maxDepth = peak > maxDepth ? peak : maxDepth;
+
+        OPCODES opcode = code[ii].opcode;
+        if ( opcode == END || opcode == RFE || opcode == RET )
+        {
+            continue;
+        }
+
+        int64_t low = lowest[ii] + effect;
+        int64_t high = highest[ii] + effect;
+        bool isJump = opcode == JMP || opcode == JIF || opcode == JIT;
+        if ( checkJumps && isJump )
+        {
+            //The jump checks the stack so the growth after it starts again from 0.
+            high = 0;
+        }
+
+        if ( opcode != JMP && opcode != JTB )
+        {
+            visit(ii + 1, low, high);
+        }
+        if ( isJump || opcode == ITN )
+        {
+            visit(code[ii].location, low, high);
+        }
+        if ( opcode == JTB )
+        {
+            DslValue *jumpTable = image->instructions[ii];
+            for(int64_t tt=0; tt<jumpTable->cases.Count(); ++tt)
+            {
+                visit(jumpTable->cases[tt]->location, low, high);
+            }
+            visit(jumpTable->location, low, high);
+        }
+    }
+
+    for(int64_t ii=0; ii<visited.Count(); ++ii)
+    {
+        lowest[visited[ii]] = INT64_MAX;
+        highest[visited[ii]] = -1;
+        queued[visited[ii]] = false;
+    }
+
+    if ( maxDepth >= 0 && unbounded && !checkJumps )
+    {
+        return -1;
+    }
+
+    return maxDepth;
+}
+
+void CPU::GrowStack(int64_t depth)
+{
+    params.Reserve((top + depth + STACK_RESERVE + 1) * 2);
+    stackLimit = params.Size() - 1 - STACK_RESERVE - image->maxStack;
+    jumpStackLimit = image->stackVerified ? INT64_MAX : stackLimit;
+}
+
+/// \desc Checks if the opcode is a binary operator that can be part of a fused instruction.
+static bool IsFusibleOperator(OPCODES opcode)
+{
+    switch( opcode )
+    {
+        case EXP: case MUL: case DIV: case ADD: case SUB: case MOD:
+        case XOR: case BND: case BOR: case SVL: case SVR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// \desc Checks if the opcode is a test that can be part of a fused compare and branch.
+static bool IsFusibleTest(OPCODES opcode)
+{
+    switch( opcode )
+    {
+        case TEQ: case TNE: case TGR: case TGE: case TLS: case TLE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+int64_t CPU::FusedLength(OPCODES opcode)
+{
+    switch( opcode )
+    {
+        case AVI: case AVV:
+            return 5;
+        case LOI: case CVI: case CVV: case CLI:
+            return 4;
+        case SVI:
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+/// \desc Replaces the first instruction of each fusible sequence with its fused instruction. The
+///       instruction addresses do not change, the rest of the sequence stays in place and is
+///       read by the fused instruction for its operands, or run as is when the fused
+///       instruction's operands are not integers or doubles.
+void CPU::FuseInstructions()
+{
+    //A sequence can't be fused if the program can jump into the middle of it.
+    bool *isTarget = new bool[codeCount + 1]();
+
+    for(int64_t ii=0; ii<codeCount; ++ii)
+    {
+        switch( code[ii].opcode )
+        {
+            default:
+                break;
+            case JSR:
+                isTarget[ii+1] = true;
+                isTarget[code[ii].location] = true;
+                break;
+            case JMP: case JIF: case JIT: case EFI: case ITN:
+                isTarget[code[ii].location] = true;
+                break;
+            case JTB:
+            {
+                DslValue *jumpTable = image->instructions[ii];
+                isTarget[jumpTable->location] = true;
+                for(int64_t tt=0; tt<jumpTable->cases.Count(); ++tt)
+                {
+                    isTarget[jumpTable->cases[tt]->location] = true;
+                }
+                break;
+            }
+        }
+    }
+
+    for(int64_t ii=0; ii<codeCount; ++ii)
+    {
+        Instruction *c = &code[ii];
+        auto fused = (OPCODES)0;
+        int64_t remaining = codeCount - ii;
+
+        if ( remaining >= 5 && c[0].opcode == PVA && c[1].opcode == PSV && c[0].operand == c[1].operand
+             && IsFusibleOperator(c[3].opcode) && c[4].opcode == SAV )
+        {
+            if ( c[2].opcode == PSI )
+            {
+                fused = AVI;
+            }
+            else if ( c[2].opcode == PSV )
+            {
+                fused = AVV;
+            }
+        }
+        else if ( remaining >= 4 && IsFusibleTest(c[2].opcode) && (c[3].opcode == JIF || c[3].opcode == JIT) )
+        {
+            if ( c[0].opcode == PSV && c[1].opcode == PSI )
+            {
+                fused = CVI;
+            }
+            else if ( c[0].opcode == PSV && c[1].opcode == PSV )
+            {
+                fused = CVV;
+            }
+            else if ( c[0].opcode == PSL && c[1].opcode == PSI )
+            {
+                fused = CLI;
+            }
+        }
+        else if ( remaining >= 4 && c[0].opcode == PSL && c[1].opcode == PSI
+                  && IsFusibleOperator(c[2].opcode) && c[3].opcode == SLV )
+        {
+            fused = LOI;
+        }
+        else if ( remaining >= 3 && c[0].opcode == PVA && c[1].opcode == PSI && c[2].opcode == SAV )
+        {
+            fused = SVI;
+        }
+
+        int64_t length = FusedLength(fused);
+        if ( length == 0 )
+        {
+            continue;
+        }
+
+        bool canFuse = true;
+        for(int64_t tt=1; tt<length; ++tt)
+        {
+            if ( isTarget[ii+tt] )
+            {
+                canFuse = false;
+                break;
+            }
+        }
+
+        if ( canFuse )
+        {
+            c->opcode = fused;
+            ii += length - 1;
+        }
+    }
+
+    delete []isTarget;
+}
+
+/// \desc Performs an arithmetic operation on two integer or two double values.
+/// \param op Operator to apply.
+/// \param left Left side term.
+/// \param right Right side term, must be the same type as left.
+/// \param result Value to store the result in, can be the same as left or right.
+/// \return True if the operation was done, false if it has to go through the DslValue operators.
+/// \remark Works on DslValue and on Value terms.
+template<class Left, class Right, class Result>
+static bool FastArithmetic(OPCODES op, Left *left, Right *right, Result *result)
+{
+    if ( left->type == INTEGER_VALUE )
+    {
+        int64_t l = left->iValue;
+        int64_t r = right->iValue;
+        switch( op )
+        {
+            default:  return false;
+            case ADD: l += r; break;
+            case SUB: l -= r; break;
+            case MUL: l *= r; break;
+            case XOR: l ^= r; break;
+            case BND: l &= r; break;
+            case BOR: l |= r; break;
+            case SVL: l <<= r; break;
+            case SVR: l >>= r; break;
+            case DIV:
+                if ( r == 0 )
+                {
+                    return false;
+                }
+                l /= r;
+                break;
+            case MOD:
+                if ( r == 0 )
+                {
+                    return false;
+                }
+                l %= r;
+                break;
+        }
+        result->type = INTEGER_VALUE;
+        result->iValue = l;
+        return true;
+    }
+
+    if ( left->type == DOUBLE_VALUE )
+    {
+        double l = left->dValue;
+        double r = right->dValue;
+        switch( op )
+        {
+            default:  return false;
+            case ADD: l += r; break;
+            case SUB: l -= r; break;
+            case MUL: l *= r; break;
+            case DIV:
+                if ( r == 0.0 )
+                {
+                    return false;
+                }
+                l /= r;
+                break;
+        }
+        result->type = DOUBLE_VALUE;
+        result->dValue = l;
+        return true;
+    }
+
+    return false;
+}
+
+/// \desc Compares two integer or two double values.
+/// \param op Test to apply.
+/// \param left Left side term.
+/// \param right Right side term, must be the same type as left.
+/// \param result Set to the result of the test.
+/// \return True if the test was done, false if it has to go through the DslValue operators.
+/// \remark Works on DslValue and on Value terms.
+template<class Left, class Right>
+static bool FastTest(OPCODES op, Left *left, Right *right, bool &result)
+{
+    if ( left->type == INTEGER_VALUE )
+    {
+        int64_t l = left->iValue;
+        int64_t r = right->iValue;
+        switch( op )
+        {
+            default:  return false;
+            case TEQ: result = l == r; break;
+            case TNE: result = l != r; break;
+            case TGR: result = l > r;  break;
+            case TGE: result = l >= r; break;
+            case TLS: result = l < r;  break;
+            case TLE: result = l <= r; break;
+        }
+        return true;
+    }
+
+    if ( left->type == DOUBLE_VALUE )
+    {
+        double l = left->dValue;
+        double r = right->dValue;
+        switch( op )
+        {
+            default:  return false;
+            case TEQ: result = l == r; break;
+            case TNE: result = l != r; break;
+            case TGR: result = l > r;  break;
+            case TGE: result = l >= r; break;
+            case TLS: result = l < r;  break;
+            case TLE: result = l <= r; break;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+void CPU::RunFusedInstruction(Instruction *instruction)
+{
+    int64_t head = PC - 1;
+    int64_t length = FusedLength(instruction->opcode);
+    bool result;
+
+    PC = head + length;
+
+    switch( instruction->opcode )
+    {
+        default:
+            break;
+        case AVI: case AVV:
+        {
+            DslValue *variable = Global(instruction);
+            DslValue *right = instruction->opcode == AVV ? Global(&instruction[2]) : instruction[2].value;
+            if ( variable->type == right->type && FastArithmetic(instruction[3].opcode, variable, right, variable) )
+            {
+                return;
+            }
+            //s = s + text appends to the variable the same as s += text instead of copying the
+            //string to the stack and back.
+            if ( instruction[3].opcode == ADD && variable->type == STRING_VALUE && right->type == STRING_VALUE )
+            {
+                variable->sValue.Append(&right->sValue);
+                return;
+            }
+            break;
+        }
+        case SVI:
+            if ( Global(instruction)->type != COLLECTION )
+            {
+                Global(instruction)->LiteCopy(instruction[1].value);
+                return;
+            }
+            break;
+        case LOI:
+        {
+            //SLV finds the local to save to through the operand left on the stack by PSL.
+            params.At(top+1).operand = (int32_t)instruction->operand;
+            Value *local = &params.At(BP+instruction->operand);
+            DslValue *right = instruction[1].value;
+            if ( local->type == right->type )
+            {
+                Value *target = &params.At(LocalSlot(params.At(top).operand));
+                if ( FastArithmetic(instruction[2].opcode, local, right, target) )
+                {
+                    return;
+                }
+            }
+            break;
+        }
+        case CVI: case CVV:
+        {
+            DslValue *left = Global(instruction);
+            DslValue *right = instruction->opcode == CVV ? Global(&instruction[1]) : instruction[1].value;
+            if ( left->type == right->type && FastTest(instruction[2].opcode, left, right, result) )
+            {
+                if ( result != (instruction[3].opcode == JIT) )
+                {
+                    PC = head + length;
+                }
+                else
+                {
+                    PC = instruction[3].location;
+                }
+                CheckJumpStack();
+                CountBranch();
+                return;
+            }
+            break;
+        }
+        case CLI:
+        {
+            params.At(top+1).operand = (int32_t)instruction->operand;
+            Value *left = &params.At(BP+instruction->operand);
+            DslValue *right = instruction[1].value;
+            if ( left->type == right->type && FastTest(instruction[2].opcode, left, right, result) )
+            {
+                if ( result != (instruction[3].opcode == JIT) )
+                {
+                    PC = head + length;
+                }
+                else
+                {
+                    PC = instruction[3].location;
+                }
+                CheckJumpStack();
+                CountBranch();
+                return;
+            }
+            break;
+        }
+    }
+
+    //Operands are not integers or doubles so run the original instructions.
+    for(int64_t ii=0; ii<length; ++ii)
+    {
+        Instruction original = code[head + ii];
+        if ( ii == 0 )
+        {
+            original.opcode = image->instructions[head]->opcode;
+        }
+        RunInstruction(&original);
+    }
+}
+
+/// \desc Gets the quickened version of a generic arithmetic or test instruction.
+/// \param opcode Generic instruction.
+/// \param type Type of both operands.
+/// \return The quickened instruction or NOP if there is none for the instruction and type.
+static OPCODES QuickenedOpcode(OPCODES opcode, TokenTypes type)
+{
+    if ( type == INTEGER_VALUE )
+    {
+        switch( opcode )
+        {
+            default:  return NOP;
+            case ADD: return ADD_II;
+            case SUB: return SUB_II;
+            case MUL: return MUL_II;
+            case TEQ: return TEQ_II;
+            case TNE: return TNE_II;
+            case TGR: return TGR_II;
+            case TGE: return TGE_II;
+            case TLS: return TLS_II;
+            case TLE: return TLE_II;
+        }
+    }
+
+    if ( type == DOUBLE_VALUE )
+    {
+        switch( opcode )
+        {
+            default:  return NOP;
+            case ADD: return ADD_DD;
+            case SUB: return SUB_DD;
+            case MUL: return MUL_DD;
+            case DIV: return DIV_DD;
+            case TEQ: return TEQ_DD;
+            case TNE: return TNE_DD;
+            case TGR: return TGR_DD;
+            case TGE: return TGE_DD;
+            case TLS: return TLS_DD;
+            case TLE: return TLE_DD;
+        }
+    }
+
+    return NOP;
+}
+
+/// \desc Gets the generic instruction a quickened instruction was created from.
+static OPCODES GenericOpcode(OPCODES opcode)
+{
+    switch( opcode )
+    {
+        default:     return opcode;
+        case ADD_II: case ADD_DD: return ADD;
+        case SUB_II: case SUB_DD: return SUB;
+        case MUL_II: case MUL_DD: return MUL;
+        case DIV_DD: return DIV;
+        case TEQ_II: case TEQ_DD: return TEQ;
+        case TNE_II: case TNE_DD: return TNE;
+        case TGR_II: case TGR_DD: return TGR;
+        case TGE_II: case TGE_DD: return TGE;
+        case TLS_II: case TLS_DD: return TLS;
+        case TLE_II: case TLE_DD: return TLE;
+    }
+}
+
+bool CPU::QuickenInstruction(Instruction *instruction)
+{
+    //CPUs sharing an image run the code as it is, rewriting it would race with them.
+    if ( !quickenInstructions || instruction->location >= MAX_DEOPTIMIZATIONS || image->IsShared() )
+    {
+        return false;
+    }
+
+    TokenTypes type = params.At(top).type;
+    if ( params.At(top-1).type != type )
+    {
+        return false;
+    }
+
+    OPCODES quickened = QuickenedOpcode(instruction->opcode, type);
+    if ( quickened == NOP )
+    {
+        return false;
+    }
+
+    instruction->opcode = quickened;
+
+    return RunQuickenedInstruction(instruction);
+}
+
+bool CPU::RunQuickenedInstruction(Instruction *instruction)
+{
+    Value *right = &params.At(top);
+    Value *left = &params.At(top-1);
+    //The _II instructions come before the _DD instructions in the opcode enumeration.
+    TokenTypes type = instruction->opcode <= TLE_II ? INTEGER_VALUE : DOUBLE_VALUE;
+
+    if ( left->type != type || right->type != type )
+    {
+        return false;
+    }
+
+    switch( instruction->opcode )
+    {
+        default:
+            return false;
+        case ADD_II:
+            left->iValue += right->iValue;
+            break;
+        case SUB_II:
+            left->iValue -= right->iValue;
+            break;
+        case MUL_II:
+            left->iValue *= right->iValue;
+            break;
+        case TEQ_II:
+            left->bValue = left->iValue == right->iValue;
+            left->type = BOOL_VALUE;
+            break;
+        case TNE_II:
+            left->bValue = left->iValue != right->iValue;
+            left->type = BOOL_VALUE;
+            break;
+        case TGR_II:
+            left->bValue = left->iValue > right->iValue;
+            left->type = BOOL_VALUE;
+            break;
+        case TGE_II:
+            left->bValue = left->iValue >= right->iValue;
+            left->type = BOOL_VALUE;
+            break;
+        case TLS_II:
+            left->bValue = left->iValue < right->iValue;
+            left->type = BOOL_VALUE;
+            break;
+        case TLE_II:
+            left->bValue = left->iValue <= right->iValue;
+            left->type = BOOL_VALUE;
+            break;
+        case ADD_DD:
+            left->dValue += right->dValue;
+            break;
+        case SUB_DD:
+            left->dValue -= right->dValue;
+            break;
+        case MUL_DD:
+            left->dValue *= right->dValue;
+            break;
+        case DIV_DD:
+            //Divide by zero is reported by the generic instruction.
+            if ( right->dValue == 0.0 )
+            {
+                return false;
+            }
+            left->dValue /= right->dValue;
+            break;
+        case TEQ_DD:
+            left->bValue = left->dValue == right->dValue;
+            left->type = BOOL_VALUE;
+            break;
+        case TNE_DD:
+            left->bValue = left->dValue != right->dValue;
+            left->type = BOOL_VALUE;
+            break;
+        case TGR_DD:
+            left->bValue = left->dValue > right->dValue;
+            left->type = BOOL_VALUE;
+            break;
+        case TGE_DD:
+            left->bValue = left->dValue >= right->dValue;
+            left->type = BOOL_VALUE;
+            break;
+        case TLS_DD:
+            left->bValue = left->dValue < right->dValue;
+            left->type = BOOL_VALUE;
+            break;
+        case TLE_DD:
+            left->bValue = left->dValue <= right->dValue;
+            left->type = BOOL_VALUE;
+            break;
+    }
+
+    --top;
+
+    return true;
+}
+
+OPCODES CPU::DeoptimizeInstruction(Instruction *instruction)
+{
+    OPCODES generic = GenericOpcode(instruction->opcode);
+    if ( !image->IsShared() )
+    {
+        instruction->opcode = generic;
+        ++instruction->location;
+    }
+
+    return generic;
+}
+
+/// \desc Deserializes the program symbol file and adds those symbols to the
+///       internal program.
+/// \param binaryFileReader Pointer to the binary file reader to use.
+/// \return True if the symbols are added to the program, false if the symbol
+///         file does not exist or can't be read.
+bool CPU::DeSerializeSymbols(BinaryFileReader *binaryFileReader)
+{
+        while( !binaryFileReader->eof() )
+    {
+        int64_t addr = binaryFileReader->GetInt();
+        binaryFileReader->GetString(&image->instructions[addr]->variableName);
+        binaryFileReader->GetString(&image->instructions[addr]->variableScriptName);
+    }
+
+    return true;
+}
+
+/// \desc Adds the locations used in the program as its symbols. Used when the symbol file
+///       can't be read or is not present.
+void CPU::SetProgramLocationsAsSymbols()
+{
+    for(int ii=0; ii<image->instructions.Count(); ++ii)
+    {
+        switch( image->instructions[ii]->opcode )
+        {
+            case DEF: case DFL: case EFI:
+            case PVA: case DCS: case PCV:
+            case DEC: case INC:
+            case INL: case DEL: case PSV:
+            case SAV: case SVL: case PSL:
+            case PSP: case CID: case COM:
+            case ITS: case ITN: case ITK: case ITV:
+                image->instructions[ii]->variableName.printf(false, (char *)"%llx", (long long int)image->instructions[ii]->operand);
+            default:
+                break;
+        }
+    }
+}
+
 /// \desc Reads the IL file and translates it into an internal format ready to be run by the runtime.
 /// \param ilFile Pointer to a u8String containing the full path name to the program file.
 /// \param symFile Pointer to a u8String containing the full path name to the symbol file. If empty
@@ -1470,11 +2805,22 @@ void CPU::SetProgramLocationsAsSymbols()
 /// \returns True if successful or false if an error occurs.
 bool CPU::Init(U8String *ilFile, U8String *symFile)
 {
+    CurrentCPU currentCPU(this);
     BinaryFileReader binaryFileReader = {};
 
+    if ( image != nullptr )
+    {
+        image->Release();
+    }
+    image = new CodeImage();
+
     binaryFileReader.fread(ilFile);
 
-    DeSerializeIL(&binaryFileReader);
+    if ( !DeSerializeIL(&binaryFileReader) )
+    {
+        printf("%s", szErrorMsg.cStr());
+        return false;
+    }
 
     if ( binaryFileReader.fread(symFile) )
     {
@@ -1485,16 +2831,84 @@ bool CPU::Init(U8String *ilFile, U8String *symFile)
         SetProgramLocationsAsSymbols();
     }
 
+    AttachImage();
+
+    return true;
+}
+
+/// \desc Initializes the CPU to run a program already loaded by another CPU.
+/// \param codeImage Code image of the program.
+/// \returns True if successful or false if the image does not contain a program.
+bool CPU::Init(CodeImage *codeImage)
+{
+    if ( codeImage == nullptr || codeImage->code == nullptr )
+    {
+        return false;
+    }
+
+    codeImage->AddReference();
+    if ( image != nullptr )
+    {
+        image->Release();
+    }
+    image = codeImage;
+    code = image->code;
+    codeCount = image->codeCount;
+
+    AttachImage();
+
     return true;
 }
 
+void CPU::AttachImage()
+{
+    for(int64_t ii=0; ii<globals.Count(); ++ii)
+    {
+        delete globals[ii];
+    }
+    globals.Clear();
+
+    //Each CPU starts with the values the program defines its variables with.
+    for(int64_t ii=0; ii<image->globalAddr.Count(); ++ii)
+    {
+        globals.push_back(CopyGlobal(image->instructions[image->globalAddr[ii]]));
+    }
+
+    //The on tick handler is looked up again for the first module the program runs.
+    lastModuleId = 0;
+    onTickEvent = 0;
+
+    GrowStack(image->maxStack);
+}
+
+DslValue *CPU::CopyGlobal(DslValue *variable)
+{
+    //A collection shares its elements with the image until the CPU changes it.
+    auto *global = new DslValue(variable);
+    global->elementAddress = nullptr;
+
+    return global;
+}
+
 bool CPU::Run()
 {
+    CurrentCPU currentCPU(this);
+
+    eventBudget = eventCheckInterval;
+    clockStart = MonotonicTime();
+    nextTick = clockStart + 1000000000LL / ticksPerSecond;
+    simulatedTime = 0;
+
     //error handles need setup
     if ( traceInfoLevel == 1 )
     {
+        threadedDispatch = false;
         RunTrace();
     }
+    else if ( threadedDispatch )
+    {
+        RunThreaded();
+    }
     else
     {
         RunNoTrace();
@@ -1509,19 +2923,65 @@ bool CPU::Run()
 /// \remark Assumes that the function call does not have any parameters.
 bool CPU::RunComponent(U8String *function)
 {
-    for(int64_t ii=0; ii < comInstAddr.Count(); ++ii)
+    return RunComponent(FindComponent(function));
+}
+
+bool CPU::RunComponent(int64_t component)
+{
+    if ( component < 0 || component >= image->comInstAddr.Count() )
     {
-        int64_t addr = comInstAddr[ii];
-        if ( instructions[addr]->component->function.IsEqual(function))
+        return false;
+    }
+
+    CurrentCPU currentCPU(this);
+
+    int64_t base = top;
+    auto dslValue = DslValue();
+    SetSlot(++top, &dslValue);
+    int64_t depth = frames.Count();
+    JumpToSubroutine(&code[image->comInstAddr[component]]);
+    if ( frames.Count() > depth )
+    {
+        frames.Last().exitOnReturn = true;
+        if ( threadedDispatch )
         {
-            auto dslValue = DslValue();
-            params[++top].LiteCopy(&dslValue);
-            JumpToSubroutine(instructions[addr]);
-            return true;
+            RunThreaded();
+        }
+        else
+        {
+            RunNoTrace();
         }
+        //An error ends the run without returning from the function.
+        frames.Resize(depth);
     }
+    //The value returned by the component is not used.
+    top = base;
 
-    return false;
+    return true;
+}
+
+int64_t CPU::FindComponent(U8String *function)
+{
+    KeyData *keyData = image->componentIndex.Get(function);
+    if ( keyData == nullptr )
+    {
+        return -1;
+    }
+
+    return ((DslValue *)keyData->Data())->operand;
+}
+
+DslValue *CPU::FindVariable(const char *name)
+{
+    for(int64_t ii=0; ii<image->globalAddr.Count(); ++ii)
+    {
+        if ( image->instructions[image->globalAddr[ii]]->variableName.IsEqual(name) )
+        {
+            return globals[ii];
+        }
+    }
+
+    return nullptr;
 }
 
 void CPU::WriteComponentFile()
@@ -1535,14 +2995,18 @@ void CPU::WriteComponentFile()
 
 void CPU::GetComponents(U8String &out)
 {
-    componentsInformation.Clear();
+    std::call_once(image->manifestBuilt, [this]() { BuildManifest(image->manifest); });
+    out.CopyFrom(&image->manifest);
+}
 
+void CPU::BuildManifest(U8String &out)
+{
     out.printf(false, (char *)"[\n");
 
-    for(int64_t ii=0; ii<comInstAddr.Count(); ++ii)
+    for(int64_t ii=0; ii<image->comInstAddr.Count(); ++ii)
     {
-        int64_t addr = comInstAddr[ii];
-        ComponentData *cd = instructions[addr]->component;
+        int64_t addr = image->comInstAddr[ii];
+        ComponentData *cd = image->instructions[addr]->component;
         out.push_back('\t');
         out.printf(true, (char *)"{\n");
         out.push_back('\t');
@@ -1603,100 +3067,266 @@ void CPU::GetComponents(U8String &out)
             out.push_back('\n');
         }
 
-        out.push_back('\t');
-        out.push_back('\t');
-        out.push_back('\t');
-        out.printf(true, (char *)R"(])");    //close off slots list
-        out.push_back('\n');
-        out.push_back('\t');
-        out.push_back('\t');
-        out.printf(true, (char *)R"(})");     //close off component
-        out.push_back('\n');
-        if ( ii + 1 <comInstAddr.Count() )
-        {
-            out.printf(true, (char *)",\n");
-        }
+        out.push_back('\t');
+        out.push_back('\t');
+        out.push_back('\t');
+        out.printf(true, (char *)R"(])");    //close off slots list
+        out.push_back('\n');
+        out.push_back('\t');
+        out.push_back('\t');
+        out.printf(true, (char *)R"(})");     //close off component
+        out.push_back('\n');
+        if ( ii + 1 <image->comInstAddr.Count() )
+        {
+            out.printf(true, (char *)",\n");
+        }
+    }
+
+    out.push_back(']');
+}
+
+void CPU::ExtendCollection(DslValue *collection, int64_t newEnd)
+{
+    for(int64_t ii=collection->indexes.Count(); ii<=newEnd; ++ii)
+    {
+        U8String key;
+        key.Clear();
+        key.push_back(&collection->variableScriptName);
+        key.push_back('.');
+        key.Append(ii);
+        collection->indexes.Append(&key, new DslValue());
+    }
+}
+
+void CPU::SetCollectionElementDirect(Instruction *instruction)
+{
+    auto *var = Global(instruction);
+    var->indexes.Detach();
+
+    //The element is at the position of its key while the collection has the keys it is defined
+    //with, once the program changes them it is found by its key and added if it is missing.
+    U8String *key = Definition(instruction)->indexes.Key(instruction->location);
+    KeyData *keyData = nullptr;
+    if ( instruction->location < var->indexes.Count() )
+    {
+        keyData = var->indexes.Entry(instruction->location);
+    }
+    if ( keyData == nullptr || keyData->Key() != key )
+    {
+        keyData = var->indexes.Get(key);
+        if ( keyData == nullptr )
+        {
+            var->indexes.Set(key, new DslValue());
+            keyData = var->indexes.Get(key);
+        }
+    }
+
+    StoreSlot((DslValue *)keyData->Data(), top);
+    --top;
+}
+
+DslValue *CPU::GetCollectionElement(DslValue *dslValue)
+{
+    auto     totalParams = params.At(top).iValue; //subtract out the param count.
+    DslValue *collection = dslValue;
+
+    for(int64_t ii=top-totalParams; ii<top; ++ii)
+    {
+        //The element can be changed through the address returned so a collection that shares
+        //its elements with a copy gets elements of its own first.
+        collection->indexes.Detach();
+        if ( params.At(ii).type != STRING_VALUE )
+        {
+            if ( params.At(ii).type != INTEGER_VALUE )
+            {
+                SlotValue(ii)->Convert(INTEGER_VALUE);
+                LoadSlot(ii);
+            }
+            if ( params.At(ii).iValue >= collection->indexes.Count() )
+            {
+                ExtendCollection(collection, params.At(ii).iValue);
+            }
+            //Elements are in the order of their index so no key is needed.
+            collection = ((DslValue *)collection->indexes.Entry(params.At(ii).iValue)->Data());
+            continue;
+        }
+
+        U8String *key = &params.At(ii).object->sValue;
+        KeyData *keyData = collection->indexes.Get(key);
+        if( keyData == nullptr )
+        {
+            collection->indexes.Set(key, new DslValue());
+            keyData = collection->indexes.Get(key);
+        }
+        collection = (DslValue *)keyData->Data();
+    }
+
+    top -= totalParams + 1;
+    collection->elementAddress = collection;
+
+    return collection;
+}
+
+void CPU::StartIteration(Instruction *instruction)
+{
+    DslValue *iterator = Global(instruction);
+    DslValue *collection = SlotValue(top);
+    --top;
+
+    if ( collection->type != COLLECTION )
+    {
+        PrintIssue(4008, true, false, "foreach can only iterate over the elements of a collection");
+        iterator->indexes.Clear();
+        return;
+    }
+
+    //The iterator shares the collection's elements so the loop is not affected if the
+    //collection is changed inside the loop, the collection gets elements of its own instead.
+    iterator->SAV(collection);
+    iterator->iValue = 0;
+}
+
+void CPU::NextIteration(Instruction *instruction)
+{
+    DslValue *iterator = Global(instruction);
+
+    //iValue is the number of elements visited, the current element is the one before it.
+    if ( iterator->iValue < iterator->indexes.Count() )
+    {
+        ++iterator->iValue;
+        return;
+    }
+
+    //Released so the collection doesn't have to be copied the next time it is changed.
+    iterator->indexes.Clear();
+    PC = instruction->location;
+}
+
+void CPU::IterationKey(Instruction *instruction)
+{
+    DslValue *iterator = globals.At(instruction->location);
+    DslValue *key = Global(instruction);
+
+    key->type = STRING_VALUE;
+    key->sValue.CopyFrom(iterator->indexes.Entry(iterator->iValue - 1)->Key());
+}
+
+void CPU::IterationValue(Instruction *instruction)
+{
+    DslValue *iterator = globals.At(instruction->location);
+
+    Global(instruction)->LiteCopy((DslValue *)iterator->indexes.Entry(iterator->iValue - 1)->Data());
+}
+
+void CPU::PushVariableAddress(DslValue *variable)
+{
+    DslValue *value = variable;
+
+    if (variable->type == COLLECTION )
+    {
+        value = GetCollectionElement(variable);
+    }
+    //Only the address is set, the value in the slot is left as is.
+    Box(++top)->elementAddress = value;
+    CheckStack();
+}
+
+DslValue *CPU::Box(int64_t slot)
+{
+    while( boxes.Count() <= slot )
+    {
+        boxes.push_back(nullptr);
     }
 
-    out.push_back(']');
+    DslValue *box = boxes[slot];
+    if ( box == nullptr )
+    {
+        box = new DslValue();
+        boxes[slot] = box;
+    }
+
+    return box;
 }
 
-void CPU::ExtendCollection(DslValue *collection, int64_t newEnd)
+DslValue *CPU::SlotValue(int64_t slot)
 {
-    for(int64_t ii=collection->indexes.keys.Count(); ii<=newEnd; ++ii)
+    Value *value = &params.At(slot);
+
+    if ( value->IsScalar() )
     {
-        U8String key;
-        key.Clear();
-        key.push_back(&collection->variableScriptName);
-        key.push_back('.');
-        key.Append(ii);
-        collection->indexes.Set(new U8String(&key), new DslValue());
+        DslValue *box = Box(slot);
+        value->Store(box);
+        return box;
     }
+
+    return value->object;
 }
 
-void CPU::SetCollectionElementDirect(DslValue *dslValue)
+void CPU::LoadSlot(int64_t slot)
 {
-    auto *var = instructions[dslValue->operand];
-    U8String *key = var->indexes.keys[dslValue->iValue];
-    auto *collection = ((DslValue *)var->indexes.Get(key)->Data());
-    collection->SAV(&params[top]);
-    --top;
+    DslValue *box = Box(slot);
+    params.At(slot).Load(box, box);
 }
 
-DslValue *CPU::GetCollectionElement(DslValue *dslValue)
+void CPU::SetSlot(int64_t slot, DslValue *dslValue)
 {
-    auto     totalParams = params[top].iValue; //subtract out the param count.
-    DslValue *collection = dslValue;
+    Value *value = &params.At(slot);
+    value->Load(dslValue, Value::IsScalar(dslValue->type) ? nullptr : Box(slot));
+}
 
-    U8String *key;
-    for(int64_t ii=top-totalParams; ii<top; ++ii)
+void CPU::CopySlot(int64_t to, int64_t from)
+{
+    //Get the target first, extending the stack can move it.
+    Value *target = &params.At(to);
+    Value *source = &params.At(from);
+    int32_t operand = target->operand;
+
+    if ( source->IsScalar() )
     {
-        if ( params[ii].type != STRING_VALUE )
-        {
-            params[ii].Convert(INTEGER_VALUE);
-            if ( params[ii].iValue >= collection->indexes.keys.Count() )
-            {
-                ExtendCollection(collection, params[ii].iValue);
-            }
-            key = collection->indexes.keys[params[ii].iValue];
-        }
-        else
-        {
-            key = &params[ii].sValue;
-        }
-        if( collection->indexes.Exists(key) )
-        {
-            collection = ((DslValue *)collection->indexes.Get(key)->Data());
-        }
-        else
-        {
-            collection->indexes.Set(new U8String(key), new DslValue());
-            collection = ((DslValue *)collection->indexes.Get(key)->Data());
-        }
+        *target = *source;
+        target->operand = operand;
+        return;
     }
 
-    top -= totalParams + 1;
-    collection->elementAddress = collection;
-
-    return collection;
+    DslValue *box = Box(to);
+    box->LiteCopy(source->object);
+    target->type = source->type;
+    target->object = box;
 }
 
-void CPU::PushVariableAddress(DslValue *variable)
+void CPU::StoreSlot(DslValue *variable, int64_t slot)
 {
-    DslValue *value = variable;
+    Value *value = &params.At(slot);
 
-    if (variable->type == COLLECTION )
+    if ( value->IsScalar() )
     {
-        value = GetCollectionElement(variable);
+        value->Store(variable);
+    }
+    else
+    {
+        variable->SAV(SlotValue(slot));
     }
-    params[++top].elementAddress = value;
 }
 
-int64_t CPU::GetEventLocation(SystemErrorHandlers errorHandler, int64_t moduleId)
+void CPU::StackOperation(void (DslValue::*operation)(DslValue *))
 {
+    DslValue *right = SlotValue(top);
+    DslValue *left = SlotValue(top - 1);
+    (left->*operation)(right);
+    LoadSlot(top - 1);
+    --top;
+}
 
-//    DslValue *onError = program[base + (10 * (instruction->moduleId-1))];
-//    handlerLocation = onError->position;
+int64_t CPU::GetEventLocation(SystemErrorHandlers errorHandler, int64_t moduleId)
+{
+    //The EFI instructions are among the records that follow the program's END instruction.
+    for(int64_t ii=codeCount-1; ii>=0 && code[ii].opcode != END; --ii)
+    {
+        if ( code[ii].opcode == EFI && code[ii].operand == errorHandler && code[ii].moduleId == moduleId )
+        {
+            return code[ii].location;
+        }
+    }
 
     return 0;
 }
@@ -1704,280 +3334,417 @@ int64_t CPU::GetEventLocation(SystemErrorHandlers errorHandler, int64_t moduleId
 /// \desc calls the on error handler if one exists.
 void CPU::JumpToOnErrorHandler()
 {
-    auto totalParams = params[top].iValue;
-
-    DslValue *instruction = instructions[PC];
-
-    int64_t base = instructions[0]->location;
-
-    int64_t onErrorLocation = GetEventLocation(ON_ERROR, instruction->moduleId);
+    int64_t onErrorLocation = GetEventLocation(ON_ERROR, code[PC].moduleId);
 
     if ( onErrorLocation == 0 )
     {
         printf("%s", szErrorMsg.cStr());
-        PC = instructions.Count();
+        PC = codeCount;
         return;
     }
 
-    int64_t pcReturn = PC;
-    int64_t saved = BP;
-    BP = top - totalParams;
-    PC = onErrorLocation;
+    if ( !RunEventHandler(onErrorLocation, A) )
+    {
+        return;
+    }
+
+    //Check handler return code.
+    A->Convert(INTEGER_VALUE);
+    switch( A->iValue )
+    {
+        //These require the sim framework, without it the program stops.
+        case 200: //error.restart
+        case 300: //error.reload
+        case 400: //error.waitQuit
+        case 500: //error.WaitReload
+            PC = codeCount;
+            break;
+        case 100: //return error.continue
+        default:  //error.quit
+            break;
+    }
+}
 
-    while(PC < instructions[0]->location )
+bool CPU::RunEventHandler(int64_t location, DslValue *result)
+{
+    int64_t pcReturn = PC;
+    int64_t sBP = BP;
+    int64_t stop = top;
+    int64_t savedFrameBase = frameBase;
+
+    //The handler runs like a call with no parameters on a frame above the interrupted code's
+    //stack and locals, so nothing it does can change them and only the registers are restored.
+    top = BP + image->localSlots - 1 > top ? BP + image->localSlots - 1 : top;
+    ++top;
+    CheckFrame(location);
+    params.At(top) = Value();
+    BP = top;
+    PC = location;
+    frameBase = frames.Count();
+
+    bool returned = false;
+    while( PC < codeCount )
     {
-        DslValue *dslValue = instructions[PC++];
-        //If return from on error handler.
-        if ( dslValue->opcode == RET )
+        Instruction *instruction = &code[PC++];
+        //The handler ends with the RFE of an event return or the RET of a return on its own
+        //frame, either way the value returned is on the top of the stack.
+        if ( instruction->opcode == RFE || (instruction->opcode == RET && frames.Count() == frameBase) )
         {
-            //Check handler return code.
-            A->SAV(&params[top]);
-            A->Convert(INTEGER_VALUE);
-            --top;
-            switch( A->iValue )
+            if ( result != nullptr )
             {
-                case 100:   //return error.continue
-                    BP = saved;
-                    top -= totalParams + 1;
-                    params[++top].SAV(A);
-                    PC = pcReturn;
-                    return;
-                //The rest of these require the sim framework
-                case 200: //error.restart
-                case 300: //error.reload
-                case 400: //error.waitQuit
-                case 500: //error.WaitReload
-                    break;
-                default: //error.quit
-                    BP = saved;
-                    top -= totalParams + 1;
-                    params[++top].SAV(A);
-                    PC = pcReturn;
-                    return;
+                StoreSlot(result, top);
             }
+            returned = true;
+            break;
         }
 
-        if ( !RunInstruction(dslValue) )
+        if ( !RunInstruction(instruction) )
         {
             break;
         }
     }
+
+    frames.Resize(frameBase);
+    frameBase = savedFrameBase;
+    if ( !returned )
+    {
+        return false;
+    }
+
+    PC = pcReturn;
+    BP = sBP;
+    top = stop;
+
+    return true;
 }
 
-/// \desc calls the on error handler if one exists.
-void CPU::JumpToOnTick()
+/// \desc Handles a pending interrupt.
+void CPU::ProcessInterrupt()
 {
-    if ( onTickEvent == 0 )
+    interruptPending = false;
+    ++eventChecks;
+
+    if ( errorCode != 0 )
     {
-        return;
+        JumpToOnErrorHandler();
+        errorCode = 0;
     }
-
-    if ( clock() < nextTick )
+    else
     {
-        return;
+        eventBudget = eventCheckInterval;
+        JumpToOnTick();
     }
 
-    nextTick = clock() + TICKS_PER_SECOND;
+    //Errors raised and budget used by the handlers are not carried into the interrupted code.
+    interruptPending = false;
+}
 
-    List<DslValue> pSave;  //function call parameters stack
-    int64_t pcReturn = PC;
-    int64_t sBP = BP;
-    PC = onTickEvent;
-    int64_t stop = top;
-    pSave.CopyFrom(&params);
+/// \desc Advances the on tick clock, called on every event check.
+bool CPU::TickDue()
+{
+    int64_t interval = 1000000000LL / ticksPerSecond;
 
-    DslValue *instruction = instructions[PC++];
-    while( instruction->opcode != RFE )
+    if ( virtualTime )
     {
-        if (!RunInstruction(instruction))
+        simulatedTime += interval;
+        if ( !maxSpeed )
         {
-            break;
+            int64_t wait = clockStart + simulatedTime - MonotonicTime();
+            if ( wait > 0 )
+            {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+            }
         }
-        instruction = instructions[PC++];
+        return true;
     }
-    PC = pcReturn;
-    BP = sBP;
-    top = stop;
-    params.CopyFrom(&pSave);
+
+    int64_t now = MonotonicTime();
+    if ( now < nextTick )
+    {
+        return false;
+    }
+
+    nextTick = now + interval;
+    simulatedTime = now - clockStart;
+    return true;
 }
 
-bool CPU::RunInstruction(DslValue *dslValue)
+/// \desc calls the on tick handler if one exists and it is time to call it.
+void CPU::JumpToOnTick()
 {
-   SetTickEvent(dslValue);
+    if ( !TickDue() )
+    {
+        return;
+    }
+
+    SetTickEvent(&code[PC]);
+
+    if ( onTickEvent == 0 )
+    {
+        return;
+    }
 
-    switch( dslValue->opcode )
+    RunEventHandler(onTickEvent, nullptr);
+}
+
+bool CPU::RunInstruction(Instruction *instruction)
+{
+    switch( instruction->opcode )
     {
         case END:
-            PC = instructions.Count();
+            PC = codeCount;
             return false;
         case COM: case CID: case EFI: case DEF: case NOP: case PSP: case RFE:
             break;
         case SLV:
-            params[BP+params[top - 1].operand].SAV(&params[top]);
+            CopySlot(LocalSlot(params.At(top - 1).operand), top);
             top--;
             break;
         case SAV:
-            params[top-1].elementAddress->SAV(&params[top]);
+            StoreSlot(Box(top-1)->elementAddress, top);
             top--;
             top--;
             break;
         case ADA:
-            params[top-1].elementAddress->ADD(&params[top]);
-            --top;
+            Box(top-1)->elementAddress->ADD(SlotValue(top));
+            top -= 2;
             break;
         case SUA:
-            params[top-1].elementAddress->SUB(&params[top]);
-            --top;
+            Box(top-1)->elementAddress->SUB(SlotValue(top));
+            top -= 2;
             break;
         case MUA:
-            params[top-1].elementAddress->MUL(&params[top]);
-            --top;
+            Box(top-1)->elementAddress->MUL(SlotValue(top));
+            top -= 2;
             break;
         case DIA:
-            params[top-1].elementAddress->DIV(&params[top]);
-            --top;
+            Box(top-1)->elementAddress->DIV(SlotValue(top));
+            top -= 2;
             break;
         case MOA:
-            params[top-1].elementAddress->MOD(&params[top]);
-            --top;
+            Box(top-1)->elementAddress->MOD(SlotValue(top));
+            top -= 2;
             break;
         case DCS:
-            SetCollectionElementDirect(dslValue);
+            SetCollectionElementDirect(instruction);
+            break;
+        case ITS:
+            StartIteration(instruction);
+            break;
+        case ITN:
+            NextIteration(instruction);
+            break;
+        case ITK:
+            IterationKey(instruction);
+            break;
+        case ITV:
+            IterationValue(instruction);
             break;
         case PVA:
-            PushVariableAddress(instructions[dslValue->operand]);
+            PushVariableAddress(Global(instruction));
             break;
         case PCV:
-            dslValue = GetCollectionElement(instructions[dslValue->operand]);
-            params[++top].LiteCopy(dslValue);
-            params[top].elementAddress = dslValue;
+        {
+            DslValue *element = GetCollectionElement(Global(instruction));
+            SetSlot(++top, element);
+            Box(top)->elementAddress = element;
+            CheckStack();
             break;
+        }
         case EXP:
-            params[top - 1].EXP(&params[top]);
-            top--;
+            StackOperation(&DslValue::EXP);
             break;
         case MUL:
-            params[top - 1].MUL(&params[top]);
-            top--;
+            if ( QuickenInstruction(instruction) )
+            {
+                break;
+            }
+            StackOperation(&DslValue::MUL);
             break;
         case DIV:
-            params[top - 1].DIV(&params[top]);
-            top--;
+            if ( QuickenInstruction(instruction) )
+            {
+                break;
+            }
+            StackOperation(&DslValue::DIV);
             break;
         case ADD:
-            params[top - 1].ADD(&params[top]);
-            top--;
+            if ( QuickenInstruction(instruction) )
+            {
+                break;
+            }
+            StackOperation(&DslValue::ADD);
             break;
         case SUB:
-            params[top - 1].SUB(&params[top]); top--;
+            if ( QuickenInstruction(instruction) )
+            {
+                break;
+            }
+            StackOperation(&DslValue::SUB);
             break;
         case MOD:
-            params[top - 1].MOD(&params[top]); top--;
+            StackOperation(&DslValue::MOD);
             break;
         case XOR:
-            params[top - 1].XOR(&params[top]); top--;
+            StackOperation(&DslValue::XOR);
             break;
         case BND:
-            params[top - 1].BND(&params[top]); top--;
+            StackOperation(&DslValue::BND);
             break;
         case BOR:
-            params[top - 1].BOR(&params[top]); top--;
+            StackOperation(&DslValue::BOR);
             break;
         case SVL:
-            params[top - 1].SVL(&params[top]); top--;
+            StackOperation(&DslValue::SVL);
             break;
         case SVR:
-            params[top - 1].SVR(&params[top]); top--;
+            StackOperation(&DslValue::SVR);
             break;
         case TEQ:
-            params[top - 1].TEQ(&params[top]); top--;
+            if ( QuickenInstruction(instruction) )
+            {
+                break;
+            }
+            StackOperation(&DslValue::TEQ);
             break;
         case TNE:
-            params[top - 1].TNE(&params[top]); top--;
+            if ( QuickenInstruction(instruction) )
+            {
+                break;
+            }
+            StackOperation(&DslValue::TNE);
             break;
         case TGR:
-            params[top - 1].TGR(&params[top]); top--;
+            if ( QuickenInstruction(instruction) )
+            {
+                break;
+            }
+            StackOperation(&DslValue::TGR);
             break;
         case TGE:
-            params[top - 1].TGE(&params[top]); top--;
+            if ( QuickenInstruction(instruction) )
+            {
+                break;
+            }
+            StackOperation(&DslValue::TGE);
             break;
         case TLS:
-            params[top - 1].TLS(&params[top]); top--;
+            if ( QuickenInstruction(instruction) )
+            {
+                break;
+            }
+            StackOperation(&DslValue::TLS);
             break;
         case TLE:
-            params[top - 1].TLE(&params[top]); top--;
+            if ( QuickenInstruction(instruction) )
+            {
+                break;
+            }
+            StackOperation(&DslValue::TLE);
             break;
         case AND:
-            params[top - 1].AND(&params[top]); top--;
+            StackOperation(&DslValue::AND);
             break;
         case LOR:
-            params[top - 1].LOR(&params[top]); top--;
+            StackOperation(&DslValue::LOR);
             break;
         case INL:
-            params[BP+dslValue->operand].INC();
+            SlotValue(BP+instruction->operand)->INC();
+            LoadSlot(BP+instruction->operand);
             break;
         case DEL:
-            params[BP+dslValue->operand].DEC();
+            SlotValue(BP+instruction->operand)->DEC();
+            LoadSlot(BP+instruction->operand);
             break;
         case INC:
-            instructions[dslValue->operand]->INC();
+            Global(instruction)->INC();
             break;
         case DEC:
-            instructions[dslValue->operand]->DEC();
+            Global(instruction)->DEC();
             break;
         case NOT:
-            params[top].NOT();
+            SlotValue(top)->NOT();
+            LoadSlot(top);
             break;
         case NEG:
-            params[top].NEG();
+            SlotValue(top)->NEG();
+            LoadSlot(top);
             break;
         case CTI:
-            params[top].Convert(INTEGER_VALUE);
+            SlotValue(top)->Convert(INTEGER_VALUE);
+            LoadSlot(top);
             break;
         case CTD:
-            params[top].Convert(DOUBLE_VALUE);
+            SlotValue(top)->Convert(DOUBLE_VALUE);
+            LoadSlot(top);
             break;
         case CTC:
-            params[top].Convert(CHAR_VALUE);
+            SlotValue(top)->Convert(CHAR_VALUE);
+            LoadSlot(top);
             break;
         case CTS:
-            params[top].Convert(STRING_VALUE);
+            SlotValue(top)->Convert(STRING_VALUE);
+            LoadSlot(top);
             break;
         case CTB:
-            params[top].Convert(BOOL_VALUE);
+            SlotValue(top)->Convert(BOOL_VALUE);
+            LoadSlot(top);
             break;
         case JIF:
-            PC = (params[top].bValue) ? PC : dslValue->location; top--;
+            PC = (params.At(top).IsTrue()) ? PC : instruction->location; top--;
+            CheckJumpStack();
+            CountBranch();
             break;
         case JIT:
-            PC = (params[top].bValue) ? dslValue->location : PC; top--;
+            PC = (params.At(top).IsTrue()) ? instruction->location : PC; top--;
+            CheckJumpStack();
+            CountBranch();
             break;
         case JMP:
-            PC = dslValue->location;
+            PC = instruction->location;
+            CheckJumpStack();
+            CountBranch();
             break;
         case JBF:
-            JumpToBuiltInFunction(dslValue);
+            JumpToBuiltInFunction(instruction);
             break;
         case PSI:
-            params[++top].LiteCopy(dslValue);
+            SetSlot(++top, instruction->value);
             break;
         case PSV:
-            params[++top].LiteCopy(instructions[dslValue->operand]);
+            SetSlot(++top, Global(instruction));
             break;
         case DFL:
-            params.push_back(DslValue(DFL, params.Count()));
+        {
+            Value local;
+            local.operand = (int32_t)params.Count();
+            params.push_back(local);
             break;
+        }
         case PSL:
-            params[++top].LiteCopy(&params[BP+dslValue->operand]);
-            params[top].operand = dslValue->operand;
+            CopySlot(++top, BP+instruction->operand);
+            params.At(top).operand = (int32_t)instruction->operand;
             break;
         case RET:
-            return false;
+            return ReturnFromSubroutine();
         case JSR:
-            JumpToSubroutine(dslValue);
+            JumpToSubroutine(instruction);
             break;
         case JTB:
-            ProcessJumpTable(dslValue);
+            ProcessJumpTable(instruction);
+            break;
+        case AVI: case AVV: case SVI: case LOI: case CVI: case CVV: case CLI:
+            RunFusedInstruction(instruction);
+            break;
+        case ADD_II: case SUB_II: case MUL_II: case TEQ_II: case TNE_II: case TGR_II: case TGE_II:
+        case TLS_II: case TLE_II: case ADD_DD: case SUB_DD: case MUL_DD: case DIV_DD: case TEQ_DD:
+        case TNE_DD: case TGR_DD: case TGE_DD: case TLS_DD: case TLE_DD:
+            if ( !RunQuickenedInstruction(instruction) )
+            {
+                Instruction generic = *instruction;
+                generic.opcode = DeoptimizeInstruction(instruction);
+                return RunInstruction(&generic);
+            }
             break;
     }
 
@@ -1986,52 +3753,417 @@ bool CPU::RunInstruction(DslValue *dslValue)
 
 void CPU::RunNoTrace()
 {
-    bool errorMode = false;
-    bool onTickCalled = false;
-
-    int64_t programEnd = instructions.Count();
+    int64_t programEnd = codeCount;
 
     while(PC < programEnd )
     {
-        //If an error has been raised, switch to error mode which only processes the
-        //on error callback if one exists, if not the error is simply sent to the
-        //console and the program exited.
-        if ( errorCode != 0 && !errorMode )
+        //If an error has been raised the on error callback is called if one exists, if
+        //not the error is simply sent to the console and the program exited. Otherwise
+        //the event budget ran out and the on tick timer is checked.
+        if ( interruptPending )
         {
-            errorMode = true;
-            JumpToOnErrorHandler();
-            errorCode = 0;
-            errorMode = false;
+            ProcessInterrupt();
             continue;
         }
 
-        JumpToOnTick();
-
-        if( !RunInstruction(instructions[PC++]) )
+        if( !RunInstruction(&code[PC++]) )
         {
             break;
         }
     }
 }
 
+#ifdef THREADED_DISPATCH
+
+/// \desc Fetches the next instruction and jumps to its handler. Errors and on tick checks are
+///       both signalled by the interrupt pending flag so the common case is one test and one
+///       indirect jump.
+#define DISPATCH()                                                                              \
+    instruction = &code[PC++];                                                                  \
+    if ( interruptPending )                                                                     \
+    {                                                                                           \
+        goto checkEvents;                                                                       \
+    }                                                                                           \
+    goto *dispatchTable[instruction->opcode]
+
+/// \desc Body of a quickened instruction. Checks both operands are valueType and runs operation
+///       on them, otherwise rewrites the instruction back to its generic instruction and runs that.
+#define QUICKENED(valueType, operation)                                                         \
+    {                                                                                           \
+        Value *right = &params.At(top);                                                         \
+        Value *left = &params.At(top - 1);                                                      \
+        if ( left->type != (valueType) || right->type != (valueType) )                          \
+        {                                                                                       \
+            goto *dispatchTable[DeoptimizeInstruction(instruction)];                            \
+        }                                                                                       \
+        operation;                                                                              \
+        --top;                                                                                  \
+        DISPATCH();                                                                             \
+    }
+
+void CPU::RunThreaded()
+{
+    //Must be kept in the same order as the OPCODES enumeration.
+    static const void *dispatchTable[] =
+    {
+        &&opNOP, //Opcodes start with 1
+        &&opNOP, &&opNOP, &&opSAV, &&opEXP, &&opMUL, &&opDIV, &&opADD, &&opSUB, &&opMOD, &&opXOR,
+        &&opBND, &&opBOR, &&opINC, &&opDEC, &&opNOT, &&opNEG, &&opSVL, &&opSVR, &&opCTI, &&opCTD,
+        &&opCTC, &&opCTS, &&opCTB, &&opJMP, &&opJIF, &&opJIT, &&opJBF, &&opJSR, &&opRET, &&opPSI,
+        &&opPSV, &&opEND, &&opTEQ, &&opTNE, &&opTGR, &&opTGE, &&opTLS, &&opTLE, &&opAND, &&opLOR,
+        &&opJTB, &&opDFL, &&opPSL, &&opSLV, &&opNOP, &&opINL, &&opDEL, &&opPCV, &&opPVA, &&opADA,
+        &&opSUA, &&opMUA, &&opDIA, &&opMOA, &&opDCS, &&opNOP, &&opNOP, &&opNOP, &&opNOP, &&opITS,
+        &&opITN, &&opITK, &&opITV, &&opFUSED, &&opFUSED, &&opFUSED, &&opFUSED, &&opFUSED, &&opFUSED,
+        &&opFUSED, &&opADD_II,
+        &&opSUB_II, &&opMUL_II, &&opTEQ_II, &&opTNE_II, &&opTGR_II, &&opTGE_II, &&opTLS_II,
+        &&opTLE_II, &&opADD_DD, &&opSUB_DD, &&opMUL_DD, &&opDIV_DD, &&opTEQ_DD, &&opTNE_DD,
+        &&opTGR_DD, &&opTGE_DD, &&opTLS_DD, &&opTLE_DD
+    };
+
+    Instruction *instruction;
+
+    DISPATCH();
+
+checkEvents:
+    //If an error has been raised the on error callback is called if one exists, if
+    //not the error is simply sent to the console and the program exited. Otherwise
+    //the event budget ran out and the on tick timer is checked.
+    --PC;
+    ProcessInterrupt();
+    if ( PC >= codeCount )
+    {
+        return;
+    }
+    DISPATCH();
+
+opNOP:
+    DISPATCH();
+opEND:
+    PC = codeCount;
+    return;
+opRET:
+    if ( !ReturnFromSubroutine() )
+    {
+        return;
+    }
+    DISPATCH();
+opSLV:
+    CopySlot(LocalSlot(params.At(top - 1).operand), top);
+    top--;
+    DISPATCH();
+opSAV:
+    StoreSlot(Box(top-1)->elementAddress, top);
+    top -= 2;
+    DISPATCH();
+opADA:
+    Box(top-1)->elementAddress->ADD(SlotValue(top));
+    top -= 2;
+    DISPATCH();
+opSUA:
+    Box(top-1)->elementAddress->SUB(SlotValue(top));
+    top -= 2;
+    DISPATCH();
+opMUA:
+    Box(top-1)->elementAddress->MUL(SlotValue(top));
+    top -= 2;
+    DISPATCH();
+opDIA:
+    Box(top-1)->elementAddress->DIV(SlotValue(top));
+    top -= 2;
+    DISPATCH();
+opMOA:
+    Box(top-1)->elementAddress->MOD(SlotValue(top));
+    top -= 2;
+    DISPATCH();
+opDCS:
+    SetCollectionElementDirect(instruction);
+    DISPATCH();
+opITS:
+    StartIteration(instruction);
+    DISPATCH();
+opITN:
+    NextIteration(instruction);
+    DISPATCH();
+opITK:
+    IterationKey(instruction);
+    DISPATCH();
+opITV:
+    IterationValue(instruction);
+    DISPATCH();
+opPVA:
+    PushVariableAddress(Global(instruction));
+    DISPATCH();
+opPCV:
+{
+    DslValue *element = GetCollectionElement(Global(instruction));
+    SetSlot(++top, element);
+    Box(top)->elementAddress = element;
+    CheckStack();
+    DISPATCH();
+}
+opEXP:
+    StackOperation(&DslValue::EXP);
+    DISPATCH();
+opMUL:
+    if ( QuickenInstruction(instruction) )
+    {
+        DISPATCH();
+    }
+    StackOperation(&DslValue::MUL);
+    DISPATCH();
+opDIV:
+    if ( QuickenInstruction(instruction) )
+    {
+        DISPATCH();
+    }
+    StackOperation(&DslValue::DIV);
+    DISPATCH();
+opADD:
+    if ( QuickenInstruction(instruction) )
+    {
+        DISPATCH();
+    }
+    StackOperation(&DslValue::ADD);
+    DISPATCH();
+opSUB:
+    if ( QuickenInstruction(instruction) )
+    {
+        DISPATCH();
+    }
+    StackOperation(&DslValue::SUB);
+    DISPATCH();
+opMOD:
+    StackOperation(&DslValue::MOD);
+    DISPATCH();
+opXOR:
+    StackOperation(&DslValue::XOR);
+    DISPATCH();
+opBND:
+    StackOperation(&DslValue::BND);
+    DISPATCH();
+opBOR:
+    StackOperation(&DslValue::BOR);
+    DISPATCH();
+opSVL:
+    StackOperation(&DslValue::SVL);
+    DISPATCH();
+opSVR:
+    StackOperation(&DslValue::SVR);
+    DISPATCH();
+opTEQ:
+    if ( QuickenInstruction(instruction) )
+    {
+        DISPATCH();
+    }
+    StackOperation(&DslValue::TEQ);
+    DISPATCH();
+opTNE:
+    if ( QuickenInstruction(instruction) )
+    {
+        DISPATCH();
+    }
+    StackOperation(&DslValue::TNE);
+    DISPATCH();
+opTGR:
+    if ( QuickenInstruction(instruction) )
+    {
+        DISPATCH();
+    }
+    StackOperation(&DslValue::TGR);
+    DISPATCH();
+opTGE:
+    if ( QuickenInstruction(instruction) )
+    {
+        DISPATCH();
+    }
+    StackOperation(&DslValue::TGE);
+    DISPATCH();
+opTLS:
+    if ( QuickenInstruction(instruction) )
+    {
+        DISPATCH();
+    }
+    StackOperation(&DslValue::TLS);
+    DISPATCH();
+opTLE:
+    if ( QuickenInstruction(instruction) )
+    {
+        DISPATCH();
+    }
+    StackOperation(&DslValue::TLE);
+    DISPATCH();
+opAND:
+    StackOperation(&DslValue::AND);
+    DISPATCH();
+opLOR:
+    StackOperation(&DslValue::LOR);
+    DISPATCH();
+opINL:
+    SlotValue(BP+instruction->operand)->INC();
+    LoadSlot(BP+instruction->operand);
+    DISPATCH();
+opDEL:
+    SlotValue(BP+instruction->operand)->DEC();
+    LoadSlot(BP+instruction->operand);
+    DISPATCH();
+opINC:
+    Global(instruction)->INC();
+    DISPATCH();
+opDEC:
+    Global(instruction)->DEC();
+    DISPATCH();
+opNOT:
+    SlotValue(top)->NOT();
+    LoadSlot(top);
+    DISPATCH();
+opNEG:
+    SlotValue(top)->NEG();
+    LoadSlot(top);
+    DISPATCH();
+opCTI:
+    SlotValue(top)->Convert(INTEGER_VALUE);
+    LoadSlot(top);
+    DISPATCH();
+opCTD:
+    SlotValue(top)->Convert(DOUBLE_VALUE);
+    LoadSlot(top);
+    DISPATCH();
+opCTC:
+    SlotValue(top)->Convert(CHAR_VALUE);
+    LoadSlot(top);
+    DISPATCH();
+opCTS:
+    SlotValue(top)->Convert(STRING_VALUE);
+    LoadSlot(top);
+    DISPATCH();
+opCTB:
+    SlotValue(top)->Convert(BOOL_VALUE);
+    LoadSlot(top);
+    DISPATCH();
+opJIF:
+    PC = (params.At(top).IsTrue()) ? PC : instruction->location; top--;
+    CheckJumpStack();
+    CountBranch();
+    DISPATCH();
+opJIT:
+    PC = (params.At(top).IsTrue()) ? instruction->location : PC; top--;
+    CheckJumpStack();
+    CountBranch();
+    DISPATCH();
+opJMP:
+    PC = instruction->location;
+    CheckJumpStack();
+    CountBranch();
+    DISPATCH();
+opJBF:
+    JumpToBuiltInFunction(instruction);
+    DISPATCH();
+opPSI:
+    SetSlot(++top, instruction->value);
+    DISPATCH();
+opPSV:
+    SetSlot(++top, Global(instruction));
+    DISPATCH();
+opDFL:
+{
+    Value local;
+    local.operand = (int32_t)params.Count();
+    params.push_back(local);
+}
+    DISPATCH();
+opPSL:
+    CopySlot(++top, BP+instruction->operand);
+    params.At(top).operand = (int32_t)instruction->operand;
+    DISPATCH();
+opJSR:
+    JumpToSubroutine(instruction);
+    DISPATCH();
+opJTB:
+    ProcessJumpTable(instruction);
+    DISPATCH();
+opFUSED:
+    RunFusedInstruction(instruction);
+    DISPATCH();
+opADD_II:
+    QUICKENED(INTEGER_VALUE, left->iValue += right->iValue)
+opSUB_II:
+    QUICKENED(INTEGER_VALUE, left->iValue -= right->iValue)
+opMUL_II:
+    QUICKENED(INTEGER_VALUE, left->iValue *= right->iValue)
+opTEQ_II:
+    QUICKENED(INTEGER_VALUE, left->bValue = left->iValue == right->iValue; left->type = BOOL_VALUE)
+opTNE_II:
+    QUICKENED(INTEGER_VALUE, left->bValue = left->iValue != right->iValue; left->type = BOOL_VALUE)
+opTGR_II:
+    QUICKENED(INTEGER_VALUE, left->bValue = left->iValue > right->iValue; left->type = BOOL_VALUE)
+opTGE_II:
+    QUICKENED(INTEGER_VALUE, left->bValue = left->iValue >= right->iValue; left->type = BOOL_VALUE)
+opTLS_II:
+    QUICKENED(INTEGER_VALUE, left->bValue = left->iValue < right->iValue; left->type = BOOL_VALUE)
+opTLE_II:
+    QUICKENED(INTEGER_VALUE, left->bValue = left->iValue <= right->iValue; left->type = BOOL_VALUE)
+opADD_DD:
+    QUICKENED(DOUBLE_VALUE, left->dValue += right->dValue)
+opSUB_DD:
+    QUICKENED(DOUBLE_VALUE, left->dValue -= right->dValue)
+opMUL_DD:
+    QUICKENED(DOUBLE_VALUE, left->dValue *= right->dValue)
+opDIV_DD:
+    //Divide by zero is reported by the generic instruction.
+    if ( !RunQuickenedInstruction(instruction) )
+    {
+        goto *dispatchTable[DeoptimizeInstruction(instruction)];
+    }
+    DISPATCH();
+opTEQ_DD:
+    QUICKENED(DOUBLE_VALUE, left->bValue = left->dValue == right->dValue; left->type = BOOL_VALUE)
+opTNE_DD:
+    QUICKENED(DOUBLE_VALUE, left->bValue = left->dValue != right->dValue; left->type = BOOL_VALUE)
+opTGR_DD:
+    QUICKENED(DOUBLE_VALUE, left->bValue = left->dValue > right->dValue; left->type = BOOL_VALUE)
+opTGE_DD:
+    QUICKENED(DOUBLE_VALUE, left->bValue = left->dValue >= right->dValue; left->type = BOOL_VALUE)
+opTLS_DD:
+    QUICKENED(DOUBLE_VALUE, left->bValue = left->dValue < right->dValue; left->type = BOOL_VALUE)
+opTLE_DD:
+    QUICKENED(DOUBLE_VALUE, left->bValue = left->dValue <= right->dValue; left->type = BOOL_VALUE)
+}
+
+#undef QUICKENED
+#undef DISPATCH
+
+#else
+
+void CPU::RunThreaded()
+{
+    RunNoTrace();
+}
+
+#endif
+
 void CPU::RunTrace()
 {
     DslValue left;
     DslValue right;
-    bool errorMode = false;
-    bool onTickCalled = false;
 
-    int64_t programEnd = instructions.Count();
+    int64_t programEnd = codeCount;
 
     putchar('\n');
     while(PC < programEnd )
     {
-        DisplayASMCodeLine(instructions, PC, false);
+        if ( interruptPending )
+        {
+            ProcessInterrupt();
+            continue;
+        }
+
+        DisplayASMCodeLine(PC, false);
 
-        DslValue *instruction = instructions[PC++];
+        Instruction *instruction = &code[PC++];
         switch( GetInstructionOperands(instruction, &left, &right) )
         {
             case 0:
+                printf("\n");
                 break;
             case 1:
                 printf(";top = %ld\t", (long)top);
@@ -2047,17 +4179,6 @@ void CPU::RunTrace()
                 break;
         }
 
-        if ( errorCode != 0 && !errorMode )
-        {
-            errorMode = true;
-            JumpToOnErrorHandler();
-            errorCode = 0;
-            errorMode = false;
-            continue;
-        }
-
-        JumpToOnTick();
-
         if ( !RunInstruction(instruction) )
         {
             break;
@@ -2065,7 +4186,7 @@ void CPU::RunTrace()
     }
 }
 
-int64_t CPU::GetInstructionOperands(DslValue *instruction, DslValue *left,  DslValue *right)
+int64_t CPU::GetInstructionOperands(Instruction *instruction, DslValue *left,  DslValue *right)
 {
     int64_t operands = 0;
     right = nullptr;
@@ -2074,30 +4195,31 @@ int64_t CPU::GetInstructionOperands(DslValue *instruction, DslValue *left,  DslV
     switch( instruction->opcode )
     {
         case SLV:
-            left = &params[BP+params[top - 1].operand];
-            right = &params[top];
+            left = SlotValue(LocalSlot(params.At(top - 1).operand));
+            right = SlotValue(top);
             operands = 2;
             break;
         case CID: case SAV: case ADA: case SUA: case MUA: case DIA: case MOA: case EXP:
         case MUL: case DIV: case ADD: case SUB: case MOD: case XOR: case BND: case BOR:
         case SVL: case SVR: case TEQ: case TNE: case TGR: case TGE: case TLS: case TLE:
-        case AND: case LOR:
-            right = &params[top];
-            left = params[top-1].elementAddress;
+        case AND: case LOR: case ADD_II: case SUB_II: case MUL_II: case TEQ_II: case TNE_II:
+        case TGR_II: case TGE_II: case TLS_II: case TLE_II: case ADD_DD: case SUB_DD: case MUL_DD:
+        case DIV_DD: case TEQ_DD: case TNE_DD: case TGR_DD: case TGE_DD: case TLS_DD: case TLE_DD:
+            right = SlotValue(top);
+            left = Box(top-1)->elementAddress;
             operands = 2;
             break;
         case DCS:
         {
-            right = &params[top];
-            auto *var = instructions[instruction->operand];
-            auto *key = var->indexes.keys[instruction->iValue];
-            left = ((DslValue *)var->indexes.Get(key)->Data());
+            right = SlotValue(top);
+            auto *var = Global(instruction);
+            left = ((DslValue *)var->indexes.Entry(instruction->location)->Data());
             operands = 2;
             break;
         }
         case PVA:
         {
-            left = instructions[instruction->operand];
+            left = Global(instruction);
             if (left->type == COLLECTION )
             {
                 left = GetCollectionElement(left);
@@ -2106,52 +4228,61 @@ int64_t CPU::GetInstructionOperands(DslValue *instruction, DslValue *left,  DslV
             break;
         }
         case PCV:
-            left = GetCollectionElement(instructions[instruction->operand]);
+            left = GetCollectionElement(Global(instruction));
             left->elementAddress = left;
             operands = 1;
             break;
         case INL: case DEL:
-            left = &params[BP+instruction->operand];
+            left = SlotValue(BP+instruction->operand);
+            operands = 1;
+            break;
+        case INC: case DEC: case ITN:
+            left = Global(instruction);
+            operands = 1;
+            break;
+        case ITS:
+            left = SlotValue(top);
             operands = 1;
             break;
-        case INC: case DEC:
-            left = instructions[instruction->operand];
+        case ITK: case ITV:
+            left = globals.At(instruction->location);
             operands = 1;
             break;
         case NOT: case NEG: case CTI: case CTD: case CTC: case CTS: case CTB:
-            left = &params[top];
+            left = SlotValue(top);
             operands = 1;
             break;
         case JIF: case JIT:
-            left = &params[top];
-            right = instruction;
+            left = SlotValue(top);
+            right = image->instructions[PC-1];
             operands = 2;
             break;
         case JBF:
-            left = instruction;
+            left = image->instructions[PC-1];
             operands = 1;
             break;
         case PSI:
-            left = &params[top+1];
+            left = SlotValue(top+1);
             operands = 1;
             break;
         case PSV:
-            left = instructions[instruction->operand];
+            left = Global(instruction);
             operands = 1;
             break;
         case DFL:
             left = new DslValue(DFL, params.Count());
             break;
         case PSL:
-            left = &params[BP+instruction->operand];
-            left->operand = instruction->operand;
+            params.At(BP+instruction->operand).operand = (int32_t)instruction->operand;
+            left = SlotValue(BP+instruction->operand);
             break;
         case JMP: case JSR: case JTB: case NOP: case DEF: case END: case PSP: case EFI: case RFE:
         case RET:
-            left = instruction;
+            left = image->instructions[PC-1];
             operands = 1;
             break;
         case COM:
+        case AVI: case AVV: case SVI: case LOI: case CVI: case CVV: case CLI:
             break;
     }
 
@@ -2160,16 +4291,16 @@ int64_t CPU::GetInstructionOperands(DslValue *instruction, DslValue *left,  DslV
 
 /// \desc Ensures that the on tick event pointer is set to the correct module function.
 /// \param dslValue Instruction about to be run.
-void CPU::SetTickEvent(DslValue *dslValue)
+void CPU::SetTickEvent(Instruction *instruction)
 {
-    if ( lastModuleId == dslValue->moduleId )
+    if ( lastModuleId == instruction->moduleId )
     {
         return;
     }
     else
     {
-        lastModuleId = dslValue->moduleId;
-        onTickEvent = GetEventLocation(ON_TICK, dslValue->moduleId);
+        lastModuleId = instruction->moduleId;
+        onTickEvent = GetEventLocation(ON_TICK, instruction->moduleId);
     }
 }
 
@@ -2182,10 +4313,30 @@ CPU::CPU()
     A = new DslValue();
     params.Clear();
     errorCode = 0;
-    nextTick = clock() + TICKS_PER_SECOND;
-    lastModuleId = 1;
+    interruptPending = false;
+    totalParameters = -1;
+    randomState = initialState;
+    ticksPerSecond = TICKS_PER_SECOND;
+    virtualTime = false;
+    maxSpeed = false;
+    simulatedTime = 0;
+    clockStart = MonotonicTime();
+    nextTick = clockStart + 1000000000LL / ticksPerSecond;
+    eventCheckInterval = EVENT_CHECK_INTERVAL;
+    eventChecks = 0;
+    eventBudget = EVENT_CHECK_INTERVAL;
+    lastModuleId = 0;
     onTickEvent = 0;
-    instructions.Clear();
+    threadedDispatch = false;
+    maxCallDepth = DEFAULT_MAX_CALL_DEPTH;
+    frameBase = 0;
+    fuseInstructions = true;
+    quickenInstructions = true;
+    image = nullptr;
+    code = nullptr;
+    codeCount = 0;
+    stackLimit = -1;
+    jumpStackLimit = -1;
 }
 
 #pragma clang diagnostic pop
\ No newline at end of file
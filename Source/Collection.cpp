@@ -3,15 +3,299 @@
 //
 
 #include "../Includes/Collection.h"
+#include "../Includes/DslValue.h"
+
+CollectionTable::CollectionTable(CollectionTable *source)
+{
+    entries = inlineEntries;
+    count = 0;
+    indexed = source->indexed;
+    capacity = COLLECTION_INLINE_KEYS;
+    slots = nullptr;
+    slotMask = 0;
+    references = 1;
+
+    if ( source->count > capacity )
+    {
+        entries = new KeyData *[source->capacity];
+        capacity = source->capacity;
+    }
+    for(int64_t ii=0; ii<source->count; ++ii)
+    {
+        entries[ii] = new KeyData(source->entries[ii]);
+    }
+    count = source->count;
+
+    //The entries are in the same order so the slots can be copied as they are.
+    if ( source->slots != nullptr )
+    {
+        slots = new int32_t[source->slotMask + 1];
+        memcpy(slots, source->slots, (source->slotMask + 1) * sizeof(int32_t));
+        slotMask = source->slotMask;
+    }
+}
+
+CollectionTable::~CollectionTable()
+{
+    for(int64_t ii=0; ii<count; ++ii)
+    {
+        delete entries[ii];
+    }
+    if ( entries != inlineEntries )
+    {
+        delete []entries;
+    }
+    delete []slots;
+}
+
+KeyData *CollectionTable::Find(U8String *key, uint32_t hash)
+{
+    if ( indexed < count )
+    {
+        //Other threads can be reading a shared table so it is searched without indexing it.
+        if ( references.load() > 1 )
+        {
+            for(int64_t ii=0; ii<count; ++ii)
+            {
+                if ( entries[ii]->Hash() == hash && entries[ii]->Key()->IsEqual(key) )
+                {
+                    return entries[ii];
+                }
+            }
+            return nullptr;
+        }
+        if ( !IndexAppended() )
+        {
+            return nullptr;
+        }
+    }
+
+    if ( slots == nullptr )
+    {
+        for(int64_t ii=0; ii<count; ++ii)
+        {
+            if ( entries[ii]->Hash() == hash && entries[ii]->Key()->IsEqual(key) )
+            {
+                return entries[ii];
+            }
+        }
+        return nullptr;
+    }
+
+    for(int64_t slot = hash & slotMask; slots[slot] != 0; slot = (slot + 1) & slotMask)
+    {
+        KeyData *keyData = entries[slots[slot] - 1];
+        if ( keyData->Hash() == hash && keyData->Key()->IsEqual(key) )
+        {
+            return keyData;
+        }
+    }
+    return nullptr;
+}
+
+KeyData *CollectionTable::Find(Symbol *symbol)
+{
+    if ( indexed < count )
+    {
+        if ( references.load() > 1 )
+        {
+            for(int64_t ii=0; ii<count; ++ii)
+            {
+                if ( entries[ii]->KeySymbol() == symbol )
+                {
+                    return entries[ii];
+                }
+            }
+            return nullptr;
+        }
+        if ( !IndexAppended() )
+        {
+            return nullptr;
+        }
+    }
+
+    if ( slots == nullptr )
+    {
+        for(int64_t ii=0; ii<count; ++ii)
+        {
+            if ( entries[ii]->KeySymbol() == symbol )
+            {
+                return entries[ii];
+            }
+        }
+        return nullptr;
+    }
+
+    for(int64_t slot = symbol->hash & slotMask; slots[slot] != 0; slot = (slot + 1) & slotMask)
+    {
+        KeyData *keyData = entries[slots[slot] - 1];
+        if ( keyData->KeySymbol() == symbol )
+        {
+            return keyData;
+        }
+    }
+    return nullptr;
+}
+
+bool CollectionTable::Add(KeyData *keyData)
+{
+    if ( !Push(keyData) )
+    {
+        return false;
+    }
+    ++indexed;
+
+    if ( slots != nullptr )
+    {
+        if ( count * 4 > (slotMask + 1) * 3 )
+        {
+            return Rehash((slotMask + 1) * 2);
+        }
+        Place(count - 1);
+    }
+    else if ( count > COLLECTION_INLINE_KEYS )
+    {
+        return Rehash(COLLECTION_MIN_SLOTS);
+    }
+
+    return true;
+}
+
+bool CollectionTable::Append(KeyData *keyData)
+{
+    return Push(keyData);
+}
+
+bool CollectionTable::Push(KeyData *keyData)
+{
+    if ( count == capacity )
+    {
+        auto *grown = new KeyData *[capacity * 2];
+        memcpy(grown, entries, count * sizeof(KeyData *));
+        if ( entries != inlineEntries )
+        {
+            delete []entries;
+        }
+        entries = grown;
+        capacity *= 2;
+    }
+
+    keyData->KeyIndex(count);
+    entries[count++] = keyData;
+
+    return true;
+}
+
+bool CollectionTable::IndexAppended()
+{
+    if ( count <= COLLECTION_INLINE_KEYS && slots == nullptr )
+    {
+        indexed = count;
+        return true;
+    }
+
+    int64_t slotCount = slots == nullptr ? COLLECTION_MIN_SLOTS : slotMask + 1;
+    while( count * 4 > slotCount * 3 )
+    {
+        slotCount *= 2;
+    }
+    indexed = count;
+
+    return Rehash(slotCount);
+}
+
+void CollectionTable::Remove(int64_t index)
+{
+    delete entries[index];
+    for(int64_t ii=index+1; ii<count; ++ii)
+    {
+        entries[ii-1] = entries[ii];
+        entries[ii-1]->KeyIndex(ii-1);
+    }
+    --count;
+    --indexed;
+
+    if ( slots != nullptr )
+    {
+        Rehash(slotMask + 1);
+    }
+}
+
+int64_t CollectionTable::Bytes()
+{
+    int64_t bytes = sizeof(CollectionTable) + count * (int64_t)sizeof(KeyData);
+    if ( entries != inlineEntries )
+    {
+        bytes += capacity * (int64_t)sizeof(KeyData *);
+    }
+    if ( slots != nullptr )
+    {
+        bytes += (slotMask + 1) * (int64_t)sizeof(int32_t);
+    }
+    return bytes;
+}
+
+bool CollectionTable::Rehash(int64_t slotCount)
+{
+    auto *grown = new int32_t[slotCount];
+    memset(grown, 0, slotCount * sizeof(int32_t));
+    delete []slots;
+    slots = grown;
+    slotMask = slotCount - 1;
+
+    for(int64_t ii=0; ii<count; ++ii)
+    {
+        Place(ii);
+    }
+
+    return true;
+}
+
+void CollectionTable::Place(int64_t index)
+{
+    int64_t slot = entries[index]->Hash() & slotMask;
+    while( slots[slot] != 0 )
+    {
+        slot = (slot + 1) & slotMask;
+    }
+    slots[slot] = (int32_t)(index + 1);
+}
 
 List<KeyData *> Collection::GetKeyData()
 {
     List<KeyData *> keyData = {};
 
-    for(int ii=0; ii<keys.Count(); ++ii)
+    for(int ii=0; ii<Count(); ++ii)
     {
-        keyData.push_back(Get(keys[ii]));
+        keyData.push_back(Entry(ii));
     }
 
     return keyData;
 }
+
+bool Collection::Detach()
+{
+    if ( table == nullptr )
+    {
+        table = new CollectionTable();
+        return true;
+    }
+    if ( !IsShared() )
+    {
+        return true;
+    }
+
+    auto *copy = new CollectionTable(table);
+    for(int64_t ii=0; ii<copy->count; ++ii)
+    {
+        auto *element = (DslValue *)copy->entries[ii]->Data();
+        if ( element != nullptr )
+        {
+            copy->entries[ii]->Data(new DslValue(element));
+        }
+    }
+
+    Clear();
+    table = copy;
+    return true;
+}
@@ -0,0 +1,102 @@
+#include "../Includes/ComponentGraph.h"
+
+ComponentGraph::ComponentGraph(int64_t workers)
+{
+    image = nullptr;
+    scheduler = new ComponentScheduler(workers);
+}
+
+ComponentGraph::~ComponentGraph()
+{
+    Clear();
+    delete scheduler;
+}
+
+void ComponentGraph::Clear()
+{
+    scheduler->Clear();
+    for(int64_t ii=0; ii<nodes.Count(); ++ii)
+    {
+        delete nodes[ii];
+    }
+    nodes.Clear();
+    image = nullptr;
+}
+
+bool ComponentGraph::Init(CodeImage *codeImage)
+{
+    Clear();
+    image = codeImage;
+
+    //One node per component, the job of each node has the same index as the node. The
+    //program is not run, the slots are wired from the component data in the image.
+    for(int64_t ii=0; ii<image->comInstAddr.Count(); ++ii)
+    {
+        auto *cpu = new CPU();
+        nodes.push_back(cpu);
+
+        ComponentData *component = image->instructions[image->comInstAddr[ii]]->component;
+        if ( !cpu->Init(image) || scheduler->Add(cpu, &component->function) != ii )
+        {
+            return false;
+        }
+    }
+
+    for(int64_t ii=0; ii<nodes.Count(); ++ii)
+    {
+        ComponentData *component = image->instructions[image->comInstAddr[ii]]->component;
+        for(int64_t tt=0; tt<component->slots.Count(); ++tt)
+        {
+            SlotData *slot = component->slots[tt];
+            if ( !slot->IsInput )
+            {
+                continue;
+            }
+
+            int64_t from = -1;
+            if ( !FindOutput(&slot->variable, from) )
+            {
+                return false;
+            }
+            if ( from == -1 || from == ii )
+            {
+                continue;
+            }
+
+            //Variables that are never used by the program's code are not created by the CPU,
+            //the components still run in the order of the connection.
+            DslValue *output = nodes[from]->FindVariable(slot->variable.cStr());
+            DslValue *input = nodes[ii]->FindVariable(slot->variable.cStr());
+            if ( !scheduler->Connect(from, ii, output, input) )
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool ComponentGraph::FindOutput(U8String *variable, int64_t &component)
+{
+    component = -1;
+
+    for(int64_t ii=0; ii<image->comInstAddr.Count(); ++ii)
+    {
+        ComponentData *componentData = image->instructions[image->comInstAddr[ii]]->component;
+        for(int64_t tt=0; tt<componentData->slots.Count(); ++tt)
+        {
+            SlotData *slot = componentData->slots[tt];
+            if ( !slot->IsInput && slot->variable.IsEqual(variable) )
+            {
+                if ( component != -1 && component != ii )
+                {
+                    return false;
+                }
+                component = ii;
+            }
+        }
+    }
+
+    return true;
+}
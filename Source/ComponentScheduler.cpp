@@ -0,0 +1,344 @@
+#include <chrono>
+#include "../Includes/ComponentScheduler.h"
+
+ComponentScheduler::ComponentScheduler(int64_t workers)
+{
+    frameNanoseconds = 0;
+    steals = 0;
+    frames = 0;
+    frame = 0;
+    stopping = false;
+    running = 0;
+    stolen = 0;
+    remaining = 0;
+    work = 0;
+
+    if ( workers <= 0 )
+    {
+        workers = std::thread::hardware_concurrency();
+        if ( workers <= 0 )
+        {
+            workers = 1;
+        }
+    }
+
+    for(int64_t ii=0; ii<workers; ++ii)
+    {
+        queues.push_back(new WorkerQueue());
+    }
+
+    for(int64_t ii=0; ii<workers; ++ii)
+    {
+        threads.push_back(new std::thread(&ComponentScheduler::Worker, this, ii));
+    }
+}
+
+ComponentScheduler::~ComponentScheduler()
+{
+    {
+        std::lock_guard<std::mutex> guard(frameLock);
+        stopping = true;
+    }
+    frameStart.notify_all();
+
+    for(int64_t ii=0; ii<threads.Count(); ++ii)
+    {
+        threads[ii]->join();
+        delete threads[ii];
+    }
+
+    for(int64_t ii=0; ii<queues.Count(); ++ii)
+    {
+        delete queues[ii];
+    }
+
+    Clear();
+}
+
+int64_t ComponentScheduler::Add(CPU *cpu, U8String *function)
+{
+    int64_t component = cpu->FindComponent(function);
+    if ( component < 0 )
+    {
+        return -1;
+    }
+
+    ComponentJob job = {};
+    job.cpu = cpu;
+    job.component = component;
+    job.ran = false;
+    job.nanoseconds = 0;
+    job.worker = -1;
+    jobs.push_back(job);
+
+    auto found = cpuTasks.find(cpu);
+    if ( found == cpuTasks.end() )
+    {
+        auto *task = new ComponentTask();
+        task->cpu = cpu;
+        task->waitsFor = 0;
+        task->pending = 0;
+        found = cpuTasks.emplace(cpu, tasks.Count()).first;
+        tasks.push_back(task);
+    }
+    tasks[found->second]->jobs.push_back(jobs.Count() - 1);
+    jobTasks.push_back(found->second);
+
+    return jobs.Count() - 1;
+}
+
+bool ComponentScheduler::Connect(int64_t from, int64_t to, DslValue *output, DslValue *input)
+{
+    if ( from < 0 || from >= jobs.Count() || to < 0 || to >= jobs.Count() || from == to )
+    {
+        return false;
+    }
+
+    int64_t fromTask = jobTasks[from];
+    int64_t toTask = jobTasks[to];
+
+    if ( fromTask == toTask )
+    {
+        //Jobs on the same CPU run in the order they were added.
+        if ( from > to )
+        {
+            return false;
+        }
+    }
+    else
+    {
+        if ( Reaches(toTask, fromTask) )
+        {
+            return false;
+        }
+
+        bool connected = false;
+        List<int64_t> *next = &tasks[fromTask]->next;
+        for(int64_t ii=0; ii<next->Count() && !connected; ++ii)
+        {
+            connected = (*next)[ii] == toTask;
+        }
+        if ( !connected )
+        {
+            next->push_back(toTask);
+            ++tasks[toTask]->waitsFor;
+        }
+    }
+
+    if ( output != nullptr && input != nullptr )
+    {
+        SlotLink link = {};
+        link.job = to;
+        link.output = output;
+        link.input = input;
+        tasks[toTask]->links.push_back(link);
+    }
+
+    return true;
+}
+
+bool ComponentScheduler::Reaches(int64_t first, int64_t last)
+{
+    List<int64_t> work;
+    auto *visited = new bool[tasks.Count()];
+    for(int64_t ii=0; ii<tasks.Count(); ++ii)
+    {
+        visited[ii] = false;
+    }
+
+    bool found = false;
+    work.push_back(first);
+    while( work.Count() > 0 && !found )
+    {
+        int64_t task = work.pop_back();
+        if ( task == last )
+        {
+            found = true;
+        }
+        else if ( !visited[task] )
+        {
+            visited[task] = true;
+            for(int64_t ii=0; ii<tasks[task]->next.Count(); ++ii)
+            {
+                work.push_back(tasks[task]->next[ii]);
+            }
+        }
+    }
+
+    delete []visited;
+    return found;
+}
+
+void ComponentScheduler::Clear()
+{
+    for(int64_t ii=0; ii<tasks.Count(); ++ii)
+    {
+        delete tasks[ii];
+    }
+    tasks.Clear();
+    cpuTasks.clear();
+    jobs.Clear();
+    jobTasks.Clear();
+}
+
+void ComponentScheduler::RunFrame()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    //Tasks that wait for nothing are dealt out in turn, stealing evens out the frame when their
+    //run times differ. The others are queued as they become ready.
+    remaining = tasks.Count();
+    int64_t ready = 0;
+    for(int64_t ii=0; ii<tasks.Count(); ++ii)
+    {
+        tasks[ii]->pending = tasks[ii]->waitsFor;
+        if ( tasks[ii]->waitsFor == 0 )
+        {
+            queues[ready++ % queues.Count()]->Push(ii);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(frameLock);
+        running = queues.Count();
+        stolen = 0;
+        ++frame;
+    }
+    frameStart.notify_all();
+
+    {
+        std::unique_lock<std::mutex> guard(frameLock);
+        frameDone.wait(guard, [this]() { return running == 0; });
+        steals = stolen;
+    }
+
+    ++frames;
+    frameNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - start).count();
+}
+
+void ComponentScheduler::Worker(int64_t worker)
+{
+    int64_t lastFrame = 0;
+
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> guard(frameLock);
+            frameStart.wait(guard, [&]() { return stopping || frame != lastFrame; });
+            if ( stopping )
+            {
+                return;
+            }
+            lastFrame = frame;
+        }
+
+        //Tasks waiting for other tasks are queued while the frame runs so the frame is only
+        //done once every task has finished. A worker with nothing to run sleeps until a task
+        //is queued or the last task finishes.
+        int64_t task;
+        int64_t taken = 0;
+        while( remaining > 0 )
+        {
+            int64_t seen;
+            {
+                std::lock_guard<std::mutex> guard(workLock);
+                seen = work;
+            }
+            if ( !queues[worker]->Pop(task) )
+            {
+                if ( !Steal(worker, task) )
+                {
+                    std::unique_lock<std::mutex> guard(workLock);
+                    workReady.wait(guard, [&]() { return work != seen || remaining == 0; });
+                    continue;
+                }
+                ++taken;
+            }
+            RunTask(worker, task);
+        }
+
+        std::lock_guard<std::mutex> guard(frameLock);
+        stolen += taken;
+        if ( --running == 0 )
+        {
+            frameDone.notify_one();
+        }
+    }
+}
+
+bool ComponentScheduler::Steal(int64_t worker, int64_t &task)
+{
+    for(int64_t ii=1; ii<queues.Count(); ++ii)
+    {
+        if ( queues[(worker + ii) % queues.Count()]->Steal(task) )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ComponentScheduler::RunTask(int64_t worker, int64_t task)
+{
+    ComponentTask *componentTask = tasks[task];
+
+    for(int64_t ii=0; ii<componentTask->jobs.Count(); ++ii)
+    {
+        int64_t jobIndex = componentTask->jobs[ii];
+        for(int64_t tt=0; tt<componentTask->links.Count(); ++tt)
+        {
+            SlotLink *link = &componentTask->links[tt];
+            if ( link->job == jobIndex )
+            {
+                link->input->SAV(link->output);
+            }
+        }
+
+        ComponentJob *job = &jobs[jobIndex];
+        auto start = std::chrono::steady_clock::now();
+        job->ran = componentTask->cpu->RunComponent(job->component);
+        job->nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start).count();
+        job->worker = worker;
+    }
+
+    int64_t queued = 0;
+    for(int64_t ii=0; ii<componentTask->next.Count(); ++ii)
+    {
+        ComponentTask *next = tasks[componentTask->next[ii]];
+        if ( --next->pending == 0 )
+        {
+            queues[worker]->Push(componentTask->next[ii]);
+            ++queued;
+        }
+    }
+
+    if ( --remaining == 0 )
+    {
+        WakeWorkers(0);
+    }
+    else if ( queued > 0 )
+    {
+        WakeWorkers(queued);
+    }
+}
+
+void ComponentScheduler::WakeWorkers(int64_t tasksQueued)
+{
+    {
+        std::lock_guard<std::mutex> guard(workLock);
+        ++work;
+    }
+
+    if ( tasksQueued == 0 )
+    {
+        workReady.notify_all();
+        return;
+    }
+    for(int64_t ii=0; ii<tasksQueued; ++ii)
+    {
+        workReady.notify_one();
+    }
+}
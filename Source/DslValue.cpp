@@ -4,6 +4,7 @@
 
 #include "../Includes/DslValue.h"
 #include "../Includes/ParseData.h"
+#include "../Includes/NumericArray.h"
 #include <cmath>
 
 DslValue::DslValue()
@@ -124,7 +125,8 @@ DslValue::DslValue(U8String *u8String)
 /// \desc Copies the right collection to this one.
 /// \param right The copped to be copied to this one.
 /// \remark The address is not updated by this call as this variable is
-///         a different instance than the right one.
+///         a different instance than the right one. The elements are shared
+///         with the right collection until either one is changed.
 void DslValue::CopyCollection(DslValue *right)
 {
     if ( right->type != COLLECTION )
@@ -140,20 +142,9 @@ void DslValue::CopyCollection(DslValue *right)
     bValue = right->bValue;
     elementAddress = right->elementAddress;
     jsonKey.CopyFrom(&right->jsonKey);
-    indexes.Clear();
+    indexes.CopyFrom(&right->indexes);
     moduleId = right->moduleId;
     cases.CopyFrom(&right->cases);
-
-    List<KeyData *> list;
-    DslValue::GetKeyData(right, &list);
-    for(int ii=0; ii<list.Count(); ++ii)
-    {
-        auto *tmpKey = (U8String *)list.get(ii)->Key();
-        auto *tmpData = (DslValue *)list.get(ii)->Data();
-        auto *value = new DslValue();
-        value->CopyCollection(tmpData);
-        indexes.Set(new U8String(tmpKey), value);
-    }
 }
 
 void DslValue::ToInteger()
@@ -162,6 +153,7 @@ void DslValue::ToInteger()
     {
         case COLLECTION:
         {
+            indexes.Detach();
             List<KeyData *> keyData = indexes.GetKeyData();
             for (int ii = 0; ii < keyData.Count(); ++ii)
             {
@@ -194,6 +186,7 @@ void DslValue::ToDouble()
     {
         case COLLECTION:
         {
+            indexes.Detach();
             List<KeyData *> keyData = indexes.GetKeyData();
             for (int ii = 0; ii < keyData.Count(); ++ii)
             {
@@ -226,6 +219,7 @@ void DslValue::ToChar()
     {
         case COLLECTION:
         {
+            indexes.Detach();
             List<KeyData *> keyData = indexes.GetKeyData();
             for (int ii = 0; ii < keyData.Count(); ++ii)
             {
@@ -258,6 +252,7 @@ void DslValue::ToString()
     {
         case COLLECTION:
         {
+            indexes.Detach();
             List<KeyData *> keyData = indexes.GetKeyData();
             for (int ii = 0; ii < keyData.Count(); ++ii)
             {
@@ -290,6 +285,7 @@ void DslValue::ToBool()
     {
         case COLLECTION:
         {
+            indexes.Detach();
             List<KeyData *> keyData = indexes.GetKeyData();
             for (int ii = 0; ii < keyData.Count(); ++ii)
             {
@@ -326,6 +322,7 @@ void DslValue::Convert(TokenTypes valueType)
     {
         case COLLECTION:
         {
+            indexes.Detach();
             List<KeyData *> keyData = indexes.GetKeyData();
             for (int ii = 0; ii < keyData.Count(); ++ii)
             {
@@ -356,17 +353,23 @@ void DslValue::BinaryOperation(OPCODES op, DslValue *right)
 {
     if ( type == COLLECTION )
     {
+        indexes.Detach();
+        int64_t changed = NumericArray::Operation(this, op, right);
         if ( right->type != COLLECTION )
         {
-            List<KeyData *> keyData = indexes.GetKeyData();
-            for (int ii = 0; ii < keyData.Count(); ++ii)
+            //Elements after the ones the vector loops changed are changed one at a time.
+            for (int64_t ii = changed; ii < indexes.Count(); ++ii)
             {
-                ((DslValue *) keyData[ii]->Data())->BinaryOperation(op, right);
+                ((DslValue *) indexes.Entry(ii)->Data())->BinaryOperation(op, right);
             }
             return;
         }
         else
         {
+            if ( changed > 0 )
+            {
+                return;
+            }
             List<KeyData *> keyDataLeft = indexes.GetKeyData();
             List<KeyData *> keyDataRight = right->indexes.GetKeyData();
             if ( keyDataLeft.Count() != keyDataRight.Count() )
@@ -750,6 +753,7 @@ void DslValue::INC()
     {
         case COLLECTION:
         {
+            indexes.Detach();
             List<KeyData *> keyData = indexes.GetKeyData();
             for (int ii = 0; ii < keyData.Count(); ++ii)
             {
@@ -778,6 +782,7 @@ void DslValue::DEC()
     {
         case COLLECTION:
         {
+            indexes.Detach();
             List<KeyData *> keyData = indexes.GetKeyData();
             for (int ii = 0; ii < keyData.Count(); ++ii)
             {
@@ -806,6 +811,7 @@ void DslValue::NOT()
     {
         case COLLECTION:
         {
+            indexes.Detach();
             List<KeyData *> keyData = indexes.GetKeyData();
             for (int ii = 0; ii < keyData.Count(); ++ii)
             {
@@ -834,6 +840,7 @@ void DslValue::NEG()
     {
         case COLLECTION:
         {
+            indexes.Detach();
             List<KeyData *> keyData = indexes.GetKeyData();
             for (int ii = 0; ii < keyData.Count(); ++ii)
             {
@@ -1352,9 +1359,9 @@ void DslValue::GetKeyData(DslValue *dslValue, List<KeyData *> *keyData)
     {
         return;
     }
-    for(int ii=0; ii<dslValue->indexes.keys.Count(); ++ii)
+    for(int ii=0; ii<dslValue->indexes.Count(); ++ii)
     {
-        keyData->push_back(dslValue->indexes.Get(dslValue->indexes.keys[ii]));
+        keyData->push_back(dslValue->indexes.Entry(ii));
     }
 }
 
@@ -1362,7 +1369,7 @@ void DslValue::FormatJsonCharacter(u8chr ch, U8String *out)
 {
     if ( ch == '\"' || ch == '\\' || ch == '/' )
     {
-        out->Append('\\');
+        out->push_back('\\');
         out->push_back(ch);
     }
     else if ( ch == '\b' || ch == '\f' || ch == '\n' || ch == '\r' || ch == '\t' )
@@ -1395,34 +1402,49 @@ void DslValue::FormatJsonCharacter(u8chr ch, U8String *out)
 
 void DslValue::FormatJsonString(U8String *out, U8String *in)
 {
-    out->Append("\"");
+    out->push_back('\"');
+
+    if ( !in->IsAscii() )
+    {
+        for(int ii=0; ii<in->Count(); ++ii)
+        {
+            FormatJsonCharacter(in->get(ii), out);
+        }
+        out->push_back('\"');
+        return;
+    }
 
-    for(int ii=0; ii<in->Count(); ++ii)
+    //Runs of characters that are not escaped are appended together.
+    const char *text = in->cStr();
+    int64_t start = 0;
+    for(int64_t ii=0; ii<in->Length(); ++ii)
     {
-        u8chr ch = in->get(ii);
-        FormatJsonCharacter(ch, out);
+        char ch = text[ii];
+        if ( ch >= ' ' && ch <= 126 && ch != '\"' && ch != '\\' && ch != '/' )
+        {
+            continue;
+        }
+        out->Append(text + start, ii - start);
+        FormatJsonCharacter((u8chr)ch, out);
+        start = ii + 1;
     }
+    out->Append(text + start, in->Length() - start);
 
     out->push_back('\"');
 }
 
 void DslValue::JsonAppendItemText(U8String *buffer)
 {
-    U8String tmp;
-
     switch( type )
     {
         default:
-            tmp.printf(false, (char *)"\n");
-            buffer->Append(&tmp);
+            buffer->push_back('\n');
             return;
         case INTEGER_VALUE:
-            tmp.printf(false, (char *)"%ld", iValue);
-            buffer->Append(&tmp);
+            buffer->printf(true, (char *)"%ld", iValue);
             break;
         case DOUBLE_VALUE:
-            tmp.printf(false, (char *)"%f", dValue);
-            buffer->Append(&tmp);
+            buffer->printf(true, (char *)"%f", dValue);
             break;
         case CHAR_VALUE:
             FormatJsonCharacter(cValue, buffer);
@@ -1431,24 +1453,13 @@ void DslValue::JsonAppendItemText(U8String *buffer)
             FormatJsonString(buffer, &sValue);
             break;
         case BOOL_VALUE:
-            if ( bValue )
-            {
-                tmp.CopyFromCString("true");
-                buffer->Append(&tmp);
-            }
-            else
-            {
-                tmp.CopyFromCString("false");
-                buffer->Append(&tmp);
-            }
+            buffer->Append(bValue ? "true" : "false");
             break;
     }
 }
 
 void DslValue::JsonAppendKeyName(U8String *key, U8String *buffer)
 {
-    U8String tmp;
-
     if ( key->Count() >= 13 )
     {
         const char *ptr = key->cStr();
@@ -1467,13 +1478,11 @@ void DslValue::JsonAppendKeyName(U8String *key, U8String *buffer)
                 ptr += 13;
                 break;
         }
-        tmp.printf(false, (char *)"\"%s\":", ptr);
-        buffer->Append(&tmp);
+        buffer->printf(true, (char *)"\"%s\":", ptr);
         return;
     }
 
-    tmp.printf(false, (char *)"\"%s\":", key->cStr());
-    buffer->Append(&tmp);
+    buffer->printf(true, (char *)"\"%s\":", key->cStr());
 }
 
 /// \desc Appends the dsl value to the end of the buffer as json formatted text.
@@ -1483,8 +1492,7 @@ bool DslValue::AppendAsJsonText(U8String *buffer)
 
     if ( type == COLLECTION )
     {
-        tmp.printf(false, (char *)"{ ");
-        buffer->Append(&tmp);
+        buffer->Append("{ ");
         List<KeyData *> list;
         DslValue::GetKeyData(this, &list);
         for(int ii=0; ii<list.Count(); ++ii)
@@ -1502,12 +1510,10 @@ bool DslValue::AppendAsJsonText(U8String *buffer)
             }
             if ( ii + 1 < list.Count() )
             {
-                tmp.printf(false, (char *)", ");
-                buffer->Append(&tmp);
+                buffer->Append(", ");
             }
         }
-        tmp.printf(false, (char *)" }");
-        buffer->Append(&tmp);
+        buffer->Append(" }");
     }
     else
     {
@@ -7,11 +7,12 @@
 #include "../Includes/ParseData.h"
 #include "../Includes/CPU.h"
 
-static char szLastErrorMessage[8192] = {'\0'};
-static char szErrorMessage[8192] = {'\0'};
-static char szMsgBuffer[8192] = {'\0'};
+//Thread local so CPUs running on different threads can raise run time errors at the same time.
+static thread_local char szLastErrorMessage[8192] = {'\0'};
+static thread_local char szErrorMessage[8192] = {'\0'};
+static thread_local char szMsgBuffer[8192] = {'\0'};
 
-List<U8String *> printedIssues;
+thread_local List<U8String *> printedIssues;
 
 /// \desc Prints an issue to the std out.
 void PrintIssue(int64_t number, bool error, bool fatalError, const char *format, ...)
@@ -38,6 +39,15 @@ void PrintPassedIssue(int64_t number, bool error, bool fatalError, const char *f
 ///       updating the error count and setting fatal if a fatal error.
 void PrintError(int64_t number, const char *msg, bool error, bool fatalError)
 {
+    //if a run time error no line and column, the error belongs to the CPU running on this
+    //thread so none of the compiler's error state is changed.
+    if ( number >= 4000 && number <= 5000)
+    {
+        sprintf(szErrorMessage, "Run Error(%ld): %s\n", (long)number, msg);
+        CPU::RaiseError(number, szErrorMessage);
+        return;
+    }
+
     fatal = fatalError;
 
     if (!error && warningLevel == WarningLevel0 )
@@ -59,23 +69,14 @@ void PrintError(int64_t number, const char *msg, bool error, bool fatalError)
     }
     printedIssues.push_back(new U8String(msg));
 
-    //if a run time error no line and column
-    if ( number >= 4000 && number <= 5000)
-    {
-        sprintf(szErrorMessage, "Run Error(%ld): %s\n", (long)number, msg);
-        CPU::RaiseError(number, szErrorMessage);
-    }
-    else
-    {
-        sprintf(szErrorMessage,
-                "%s(%ld): %s at line %ld, column %ld\n", ((error) ? "Error" : "Warning"),
-                (long)number, msg, (long)locationInfo.line, (long)locationInfo.column);
+    sprintf(szErrorMessage,
+            "%s(%ld): %s at line %ld, column %ld\n", ((error) ? "Error" : "Warning"),
+            (long)number, msg, (long)locationInfo.line, (long)locationInfo.column);
 
-        if ( strcmp(szErrorMessage, szLastErrorMessage) != 0 )
-        {
-            strcpy(szLastErrorMessage, szErrorMessage);
-            printf("%s", szErrorMessage);
-        }
+    if ( strcmp(szErrorMessage, szLastErrorMessage) != 0 )
+    {
+        strcpy(szLastErrorMessage, szErrorMessage);
+        printf("%s", szErrorMessage);
     }
 
     if ( error )
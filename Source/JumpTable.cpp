@@ -0,0 +1,209 @@
+#include "../Includes/JumpTable.h"
+
+JumpTable::JumpTable(DslValue *jumpTable)
+{
+    kind = LINEAR_JUMP_TABLE;
+    keyType = INVALID_TOKEN;
+    defaultLocation = jumpTable->location;
+    minimum = 0;
+    size = 0;
+    locations = nullptr;
+    entries = nullptr;
+
+    int64_t count = 0;
+    int64_t maximum = 0;
+
+    for(int64_t ii=0; ii<jumpTable->cases.Count(); ++ii)
+    {
+        DslValue *caseValue = jumpTable->cases[ii];
+        if ( caseValue->type == DEFAULT )
+        {
+            defaultLocation = caseValue->location;
+            continue;
+        }
+
+        if ( count == 0 )
+        {
+            keyType = caseValue->type;
+        }
+        else if ( caseValue->type != keyType )
+        {
+            keyType = INVALID_TOKEN;
+        }
+
+        if ( caseValue->type == INTEGER_VALUE || caseValue->type == CHAR_VALUE )
+        {
+            int64_t key = caseValue->type == INTEGER_VALUE ? caseValue->iValue : (int64_t)caseValue->cValue;
+            if ( count == 0 || key < minimum )
+            {
+                minimum = key;
+            }
+            if ( count == 0 || key > maximum )
+            {
+                maximum = key;
+            }
+        }
+        ++count;
+    }
+
+    switch( keyType )
+    {
+        default:
+            keyType = INVALID_TOKEN;
+            return;
+        case INTEGER_VALUE: case CHAR_VALUE:
+            if ( (uint64_t)maximum - (uint64_t)minimum < (uint64_t)(count * DENSE_JUMP_TABLE_SPREAD) )
+            {
+                kind = DENSE_JUMP_TABLE;
+                size = maximum - minimum + 1;
+                locations = new int64_t[size];
+                for(int64_t ii=0; ii<size; ++ii)
+                {
+                    locations[ii] = -1;
+                }
+                for(int64_t ii=0; ii<jumpTable->cases.Count(); ++ii)
+                {
+                    DslValue *caseValue = jumpTable->cases[ii];
+                    if ( caseValue->type == DEFAULT )
+                    {
+                        continue;
+                    }
+                    int64_t key = keyType == INTEGER_VALUE ? caseValue->iValue : (int64_t)caseValue->cValue;
+                    if ( locations[key - minimum] == -1 )
+                    {
+                        locations[key - minimum] = caseValue->location;
+                    }
+                }
+                return;
+            }
+            //Too sparse for a dense table, use a hash table.
+        case STRING_VALUE:
+            break;
+    }
+
+    kind = HASH_JUMP_TABLE;
+    size = 8;
+    while( size < count * 2 )
+    {
+        size <<= 1;
+    }
+    entries = new JumpTableEntry[size];
+    for(int64_t ii=0; ii<size; ++ii)
+    {
+        entries[ii].location = -1;
+    }
+    for(int64_t ii=0; ii<jumpTable->cases.Count(); ++ii)
+    {
+        if ( jumpTable->cases[ii]->type != DEFAULT )
+        {
+            Insert(jumpTable->cases[ii]);
+        }
+    }
+}
+
+void JumpTable::Insert(DslValue *caseValue)
+{
+    int64_t key = 0;
+    U8String *string = nullptr;
+    uint32_t hash;
+
+    switch( keyType )
+    {
+        default:
+        case INTEGER_VALUE:
+            key = caseValue->iValue;
+            hash = HashKey(key);
+            break;
+        case CHAR_VALUE:
+            key = (int64_t)caseValue->cValue;
+            hash = HashKey(key);
+            break;
+        case STRING_VALUE:
+            string = &caseValue->sValue;
+            hash = HashString(string);
+            break;
+    }
+
+    int64_t mask = size - 1;
+    for(int64_t ii=hash & mask; ; ii = (ii + 1) & mask)
+    {
+        JumpTableEntry *entry = &entries[ii];
+        if ( entry->location == -1 )
+        {
+            entry->hash = hash;
+            entry->key = key;
+            entry->string = string;
+            entry->location = caseValue->location;
+            return;
+        }
+        if ( entry->hash == hash && (string == nullptr ? entry->key == key : entry->string->IsEqual(string)) )
+        {
+            return;
+        }
+    }
+}
+
+bool JumpTable::Find(Value *value, int64_t &location)
+{
+    if ( value->type != keyType )
+    {
+        return false;
+    }
+
+    int64_t key = 0;
+    U8String *string = nullptr;
+    uint32_t hash;
+
+    switch( keyType )
+    {
+        default:
+        case INTEGER_VALUE:
+            key = value->iValue;
+            break;
+        case CHAR_VALUE:
+            key = (int64_t)value->cValue;
+            break;
+        case STRING_VALUE:
+            string = &value->object->sValue;
+            break;
+    }
+
+    if ( kind == DENSE_JUMP_TABLE )
+    {
+        auto index = (uint64_t)key - (uint64_t)minimum;
+        location = index < (uint64_t)size && locations[index] != -1 ? locations[index] : defaultLocation;
+        return true;
+    }
+
+    hash = string == nullptr ? HashKey(key) : HashString(string);
+    int64_t mask = size - 1;
+    for(int64_t ii=hash & mask; ; ii = (ii + 1) & mask)
+    {
+        JumpTableEntry *entry = &entries[ii];
+        if ( entry->location == -1 )
+        {
+            location = defaultLocation;
+            return true;
+        }
+        if ( entry->hash == hash && (string == nullptr ? entry->key == key : entry->string->IsEqual(string)) )
+        {
+            location = entry->location;
+            return true;
+        }
+    }
+}
+
+uint32_t JumpTable::HashKey(int64_t key)
+{
+    auto hash = (uint64_t)key;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+
+    return (uint32_t)hash;
+}
+
+uint32_t JumpTable::HashString(U8String *string)
+{
+    return string->Hash();
+}
@@ -13,6 +13,7 @@ KeyWord *keyWords[] =
     new KeyWord( "continue", CONTINUE),
     new KeyWord( "(double)", CAST_TO_DBL),
     new KeyWord( "(string)", CAST_TO_STR),
+    new KeyWord( "foreach", FOREACH),
     new KeyWord( "default", DEFAULT),
     new KeyWord( "global", GLOBAL),
     new KeyWord( "script", SCRIPT),
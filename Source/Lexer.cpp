@@ -1083,7 +1083,7 @@ bool Lexer::DefineFunction(Token *token)
                         definingFunction = false;
                         return false;
                     }
-                    modules[m_id-1]->systemEvents[ii].CopyFrom(new U8String(funBegin->identifier));
+                    modules[m_id-1]->systemEvents[ii].CopyFrom(funBegin->identifier);
                     systemEvent = true;
                     break;
                 }
@@ -1092,7 +1092,7 @@ bool Lexer::DefineFunction(Token *token)
             {
                 for(int64_t ii=0; ii<modules[m_id-1]->userEvents.Count(); ++ii)
                 {
-                    if ( modules[m_id-1]->userEvents[0].IsEqual(funBegin->identifier))
+                    if ( modules[m_id-1]->userEvents[ii].IsEqual(funBegin->identifier))
                     {
                         PrintIssue(2190, true, false,
                                    "Event function %s for module %s already exists.",
@@ -1686,7 +1686,7 @@ void Lexer::AddEmptyCollectionElement(Token *token, U8String *key, int64_t &inde
     key->push_back(&token->value->variableScriptName);
     key->push_back('.');
     key->Append(index++);
-    token->value->indexes.Set(new U8String(key), new DslValue());
+    token->value->indexes.Set(key, new DslValue());
 }
 
 /// \desc Creates a key for an element that does not have a specified key.
@@ -1760,7 +1760,7 @@ TokenTypes Lexer::GetKey(Token *token, U8String *key, int64_t &index)
                 U8String tmp = {};
                 if ( tmpValue->iValue < token->value->indexes.Count() )
                 {
-                    key->CopyFrom(token->value->indexes.keys[tmpValue->iValue]);
+                    key->CopyFrom(token->value->indexes.Key(tmpValue->iValue));
                 }
                 else
                 {
@@ -1871,7 +1871,7 @@ bool Lexer::DefineCollection(Token *token)
             {
                 return false;
             }
-            token->value->indexes.Set(new U8String(&key), new DslValue(inner->value));
+            token->value->indexes.Set(&key, new DslValue(inner->value));
             //Skip comma if present as index has already been accounted for.
             if (PeekNextTokenType() == COMMA )
             {
@@ -1884,9 +1884,9 @@ bool Lexer::DefineCollection(Token *token)
         bool isStaticExpression = false;
         isCollectionElement = true;
         int64_t keyIndex = token->value->indexes.Count();
-        for(int ii=0; ii<token->value->indexes.keys.Count(); ++ii)
+        for(int ii=0; ii<token->value->indexes.Count(); ++ii)
         {
-            if ( key.IsEqual(token->value->indexes.keys[ii]) )
+            if ( key.IsEqual(token->value->indexes.Key(ii)) )
             {
                 keyIndex = ii;
                 break;
@@ -1898,7 +1898,7 @@ bool Lexer::DefineCollection(Token *token)
             isCollectionElement = false;
             return false;
         }
-        token->value->indexes.Set(new U8String(&key), new DslValue(&dslValue));
+        token->value->indexes.Set(&key, new DslValue(&dslValue));
         isCollectionElement = false;
         if (PeekNextTokenType() == COMMA )
         {
@@ -2380,7 +2380,7 @@ bool Lexer::DefineSwitch()
                 }
             }
 
-            dslValues.push_back(new DslValue(caseValue));
+            dslValues.push_back(new DslValue(&caseValue));
             locationsStart.push_back(locationInfo);
             if ( !SkipToEndOfBlock(blockStart) )
             {
@@ -2552,6 +2552,199 @@ bool Lexer::DefineFor()
     return true;
 }
 
+/// \desc Reads the name of one of the variables of a foreach statement.
+/// \param name Receives the name.
+/// \return True if successful or false if the next token is not a name or is a key word.
+bool Lexer::GetForEachName(U8String *name)
+{
+    u8chr ch = GetNextNonCommentCharacter();
+    if ( !IS_ID_START(ch) || !GetIdentifier() || GetKeyWordTokenType(true) != INVALID_TOKEN )
+    {
+        return false;
+    }
+
+    name->CopyFrom(tmpBuffer);
+    return true;
+}
+
+/// \desc Checks that the foreach statement is formatted correctly and gets the names of its variables.
+/// \param key Receives the name of the key variable, left empty if only the value variable is named.
+/// \param value Receives the name of the value variable.
+/// \param collection Reference to the position info structure that receives the start of the collection expression.
+/// \param collectionEnd Reference to the position info structure that receives the end of the collection expression.
+/// \return True if successful or false if one or more errors occur.
+bool Lexer::CheckForEachSyntax(U8String *key, U8String *value, LocationInfo &collection, LocationInfo &collectionEnd)
+{
+    if ( GetNextTokenType(true) != OPEN_PAREN )
+    {
+        PrintIssue(2592, true, false, "An open parenthesis must follow the foreach keyword");
+        return false;
+    }
+
+    if ( !GetForEachName(value) )
+    {
+        PrintIssue(2593, true, false, "Expected a variable name after the foreach statement's open paren");
+        return false;
+    }
+
+    if ( PeekNextTokenType() == COMMA )
+    {
+        SkipNextTokenType();
+        key->CopyFrom(value);
+        if ( !GetForEachName(value) )
+        {
+            PrintIssue(2594, true, false, "Expected a variable name after the comma in the foreach statement");
+            return false;
+        }
+    }
+
+    U8String in;
+    if ( !GetForEachName(&in) || !in.IsEqual("in") )
+    {
+        PrintIssue(2595, true, false, "Expected in between the foreach statement's variables and collection");
+        return false;
+    }
+
+    collection = locationInfo;
+    if ( PeekNextTokenType() == CLOSE_PAREN )
+    {
+        PrintIssue(2596, true, false, "The foreach statement is missing the collection to iterate over");
+        return false;
+    }
+
+    int64_t parens = 1;
+    while( parens > 0 )
+    {
+        collectionEnd = locationInfo;
+        TokenTypes type = GetNextTokenType(true);
+        if ( type == END_OF_SCRIPT || type == OPEN_BLOCK )
+        {
+            PrintIssue(2597, true, false, "No close paren after the foreach statement's collection");
+            return false;
+        }
+        if ( type == OPEN_PAREN )
+        {
+            ++parens;
+        }
+        if ( type == CLOSE_PAREN )
+        {
+            --parens;
+        }
+    }
+
+    if ( PeekNextTokenType() != OPEN_BLOCK )
+    {
+        PrintIssue(2598, true, false, "Missing open block after the foreach statement's close paren");
+        return false;
+    }
+
+    return true;
+}
+
+/// \desc Gets the full name of a variable a foreach loop stores into, the variable is defined at
+///       script scope if it does not exist yet.
+/// \param name Name of the variable as written in the script.
+/// \param fullName Receives the full name of the variable.
+/// \return True if successful or false if an error occurs.
+bool Lexer::GetForEachVariable(U8String *name, U8String *fullName)
+{
+    tmpBuffer->CopyFrom(name);
+    if ( IsVariableDefined(true) )
+    {
+        //The iterator instructions only store into script and global variables.
+        Token *variable = variables.Get(&fullVarName);
+        if ( variable->modifier == TMLocalScope || variable->type == FUNCTION_PARAMETER || variable->readyOnly )
+        {
+            PrintIssue(2599, true, false,
+                       "%s can't be used by foreach as it is a local, parameter or const variable", name->cStr());
+            return false;
+        }
+        fullName->CopyFrom(&fullVarName);
+        return true;
+    }
+
+    auto *token = new Token(VARIABLE_DEF, tmpBuffer);
+    token->modifier = TMScriptScope;
+    token->value->variableScriptName.CopyFrom(tmpBuffer);
+    if ( !ValidateAndGetFullName(token, false) )
+    {
+        return false;
+    }
+
+    if ( !variables.Set(token->identifier, new Token(token)) )
+    {
+        return false;
+    }
+
+    if ( !tokens.push_back(token) )
+    {
+        return false;
+    }
+
+    fullName->CopyFrom(token->identifier);
+    return true;
+}
+
+//foreach ( [key ,] value in collection expression ) { statements }
+/// \desc Defines the tokens for a foreach loop. The loop walks the collection's elements in the order
+///       they were added, the key variable receives each element's key and the value variable a copy
+///       of its value. The collection is shared with the loop when it starts so changing the
+///       collection inside the loop does not change the elements the loop walks.
+/// \return True if successful or false if an error occurs.
+bool Lexer::DefineForEach()
+{
+    LocationInfo statementStart = locationInfo;
+    LocationInfo collection;
+    LocationInfo collectionEnd;
+    U8String key;
+    U8String value;
+
+    if ( !CheckForEachSyntax(&key, &value, collection, collectionEnd) )
+    {
+        SkipToEndOfBlock(statementStart);
+        return false;
+    }
+
+    //The collection and position of the loop are kept in a hidden variable, # can't be used in
+    //an identifier so the script can't refer to it.
+    U8String iterator;
+    iterator.CopyFromCString("foreach#");
+    iterator.Append(tokens.Count());
+
+    U8String keyName;
+    U8String valueName;
+    U8String iteratorName;
+    if ( (!key.IsEmpty() && !GetForEachVariable(&key, &keyName)) || !GetForEachVariable(&value, &valueName) ||
+         !GetForEachVariable(&iterator, &iteratorName) )
+    {
+        SkipToEndOfBlock(statementStart);
+        return false;
+    }
+
+    locationInfo = collection;
+    tokens.push_back(new Token(FOREACH_COND_BEGIN));
+    if ( !DefineStatements(collectionEnd) )
+    {
+        SkipToEndOfBlock(statementStart);
+        return false;
+    }
+    tokens.push_back(new Token(FOREACH_COND_END, &iteratorName));
+
+    if ( !key.IsEmpty() )
+    {
+        tokens.push_back(new Token(FOREACH_KEY, &keyName));
+    }
+    tokens.push_back(new Token(FOREACH_VALUE, &valueName));
+
+    if ( !DefineStatementBlock(collectionEnd, FOREACH_BLOCK_BEGIN, FOREACH_BLOCK_END) )
+    {
+        SkipToEndOfBlock(statementStart);
+        return false;
+    }
+
+    return true;
+}
+
 /// \desc Skips to the end of a code block.
 /// \remark sets the previous position information as switch needs to back up one place on case block end.
 bool Lexer::SkipToEndOfBlock(LocationInfo start, int64_t errorCode, const char *errorMsg)
@@ -2562,6 +2755,11 @@ bool Lexer::SkipToEndOfBlock(LocationInfo start, int64_t errorCode, const char *
     while( type != OPEN_BLOCK )
     {
         type = GetNextTokenType(true);
+        //A statement missing its block has already reported the error.
+        if ( type == END_OF_SCRIPT )
+        {
+            return false;
+        }
     }
 
     int64_t blocks = locationInfo.Blocks();
@@ -4133,6 +4331,12 @@ TokenTypes Lexer::GenerateTokens(TokenTypes type)
                 return ERROR_TOKEN;
             }
             return type;
+        case FOREACH:
+            if ( !DefineForEach() )
+            {
+                return ERROR_TOKEN;
+            }
+            return type;
         case CASE:
             PrintIssue(2850, true, false, "The case key word can only be used inside a switch statement");
             return ERROR_TOKEN;
@@ -4226,6 +4430,8 @@ TokenTypes Lexer::GenerateTokens(TokenTypes type)
         case SWITCH_COND_END: case SWITCH_BEGIN: case SWITCH_END: case CASE_COND_BEGIN: case CASE_COND_END:
         case CASE_BLOCK_BEGIN: case CASE_BLOCK_END: case DEFAULT_BLOCK_BEGIN: case DEFAULT_BLOCK_END: case COLLECTION:
         case COLLECTION_BEGIN: case COLLECTION_END: case COLLECTION_VALUE: case INVALID_EXPRESSION:
+        case FOREACH_COND_BEGIN: case FOREACH_COND_END: case FOREACH_KEY: case FOREACH_VALUE:
+        case FOREACH_BLOCK_BEGIN: case FOREACH_BLOCK_END:
             return type;
         case COMPONENT:
             return UpdateComponentInformation();
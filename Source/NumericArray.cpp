@@ -0,0 +1,514 @@
+#include <cmath>
+#include "../Includes/NumericArray.h"
+#include "../Includes/DslValue.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define NUMERIC_ARRAY_SSE2
+#include <immintrin.h>
+#endif
+
+#if defined(NUMERIC_ARRAY_SSE2) && defined(__GNUC__)
+#define NUMERIC_ARRAY_AVX2
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+//Each element operation has a scalar form and a form for each vector instruction set, the
+//unary operations ignore the right value.
+
+struct AddDouble
+{
+    static double Scalar(double left, double right) { return left + right; }
+#ifdef NUMERIC_ARRAY_SSE2
+    static __m128d Sse2(__m128d left, __m128d right) { return _mm_add_pd(left, right); }
+#endif
+#ifdef NUMERIC_ARRAY_AVX2
+    AVX2_TARGET static __m256d Avx2(__m256d left, __m256d right) { return _mm256_add_pd(left, right); }
+#endif
+};
+
+struct SubDouble
+{
+    static double Scalar(double left, double right) { return left - right; }
+#ifdef NUMERIC_ARRAY_SSE2
+    static __m128d Sse2(__m128d left, __m128d right) { return _mm_sub_pd(left, right); }
+#endif
+#ifdef NUMERIC_ARRAY_AVX2
+    AVX2_TARGET static __m256d Avx2(__m256d left, __m256d right) { return _mm256_sub_pd(left, right); }
+#endif
+};
+
+struct MulDouble
+{
+    static double Scalar(double left, double right) { return left * right; }
+#ifdef NUMERIC_ARRAY_SSE2
+    static __m128d Sse2(__m128d left, __m128d right) { return _mm_mul_pd(left, right); }
+#endif
+#ifdef NUMERIC_ARRAY_AVX2
+    AVX2_TARGET static __m256d Avx2(__m256d left, __m256d right) { return _mm256_mul_pd(left, right); }
+#endif
+};
+
+struct DivDouble
+{
+    static double Scalar(double left, double right) { return left / right; }
+#ifdef NUMERIC_ARRAY_SSE2
+    static __m128d Sse2(__m128d left, __m128d right) { return _mm_div_pd(left, right); }
+#endif
+#ifdef NUMERIC_ARRAY_AVX2
+    AVX2_TARGET static __m256d Avx2(__m256d left, __m256d right) { return _mm256_div_pd(left, right); }
+#endif
+};
+
+struct SqrtDouble
+{
+    static double Scalar(double left, double) { return sqrt(left); }
+#ifdef NUMERIC_ARRAY_SSE2
+    static __m128d Sse2(__m128d left, __m128d) { return _mm_sqrt_pd(left); }
+#endif
+#ifdef NUMERIC_ARRAY_AVX2
+    AVX2_TARGET static __m256d Avx2(__m256d left, __m256d) { return _mm256_sqrt_pd(left); }
+#endif
+};
+
+struct AbsDouble
+{
+    static double Scalar(double left, double) { return fabs(left); }
+#ifdef NUMERIC_ARRAY_SSE2
+    static __m128d Sse2(__m128d left, __m128d) { return _mm_andnot_pd(_mm_set1_pd(-0.0), left); }
+#endif
+#ifdef NUMERIC_ARRAY_AVX2
+    AVX2_TARGET static __m256d Avx2(__m256d left, __m256d) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), left); }
+#endif
+};
+
+struct AddInteger
+{
+    static int64_t Scalar(int64_t left, int64_t right) { return left + right; }
+#ifdef NUMERIC_ARRAY_SSE2
+    static __m128i Sse2(__m128i left, __m128i right) { return _mm_add_epi64(left, right); }
+#endif
+#ifdef NUMERIC_ARRAY_AVX2
+    AVX2_TARGET static __m256i Avx2(__m256i left, __m256i right) { return _mm256_add_epi64(left, right); }
+#endif
+};
+
+struct SubInteger
+{
+    static int64_t Scalar(int64_t left, int64_t right) { return left - right; }
+#ifdef NUMERIC_ARRAY_SSE2
+    static __m128i Sse2(__m128i left, __m128i right) { return _mm_sub_epi64(left, right); }
+#endif
+#ifdef NUMERIC_ARRAY_AVX2
+    AVX2_TARGET static __m256i Avx2(__m256i left, __m256i right) { return _mm256_sub_epi64(left, right); }
+#endif
+};
+
+struct AndInteger
+{
+    static int64_t Scalar(int64_t left, int64_t right) { return left & right; }
+#ifdef NUMERIC_ARRAY_SSE2
+    static __m128i Sse2(__m128i left, __m128i right) { return _mm_and_si128(left, right); }
+#endif
+#ifdef NUMERIC_ARRAY_AVX2
+    AVX2_TARGET static __m256i Avx2(__m256i left, __m256i right) { return _mm256_and_si256(left, right); }
+#endif
+};
+
+struct OrInteger
+{
+    static int64_t Scalar(int64_t left, int64_t right) { return left | right; }
+#ifdef NUMERIC_ARRAY_SSE2
+    static __m128i Sse2(__m128i left, __m128i right) { return _mm_or_si128(left, right); }
+#endif
+#ifdef NUMERIC_ARRAY_AVX2
+    AVX2_TARGET static __m256i Avx2(__m256i left, __m256i right) { return _mm256_or_si256(left, right); }
+#endif
+};
+
+struct XorInteger
+{
+    static int64_t Scalar(int64_t left, int64_t right) { return left ^ right; }
+#ifdef NUMERIC_ARRAY_SSE2
+    static __m128i Sse2(__m128i left, __m128i right) { return _mm_xor_si128(left, right); }
+#endif
+#ifdef NUMERIC_ARRAY_AVX2
+    AVX2_TARGET static __m256i Avx2(__m256i left, __m256i right) { return _mm256_xor_si256(left, right); }
+#endif
+};
+
+#ifdef NUMERIC_ARRAY_AVX2
+/// \desc Checks once if the processor and operating system support AVX2.
+static bool HasAvx2()
+{
+    static bool hasAvx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") != 0);
+    return hasAvx2;
+}
+
+template<class Op> AVX2_TARGET int64_t DoubleLoopAvx2(double *left, const double *right, bool broadcast, int64_t count)
+{
+    __m256d value = _mm256_set1_pd(*right);
+    int64_t ii = 0;
+    for(; ii + 4 <= count; ii += 4)
+    {
+        __m256d other = broadcast ? value : _mm256_loadu_pd(right + ii);
+        _mm256_storeu_pd(left + ii, Op::Avx2(_mm256_loadu_pd(left + ii), other));
+    }
+    return ii;
+}
+
+template<class Op> AVX2_TARGET int64_t IntegerLoopAvx2(int64_t *left, const int64_t *right, bool broadcast, int64_t count)
+{
+    __m256i value = _mm256_set1_epi64x(*right);
+    int64_t ii = 0;
+    for(; ii + 4 <= count; ii += 4)
+    {
+        __m256i other = broadcast ? value : _mm256_loadu_si256((const __m256i *)(right + ii));
+        _mm256_storeu_si256((__m256i *)(left + ii), Op::Avx2(_mm256_loadu_si256((const __m256i *)(left + ii)), other));
+    }
+    return ii;
+}
+#endif
+
+#ifdef NUMERIC_ARRAY_SSE2
+template<class Op> int64_t DoubleLoopSse2(double *left, const double *right, bool broadcast, int64_t count)
+{
+    __m128d value = _mm_set1_pd(*right);
+    int64_t ii = 0;
+    for(; ii + 2 <= count; ii += 2)
+    {
+        __m128d other = broadcast ? value : _mm_loadu_pd(right + ii);
+        _mm_storeu_pd(left + ii, Op::Sse2(_mm_loadu_pd(left + ii), other));
+    }
+    return ii;
+}
+
+template<class Op> int64_t IntegerLoopSse2(int64_t *left, const int64_t *right, bool broadcast, int64_t count)
+{
+    __m128i value = _mm_set1_epi64x(*right);
+    int64_t ii = 0;
+    for(; ii + 2 <= count; ii += 2)
+    {
+        __m128i other = broadcast ? value : _mm_loadu_si128((const __m128i *)(right + ii));
+        _mm_storeu_si128((__m128i *)(left + ii), Op::Sse2(_mm_loadu_si128((const __m128i *)(left + ii)), other));
+    }
+    return ii;
+}
+#endif
+
+/// \desc Runs an operation on each element of left and either the element of right at the same
+///       index or, if broadcast is true, the single value right points to.
+template<class Op> void DoubleLoop(double *left, const double *right, bool broadcast, int64_t count)
+{
+    int64_t ii = 0;
+#ifdef NUMERIC_ARRAY_AVX2
+    if ( HasAvx2() )
+    {
+        ii = DoubleLoopAvx2<Op>(left, right, broadcast, count);
+    }
+    else
+#endif
+    {
+#ifdef NUMERIC_ARRAY_SSE2
+        ii = DoubleLoopSse2<Op>(left, right, broadcast, count);
+#endif
+    }
+    for(; ii<count; ++ii)
+    {
+        left[ii] = Op::Scalar(left[ii], broadcast ? *right : right[ii]);
+    }
+}
+
+/// \desc Integer version of DoubleLoop.
+template<class Op> void IntegerLoop(int64_t *left, const int64_t *right, bool broadcast, int64_t count)
+{
+    int64_t ii = 0;
+#ifdef NUMERIC_ARRAY_AVX2
+    if ( HasAvx2() )
+    {
+        ii = IntegerLoopAvx2<Op>(left, right, broadcast, count);
+    }
+    else
+#endif
+    {
+#ifdef NUMERIC_ARRAY_SSE2
+        ii = IntegerLoopSse2<Op>(left, right, broadcast, count);
+#endif
+    }
+    for(; ii<count; ++ii)
+    {
+        left[ii] = Op::Scalar(left[ii], broadcast ? *right : right[ii]);
+    }
+}
+
+/// \desc Runs an operation on doubles.
+/// \return False if the operation does not have a vector loop.
+static bool DoubleOperation(OPCODES op, double *left, const double *right, bool broadcast, int64_t count)
+{
+    switch( op )
+    {
+        default:
+            return false;
+        case ADD:
+            DoubleLoop<AddDouble>(left, right, broadcast, count);
+            break;
+        case SUB:
+            DoubleLoop<SubDouble>(left, right, broadcast, count);
+            break;
+        case MUL:
+            DoubleLoop<MulDouble>(left, right, broadcast, count);
+            break;
+        case DIV:
+            DoubleLoop<DivDouble>(left, right, broadcast, count);
+            break;
+    }
+    return true;
+}
+
+/// \desc Runs an operation on integers.
+/// \return False if the operation does not have a vector loop.
+static bool IntegerOperation(OPCODES op, int64_t *left, const int64_t *right, bool broadcast, int64_t count)
+{
+    switch( op )
+    {
+        default:
+            return false;
+        case ADD:
+            IntegerLoop<AddInteger>(left, right, broadcast, count);
+            break;
+        case SUB:
+            IntegerLoop<SubInteger>(left, right, broadcast, count);
+            break;
+        case MUL:
+            //There is no 64 bit multiply before AVX-512, the plain loop still avoids the dispatch.
+            for(int64_t ii=0; ii<count; ++ii)
+            {
+                left[ii] *= broadcast ? *right : right[ii];
+            }
+            break;
+        case BND:
+            IntegerLoop<AndInteger>(left, right, broadcast, count);
+            break;
+        case BOR:
+            IntegerLoop<OrInteger>(left, right, broadcast, count);
+            break;
+        case XOR:
+            IntegerLoop<XorInteger>(left, right, broadcast, count);
+            break;
+    }
+    return true;
+}
+
+bool NumericArray::IsVectorOperation(OPCODES op, TokenTypes elementType)
+{
+    switch( op )
+    {
+        default:
+            return false;
+        case ADD: case SUB: case MUL:
+            return true;
+        case DIV:
+            return elementType == DOUBLE_VALUE;
+        case BND: case BOR: case XOR:
+            return elementType == INTEGER_VALUE;
+    }
+}
+
+int64_t NumericArray::Load(Collection *collection, int64_t start, TokenTypes elementType)
+{
+    type = elementType;
+    count = 0;
+    for(int64_t ii=start; ii<collection->Count() && count<NUMERIC_ARRAY_BLOCK; ++ii)
+    {
+        auto *element = (DslValue *)collection->Entry(ii)->Data();
+        if ( element == nullptr || element->type != type )
+        {
+            break;
+        }
+        elements[count] = element;
+        if ( type == INTEGER_VALUE )
+        {
+            integers[count] = element->iValue;
+        }
+        else
+        {
+            doubles[count] = element->dValue;
+        }
+        ++count;
+    }
+
+    return count;
+}
+
+void NumericArray::Store()
+{
+    for(int64_t ii=0; ii<count; ++ii)
+    {
+        elements[ii]->type = type;
+        if ( type == INTEGER_VALUE )
+        {
+            elements[ii]->iValue = integers[ii];
+        }
+        else
+        {
+            elements[ii]->dValue = doubles[ii];
+        }
+    }
+}
+
+bool NumericArray::Apply(OPCODES op, NumericArray *right)
+{
+    if ( type == INTEGER_VALUE )
+    {
+        return IntegerOperation(op, integers, right->integers, false, count);
+    }
+    return DoubleOperation(op, doubles, right->doubles, false, count);
+}
+
+bool NumericArray::Apply(OPCODES op, int64_t right)
+{
+    return IntegerOperation(op, integers, &right, true, count);
+}
+
+bool NumericArray::Apply(OPCODES op, double right)
+{
+    return DoubleOperation(op, doubles, &right, true, count);
+}
+
+void NumericArray::Apply(double (*function)(double))
+{
+    if ( function == SquareRoot )
+    {
+        DoubleLoop<SqrtDouble>(doubles, doubles, false, count);
+        return;
+    }
+    if ( function == Absolute )
+    {
+        DoubleLoop<AbsDouble>(doubles, doubles, false, count);
+        return;
+    }
+
+    for(int64_t ii=0; ii<count; ++ii)
+    {
+        doubles[ii] = function(doubles[ii]);
+    }
+}
+
+double NumericArray::SquareRoot(double value)
+{
+    return sqrt(value);
+}
+
+double NumericArray::Absolute(double value)
+{
+    return fabs(value);
+}
+
+int64_t NumericArray::Operation(DslValue *left, OPCODES op, DslValue *right)
+{
+    Collection *collection = &left->indexes;
+    int64_t total = collection->Count();
+    if ( total == 0 )
+    {
+        return 0;
+    }
+    auto *first = (DslValue *)collection->Entry(0)->Data();
+    if ( first == nullptr || (first->type != INTEGER_VALUE && first->type != DOUBLE_VALUE)
+         || !IsVectorOperation(op, first->type) )
+    {
+        return 0;
+    }
+    TokenTypes elementType = first->type;
+
+    NumericArray values;
+    if ( right->type == COLLECTION )
+    {
+        //Sizes and types are checked before any element is changed so the element by element
+        //path can report them, the same for divide by zero which is reported for each element.
+        Collection *others = &right->indexes;
+        if ( others->Count() != total )
+        {
+            return 0;
+        }
+        for(int64_t ii=0; ii<total; ++ii)
+        {
+            auto *element = (DslValue *)collection->Entry(ii)->Data();
+            auto *other = (DslValue *)others->Entry(ii)->Data();
+            if ( element == nullptr || other == nullptr || element->type != elementType || other->type != elementType
+                 || (op == DIV && other->dValue == 0.0) )
+            {
+                return 0;
+            }
+        }
+        NumericArray operands;
+        for(int64_t start=0; start<total; start += values.count)
+        {
+            values.Load(collection, start, elementType);
+            operands.Load(others, start, elementType);
+            values.Apply(op, &operands);
+            values.Store();
+        }
+        return total;
+    }
+
+    //The elements would each convert the value to their type, until one of another type is
+    //reached they all have the type of the first.
+    right->Convert(elementType);
+    if ( op == DIV && right->IsZero() )
+    {
+        return 0;
+    }
+    int64_t start = 0;
+    while( start < total && values.Load(collection, start, elementType) > 0 )
+    {
+        if ( elementType == INTEGER_VALUE )
+        {
+            values.Apply(op, right->iValue);
+        }
+        else
+        {
+            values.Apply(op, right->dValue);
+        }
+        values.Store();
+        start += values.count;
+    }
+
+    return start;
+}
+
+void NumericArray::Apply(DslValue *collection, double (*function)(double))
+{
+    NumericArray values;
+    values.type = DOUBLE_VALUE;
+    int64_t total = collection->indexes.Count();
+    int64_t ii = 0;
+    while( ii < total )
+    {
+        //Numbers are gathered into the block, anything else is changed where it is found.
+        values.count = 0;
+        for(; ii<total && values.count<NUMERIC_ARRAY_BLOCK; ++ii)
+        {
+            auto *element = (DslValue *)collection->indexes.Entry(ii)->Data();
+            if ( element == nullptr )
+            {
+                continue;
+            }
+            if ( element->type == INTEGER_VALUE || element->type == DOUBLE_VALUE )
+            {
+                values.elements[values.count] = element;
+                values.doubles[values.count] = element->type == INTEGER_VALUE ? (double)element->iValue : element->dValue;
+                ++values.count;
+                continue;
+            }
+            if ( element->type == COLLECTION )
+            {
+                element->indexes.Detach();
+                Apply(element, function);
+                continue;
+            }
+            element->Convert(DOUBLE_VALUE);
+            element->dValue = function(element->dValue);
+        }
+        values.Apply(function);
+        values.Store();
+    }
+}
@@ -133,6 +133,22 @@ DslValue *Parser::OutputCode(Token *token, OPCODES opcode)
                 return nullptr;
             }
             break;
+        case ITS: case ITN: case ITK: case ITV:
+            variable = GetVariableInfo(token);
+            if ( variable == nullptr )
+            {
+                return nullptr;
+            }
+            value = new DslValue(variable->value);
+            value->opcode = opcode;
+            value->iValue = token->value->iValue;
+            value->location = token->value->location;
+            value->moduleId = token->value->moduleId;
+            if ( !program.push_back(value) )
+            {
+                return nullptr;
+            }
+            break;
         case JBF:
             value = new DslValue(JBF, standardFunctions.Get(token->identifier)->value->operand);
             value->moduleId = token->value->moduleId;
@@ -201,6 +217,13 @@ DslValue *Parser::OutputCode(Token *token, OPCODES opcode)
                 return nullptr;
             }
             break;
+        case AVI: case AVV: case SVI: case LOI: case CVI: case CVV: case CLI:
+        case ADD_II: case SUB_II: case MUL_II: case TEQ_II: case TNE_II: case TGR_II: case TGE_II:
+        case TLS_II: case TLE_II: case ADD_DD: case SUB_DD: case MUL_DD: case DIV_DD: case TEQ_DD:
+        case TNE_DD: case TGR_DD: case TGE_DD: case TLS_DD: case TLE_DD:
+            //Fused and quickened instructions are only created by the CPU, when it loads and
+            //runs the program.
+            return nullptr;
     }
 
     return value;
@@ -325,9 +348,9 @@ bool Parser::Parse()
     for(int64_t ii=0; ii<modules.Count(); ++ii)
     {
         //Add any system events.
-        for(int64_t tt=1; tt<modules[ii]->systemEvents.Count(); ++tt)
+        for(int64_t tt=ON_ERROR; tt<=ON_RIGHT_DOWN; ++tt)
         {
-            if ( modules[ii]->systemEvents.Count() > 0 )
+            if ( !modules[ii]->systemEvents[tt].IsEmpty() )
             {
                 Token *funInfo = functions.Get(&modules[ii]->systemEvents[tt]);
                 auto *ef = new Token(funInfo);
@@ -422,13 +445,12 @@ Token *Parser::ShuntingYard(Token *token, int64_t tokenLocation)
             case FOR_UPDATE_BEGIN: case FOR_BLOCK_BEGIN: case FOR_INIT_BEGIN: case FOR_COND_BEGIN:
             case FUNCTION_CALL_END: case END_OF_SCRIPT:
             case DEFAULT_BLOCK_BEGIN: case DEFAULT_BLOCK_END: case FUNCTION_PARAMETER:
+            case FOREACH_COND_BEGIN: case FOREACH_KEY: case FOREACH_VALUE: case FOREACH_BLOCK_BEGIN:
                 output.Enqueue(token);
                 break;
             case FUNCTION_DEF_BEGIN:
                 {
                     output.Enqueue(token);
-                    auto *t = functions.Get(token->identifier);
-                    printf("%s", t->identifier->cStr());
                     break;
                 }
             case FUNCTION_DEF_END:
@@ -439,7 +461,7 @@ Token *Parser::ShuntingYard(Token *token, int64_t tokenLocation)
             case FOR_UPDATE_END:
             case WHILE_BLOCK_END: case CASE_BLOCK_END: case SWITCH_END: case FOR_COND_END: case FOR_INIT_END:
             case FOR_BLOCK_END: case IF_BLOCK_END: case IF_COND_END: case ELSE_BLOCK_END:
-            case WHILE_COND_END: case SWITCH_COND_END:
+            case WHILE_COND_END: case SWITCH_COND_END: case FOREACH_COND_END: case FOREACH_BLOCK_END:
                 while( ops.top() != 0 )
                 {
                     output.Enqueue(ops.pop_back());
@@ -769,9 +791,15 @@ Token *Parser::Expression(int64_t tokenLocation)
                 break;
             }
             case FUNCTION_DEF_END:
+                //A function that ends without a return statement returns 0, RET always takes
+                //the value to return from the top of the stack.
+                OutputCount(0, currentToken->value->moduleId);
                 OutputCode(currentToken, RET);
                 program[jumpLocations.pop_back()]->location = program.Count();
                 break;
+            case FUNCTION_PARAMETER:
+                //The caller pushes the parameters, the function has no code for them.
+                break;
             case IF_BLOCK_BEGIN: case IF_COND_BEGIN:
                 break;
             case IF_COND_END:
@@ -832,6 +860,60 @@ Token *Parser::Expression(int64_t tokenLocation)
                 OutputCode(tmp, JMP);
                 break;
             }
+            case FOREACH_COND_BEGIN: case FOREACH_BLOCK_BEGIN:
+                break;
+            case FOREACH_COND_END:
+            {
+                //The collection is on the stack, the loop starts at the ITN that gets each element.
+                OutputCode(currentToken, ITS);
+                currentToken->switchIndex = program.Count();
+                currentToken->switchCaseIndex = continueLocations.Count();
+                OutputCode(currentToken, ITN);
+                foreachLoops.push_back(currentToken);
+                breakableTokens.push_back(currentToken);
+                break;
+            }
+            case FOREACH_KEY:
+            {
+                Token *loop = foreachLoops.pop_back();
+                foreachLoops.push_back(loop);
+                currentToken->value->iValue = GetVariableInfo(loop)->value->operand;
+                OutputCode(currentToken, ITK);
+                break;
+            }
+            case FOREACH_VALUE:
+            {
+                Token *loop = foreachLoops.pop_back();
+                foreachLoops.push_back(loop);
+                currentToken->value->iValue = GetVariableInfo(loop)->value->operand;
+                OutputCode(currentToken, ITV);
+                break;
+            }
+            case FOREACH_BLOCK_END:
+            {
+                Token *loop = foreachLoops.pop_back();
+                auto *tmp = new Token(currentToken);
+                tmp->value->location = loop->switchIndex;
+                OutputCode(tmp, JMP);
+                program[loop->switchIndex]->location = program.Count();
+
+                //Continues go to the ITN for the next element and breaks to the end of the loop.
+                while( continueLocations.Count() > loop->switchCaseIndex )
+                {
+                    program[continueLocations.pop_back()]->location = loop->switchIndex;
+                }
+                //Loops that ended inside this one can leave their tokens above it.
+                Token *breakable = nullptr;
+                while( breakable != loop && breakableTokens.Count() > 0 )
+                {
+                    breakable = breakableTokens.pop_back();
+                }
+                while( loop->breakLocations.Count() > 0 )
+                {
+                    program[loop->breakLocations.pop_back()]->location = program.Count();
+                }
+                break;
+            }
             case EVENT_RETURN:
                 OutputCode(token, RFE);
                 break;
@@ -850,9 +932,11 @@ Token *Parser::Expression(int64_t tokenLocation)
                     CreateOperation(currentToken);
                     break;
                 }
-                fatal = true;
-                printf("Token in output queue but not processed: %s\n",
-                       tokenNames[(int64_t)currentToken->type & 0xFF]);
+                PrintIssue(3200,
+                           true, true,
+                           "Parser error, token %s in the output queue was not processed, this indicates "
+                           "an error in the parser as it has no code for the token.",
+                           tokenNames[(int64_t)currentToken->type & 0xFF]);
                 break;
         }
     }
@@ -0,0 +1,134 @@
+#include "../Includes/SymbolTable.h"
+
+std::mutex SymbolTable::lock;
+Symbol **SymbolTable::slots = nullptr;
+int64_t SymbolTable::slotMask = 0;
+int64_t SymbolTable::count = 0;
+
+Symbol *SymbolTable::Intern(U8String *text)
+{
+    return Intern(text, text->Hash());
+}
+
+Symbol *SymbolTable::Intern(const char *text)
+{
+    U8String value(text);
+    return Intern(&value);
+}
+
+Symbol *SymbolTable::Intern(U8String *text, uint32_t hash)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if ( slots == nullptr || (count + 1) * 4 > (slotMask + 1) * 3 )
+    {
+        if ( !Grow() )
+        {
+            return nullptr;
+        }
+    }
+
+    int64_t slot = hash & slotMask;
+    for(; slots[slot] != nullptr; slot = (slot + 1) & slotMask)
+    {
+        if ( slots[slot]->hash == hash && slots[slot]->text.IsEqual(text) )
+        {
+            //A symbol in the table has at least one reference, the last one is only released
+            //with the lock held.
+            slots[slot]->AddReference();
+            return slots[slot];
+        }
+    }
+
+    auto *symbol = new Symbol(text, hash);
+    slots[slot] = symbol;
+    ++count;
+
+    return symbol;
+}
+
+void SymbolTable::Release(Symbol *symbol)
+{
+    if ( symbol == nullptr )
+    {
+        return;
+    }
+
+    //Releasing a reference that is not the last one does not need the lock.
+    int64_t references = symbol->references.load(std::memory_order_relaxed);
+    while( references > 1 )
+    {
+        if ( symbol->references.compare_exchange_weak(references, references - 1) )
+        {
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    if ( symbol->references.fetch_sub(1) != 1 )
+    {
+        return;
+    }
+
+    int64_t slot = symbol->hash & slotMask;
+    while( slots[slot] != symbol )
+    {
+        slot = (slot + 1) & slotMask;
+    }
+    Remove(slot);
+    --count;
+    delete symbol;
+}
+
+int64_t SymbolTable::Count()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return count;
+}
+
+bool SymbolTable::Grow()
+{
+    int64_t slotCount = slots == nullptr ? SYMBOL_TABLE_MIN_SLOTS : (slotMask + 1) * 2;
+    auto *grown = new Symbol *[slotCount];
+    memset(grown, 0, slotCount * sizeof(Symbol *));
+
+    for(int64_t ii=0; slots != nullptr && ii<=slotMask; ++ii)
+    {
+        if ( slots[ii] == nullptr )
+        {
+            continue;
+        }
+        int64_t slot = slots[ii]->hash & (slotCount - 1);
+        while( grown[slot] != nullptr )
+        {
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        grown[slot] = slots[ii];
+    }
+
+    delete []slots;
+    slots = grown;
+    slotMask = slotCount - 1;
+
+    return true;
+}
+
+void SymbolTable::Remove(int64_t slot)
+{
+    slots[slot] = nullptr;
+
+    //A symbol after the empty slot stays where it is if its home slot is after the empty slot
+    //in the probe order, otherwise it would not be found and is moved into the empty slot.
+    int64_t next = (slot + 1) & slotMask;
+    while( slots[next] != nullptr )
+    {
+        int64_t home = slots[next]->hash & slotMask;
+        if ( ((next - home) & slotMask) >= ((next - slot) & slotMask) )
+        {
+            slots[slot] = slots[next];
+            slots[next] = nullptr;
+            slot = next;
+        }
+        next = (next + 1) & slotMask;
+    }
+}
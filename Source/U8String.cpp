@@ -5,55 +5,566 @@
 #include <cstdio>
 #include <stdlib.h>
 
-bool U8String::IsEqual(U8String *u8String)
+#if defined(__x86_64__) || defined(_M_X64)
+#define U8STRING_SSE2
+#include <immintrin.h>
+#endif
+
+#if defined(U8STRING_SSE2) && defined(__GNUC__)
+#define U8STRING_AVX2
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+/// \desc Encodes a character as UTF8, characters outside of the unicode range are stored as the
+///       replacement character U+FFFD.
+/// \param ch Character to encode.
+/// \param out Receives the 1 to 4 bytes of the character.
+/// \return Number of bytes written to out.
+static int64_t EncodeCharacter(u8chr ch, char *out)
 {
-    if (u8String == nullptr)
+    if ( ch > 0x10FFFF )
     {
-        return false;
+        ch = 0xFFFD;
     }
+    if ( ch < 0x80 )
+    {
+        out[0] = (char)ch;
+        return 1;
+    }
+    if ( ch < 0x800 )
+    {
+        out[0] = (char)(0xC0 | (ch >> 6));
+        out[1] = (char)(0x80 | (ch & 0x3F));
+        return 2;
+    }
+    if ( ch < 0x10000 )
+    {
+        out[0] = (char)(0xE0 | (ch >> 12));
+        out[1] = (char)(0x80 | ((ch >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (ch & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (ch >> 18));
+    out[1] = (char)(0x80 | ((ch >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((ch >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (ch & 0x3F));
+    return 4;
+}
 
-    if (Count() != u8String->Count() )
+/// \desc Decodes a character written by EncodeCharacter.
+/// \param in First byte of the character.
+/// \param ch Receives the character.
+/// \return Number of bytes in the character.
+static int64_t DecodeCharacter(const char *in, u8chr *ch)
+{
+    auto *p = (const Byte *)in;
+    if ( p[0] < 0x80 )
     {
-        return false;
+        *ch = p[0];
+        return 1;
+    }
+    if ( p[0] < 0xE0 )
+    {
+        *ch = ((u8chr)(p[0] & 0x1F) << 6) | (p[1] & 0x3F);
+        return 2;
     }
+    if ( p[0] < 0xF0 )
+    {
+        *ch = ((u8chr)(p[0] & 0x0F) << 12) | ((u8chr)(p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+        return 3;
+    }
+    *ch = ((u8chr)(p[0] & 0x07) << 18) | ((u8chr)(p[1] & 0x3F) << 12) | ((u8chr)(p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+    return 4;
+}
 
-    int64_t ii;
-    for(ii=0; ii < Count(); ++ii)
+/// \desc Checks if the bytes start with a valid UTF8 character of more than one byte.
+/// \param in Bytes to check.
+/// \param available Number of bytes that can be read.
+/// \return Number of bytes in the character or 0 if it is not a valid character.
+static int64_t ValidCharacterLength(const Byte *in, int64_t available)
+{
+    int64_t len;
+    u8chr minimum;
+    if ( in[0] >= 0xC2 && in[0] <= 0xDF )
+    {
+        len = 2;
+        minimum = 0x80;
+    }
+    else if ( in[0] >= 0xE0 && in[0] <= 0xEF )
     {
-        if (get(ii) != u8String->get(ii))
+        len = 3;
+        minimum = 0x800;
+    }
+    else if ( in[0] >= 0xF0 && in[0] <= 0xF4 )
+    {
+        len = 4;
+        minimum = 0x10000;
+    }
+    else
+    {
+        return 0;
+    }
+    if ( len > available )
+    {
+        return 0;
+    }
+    for(int64_t ii=1; ii<len; ++ii)
+    {
+        if ( !UTF8_IS_CONTINUATION(in[ii]) )
         {
-            return false;
+            return 0;
         }
     }
+    u8chr ch;
+    DecodeCharacter((const char *)in, &ch);
 
-    return true;
+    return ch >= minimum && ch <= 0x10FFFF ? len : 0;
 }
 
-bool U8String::IsEqual(const char *string)
+//The byte loops below work on the UTF8 bytes of strings. Each has a scalar form and a form
+//for each vector instruction set, the vector forms return the offset the scalar form continues
+//at so the scalar form finishes the bytes left over and finds the exact position of a match
+//inside the block that had it.
+
+/// \desc Changes an ASCII upper case letter to lower case.
+static inline char FoldByte(char ch)
 {
-    if (string == nullptr)
+    return ch >= 'A' && ch <= 'Z' ? (char)(ch + ('a' - 'A')) : ch;
+}
+
+#if defined(U8STRING_SSE2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#ifdef U8STRING_SSE2
+/// \desc Gets the index of the lowest set bit of a mask that is not 0.
+static inline int LowestBit(uint32_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+/// \desc Gets the index of the highest set bit of a mask that is not 0.
+static inline int HighestBit(uint32_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return (int)index;
+#else
+    return 31 - __builtin_clz(mask);
+#endif
+}
+
+/// \desc Flips the case bit of the bytes that are letters from first to first + 25.
+static inline __m128i FlipCaseSse2(__m128i bytes, char first)
+{
+    //Bytes of 0x80 and above are negative so they are never in the range.
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8((char)(first - 1))),
+                                    _mm_cmplt_epi8(bytes, _mm_set1_epi8((char)(first + 26))));
+    return _mm_xor_si128(bytes, _mm_and_si128(letters, _mm_set1_epi8(0x20)));
+}
+
+/// \desc Gets a mask with a bit set for each byte that is in the set.
+static inline uint32_t InSetSse2(__m128i bytes, const char *set)
+{
+    __m128i found = _mm_setzero_si128();
+    for(; *set != '\0'; ++set)
     {
-        return false;
+        found = _mm_or_si128(found, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(*set)));
     }
+    return (uint32_t)_mm_movemask_epi8(found);
+}
 
-    if (Count() != strlen(string) )
+static int64_t FirstDifferenceSse2(const char *left, const char *right, int64_t len, bool ignoreCase)
+{
+    int64_t ii = 0;
+    for(; ii + 16 <= len; ii += 16)
     {
-        return false;
+        __m128i a = _mm_loadu_si128((const __m128i *)(left + ii));
+        __m128i b = _mm_loadu_si128((const __m128i *)(right + ii));
+        if ( ignoreCase )
+        {
+            a = FlipCaseSse2(a, 'A');
+            b = FlipCaseSse2(b, 'A');
+        }
+        if ( _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF )
+        {
+            break;
+        }
     }
+    return ii;
+}
 
-    for(int64_t ii=0; ii < Count(); ++ii)
+static int64_t FindTextSse2(const char *text, int64_t len, const char *pattern, int64_t patternLen, bool ignoreCase)
+{
+    __m128i first = _mm_set1_epi8(ignoreCase ? FoldByte(pattern[0]) : pattern[0]);
+    __m128i last = _mm_set1_epi8(ignoreCase ? FoldByte(pattern[patternLen - 1]) : pattern[patternLen - 1]);
+    int64_t ii = 0;
+    for(; ii + 16 + patternLen - 1 <= len; ii += 16)
     {
-        if (get(ii) > 127 ) //UTF8 below 128 is just a normal char
+        __m128i a = _mm_loadu_si128((const __m128i *)(text + ii));
+        __m128i b = _mm_loadu_si128((const __m128i *)(text + ii + patternLen - 1));
+        if ( ignoreCase )
         {
-            return false;
+            a = FlipCaseSse2(a, 'A');
+            b = FlipCaseSse2(b, 'A');
         }
-        if (get(ii) != string[ii])
+        auto candidates = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        if ( candidates != 0 )
         {
-            return false;
+            return ii + LowestBit(candidates);
         }
     }
+    return ii;
+}
 
-    return true;
+static void FlipCaseSse2(char *text, int64_t len, char first, int64_t &ii)
+{
+    for(; ii + 16 <= len; ii += 16)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(text + ii));
+        _mm_storeu_si128((__m128i *)(text + ii), FlipCaseSse2(bytes, first));
+    }
+}
+
+static int64_t SpanStartSse2(const char *text, int64_t len, const char *set)
+{
+    int64_t ii = 0;
+    for(; ii + 16 <= len; ii += 16)
+    {
+        uint32_t outside = InSetSse2(_mm_loadu_si128((const __m128i *)(text + ii)), set) ^ 0xFFFF;
+        if ( outside != 0 )
+        {
+            return ii + LowestBit(outside);
+        }
+    }
+    return ii;
+}
+
+static int64_t SpanEndSse2(const char *text, int64_t end, const char *set)
+{
+    for(; end >= 16; end -= 16)
+    {
+        uint32_t outside = InSetSse2(_mm_loadu_si128((const __m128i *)(text + end - 16)), set) ^ 0xFFFF;
+        if ( outside != 0 )
+        {
+            return end - 16 + HighestBit(outside) + 1;
+        }
+    }
+    return end;
+}
+#endif
+
+#ifdef U8STRING_AVX2
+/// \desc Checks once if the processor and operating system support AVX2.
+static bool HasAvx2()
+{
+    static bool hasAvx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") != 0);
+    return hasAvx2;
+}
+
+AVX2_TARGET static inline __m256i FlipCaseAvx2(__m256i bytes, char first)
+{
+    __m256i letters = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8((char)(first - 1))),
+                                       _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(first + 26)), bytes));
+    return _mm256_xor_si256(bytes, _mm256_and_si256(letters, _mm256_set1_epi8(0x20)));
+}
+
+AVX2_TARGET static inline uint32_t InSetAvx2(__m256i bytes, const char *set)
+{
+    __m256i found = _mm256_setzero_si256();
+    for(; *set != '\0'; ++set)
+    {
+        found = _mm256_or_si256(found, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(*set)));
+    }
+    return (uint32_t)_mm256_movemask_epi8(found);
+}
+
+AVX2_TARGET static int64_t FirstDifferenceAvx2(const char *left, const char *right, int64_t len, bool ignoreCase)
+{
+    int64_t ii = 0;
+    for(; ii + 32 <= len; ii += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(left + ii));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(right + ii));
+        if ( ignoreCase )
+        {
+            a = FlipCaseAvx2(a, 'A');
+            b = FlipCaseAvx2(b, 'A');
+        }
+        if ( (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) != 0xFFFFFFFF )
+        {
+            break;
+        }
+    }
+    return ii;
+}
+
+AVX2_TARGET static int64_t FindTextAvx2(const char *text, int64_t len, const char *pattern, int64_t patternLen, bool ignoreCase)
+{
+    __m256i first = _mm256_set1_epi8(ignoreCase ? FoldByte(pattern[0]) : pattern[0]);
+    __m256i last = _mm256_set1_epi8(ignoreCase ? FoldByte(pattern[patternLen - 1]) : pattern[patternLen - 1]);
+    int64_t ii = 0;
+    for(; ii + 32 + patternLen - 1 <= len; ii += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(text + ii));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(text + ii + patternLen - 1));
+        if ( ignoreCase )
+        {
+            a = FlipCaseAvx2(a, 'A');
+            b = FlipCaseAvx2(b, 'A');
+        }
+        auto candidates = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                                                          _mm256_cmpeq_epi8(b, last)));
+        if ( candidates != 0 )
+        {
+            return ii + LowestBit(candidates);
+        }
+    }
+    return ii;
+}
+
+AVX2_TARGET static void FlipCaseAvx2(char *text, int64_t len, char first, int64_t &ii)
+{
+    for(; ii + 32 <= len; ii += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(text + ii));
+        _mm256_storeu_si256((__m256i *)(text + ii), FlipCaseAvx2(bytes, first));
+    }
+}
+
+AVX2_TARGET static int64_t SpanStartAvx2(const char *text, int64_t len, const char *set)
+{
+    int64_t ii = 0;
+    for(; ii + 32 <= len; ii += 32)
+    {
+        uint32_t outside = ~InSetAvx2(_mm256_loadu_si256((const __m256i *)(text + ii)), set);
+        if ( outside != 0 )
+        {
+            return ii + LowestBit(outside);
+        }
+    }
+    return ii;
+}
+
+AVX2_TARGET static int64_t SpanEndAvx2(const char *text, int64_t end, const char *set)
+{
+    for(; end >= 32; end -= 32)
+    {
+        uint32_t outside = ~InSetAvx2(_mm256_loadu_si256((const __m256i *)(text + end - 32)), set);
+        if ( outside != 0 )
+        {
+            return end - 32 + HighestBit(outside) + 1;
+        }
+    }
+    return end;
+}
+#endif
+
+/// \desc Gets the offset of the first byte that is different in two byte arrays.
+/// \param ignoreCase True if ASCII letters that only differ in case are the same.
+/// \return The offset or len if the bytes are the same.
+static int64_t FirstDifference(const char *left, const char *right, int64_t len, bool ignoreCase)
+{
+    int64_t ii = 0;
+#ifdef U8STRING_AVX2
+    if ( HasAvx2() )
+    {
+        ii = FirstDifferenceAvx2(left, right, len, ignoreCase);
+    }
+    else
+#endif
+    {
+#ifdef U8STRING_SSE2
+        ii = FirstDifferenceSse2(left, right, len, ignoreCase);
+#endif
+    }
+    for(; ii<len; ++ii)
+    {
+        if ( left[ii] != right[ii] && (!ignoreCase || FoldByte(left[ii]) != FoldByte(right[ii])) )
+        {
+            return ii;
+        }
+    }
+    return len;
+}
+
+/// \desc Finds bytes in a byte array. Blocks are checked for the first and last byte of the
+///       pattern at once and only positions where both match are compared.
+/// \return Offset of the first match or -1 if the pattern is not found.
+static int64_t FindText(const char *text, int64_t len, const char *pattern, int64_t patternLen, bool ignoreCase)
+{
+    if ( patternLen == 0 )
+    {
+        return 0;
+    }
+
+    char first = ignoreCase ? FoldByte(pattern[0]) : pattern[0];
+    int64_t ii = 0;
+    while( ii + patternLen <= len )
+    {
+#ifdef U8STRING_AVX2
+        if ( HasAvx2() )
+        {
+            ii += FindTextAvx2(text + ii, len - ii, pattern, patternLen, ignoreCase);
+        }
+        else
+#endif
+        {
+#ifdef U8STRING_SSE2
+            ii += FindTextSse2(text + ii, len - ii, pattern, patternLen, ignoreCase);
+#endif
+        }
+        if ( ii + patternLen > len )
+        {
+            break;
+        }
+        if ( (ignoreCase ? FoldByte(text[ii]) : text[ii]) == first
+             && FirstDifference(text + ii, pattern, patternLen, ignoreCase) == patternLen )
+        {
+            return ii;
+        }
+        ++ii;
+    }
+
+    return -1;
+}
+
+/// \desc Flips the case of the ASCII letters from first to first + 25.
+static void FlipCase(char *text, int64_t len, char first)
+{
+    int64_t ii = 0;
+#ifdef U8STRING_AVX2
+    if ( HasAvx2() )
+    {
+        FlipCaseAvx2(text, len, first, ii);
+    }
+    else
+#endif
+    {
+#ifdef U8STRING_SSE2
+        FlipCaseSse2(text, len, first, ii);
+#endif
+    }
+    for(; ii<len; ++ii)
+    {
+        if ( text[ii] >= first && text[ii] < first + 26 )
+        {
+            text[ii] = (char)(text[ii] ^ 0x20);
+        }
+    }
+}
+
+/// \desc Gets the number of bytes at the start of a byte array that are in a set.
+static int64_t SpanStart(const char *text, int64_t len, const char *set)
+{
+    int64_t ii = 0;
+#ifdef U8STRING_AVX2
+    if ( HasAvx2() )
+    {
+        ii = SpanStartAvx2(text, len, set);
+    }
+    else
+#endif
+    {
+#ifdef U8STRING_SSE2
+        ii = SpanStartSse2(text, len, set);
+#endif
+    }
+    while( ii < len && text[ii] != '\0' && strchr(set, text[ii]) != nullptr )
+    {
+        ++ii;
+    }
+    return ii;
+}
+
+/// \desc Gets the number of bytes at the end of a byte array that are in a set.
+static int64_t SpanEnd(const char *text, int64_t len, const char *set)
+{
+    int64_t end = len;
+#ifdef U8STRING_AVX2
+    if ( HasAvx2() )
+    {
+        end = SpanEndAvx2(text, len, set);
+    }
+    else
+#endif
+    {
+#ifdef U8STRING_SSE2
+        end = SpanEndSse2(text, len, set);
+#endif
+    }
+    while( end > 0 && text[end - 1] != '\0' && strchr(set, text[end - 1]) != nullptr )
+    {
+        --end;
+    }
+    return len - end;
+}
+
+bool U8String::IsEqual(U8String *u8String)
+{
+    if (u8String == nullptr)
+    {
+        return false;
+    }
+
+    if (u8String == this)
+    {
+        return true;
+    }
+
+    //Characters are always encoded the same way so equal strings have equal bytes.
+    if ( length != u8String->length )
+    {
+        return false;
+    }
+
+    return FirstDifference(text, u8String->text, length, false) == length;
+}
+
+uint32_t U8String::Hash()
+{
+    if ( hashed )
+    {
+        return hash;
+    }
+
+    uint32_t value = 0;
+    for (size_t ii = 0; ii < Count(); ++ii)
+    {
+        value += get(ii);
+        value += value << 10;
+        value ^= value >> 6;
+    }
+    value += value << 3;
+    value ^= value >> 11;
+    value += value << 15;
+
+    hash = value;
+    hashed = true;
+
+    return hash;
+}
+
+bool U8String::IsEqual(const char *string)
+{
+    if (string == nullptr)
+    {
+        return false;
+    }
+
+    if ( length != strlen(string) )
+    {
+        return false;
+    }
+
+    return FirstDifference(text, string, length, false) == length;
 }
 
 bool U8String::IsGreater(U8String *u8String)
@@ -67,14 +578,11 @@ bool U8String::IsGreater(U8String *u8String)
     size_t l2 = u8String->Count();
     if ( l1 == l2 )
     {
-        for(int64_t ii=0; ii<l1; ++ii)
-        {
-            if (get(ii) > u8String->get(ii))
-            {
-                return true;
-            }
-        }
-        return false;
+        //UTF8 bytes are ordered the same as the characters they encode so the first byte that
+        //is different orders the strings.
+        int64_t len = length < u8String->length ? length : u8String->length;
+        int64_t ii = FirstDifference(text, u8String->text, len, false);
+        return ii < len && (Byte)text[ii] > (Byte)u8String->text[ii];
     }
     else if ( l1 > l2 )
     {
@@ -95,14 +603,11 @@ bool U8String::IsLess(U8String *u8String)
     size_t l2 = u8String->Count();
     if ( l1 == l2 )
     {
-        for(int64_t ii=0; ii<l1; ++ii)
-        {
-            if (get(ii) < u8String->get(ii))
-            {
-                return true;
-            }
-        }
-        return false;
+        //UTF8 bytes are ordered the same as the characters they encode so the first byte that
+        //is different orders the strings.
+        int64_t len = length < u8String->length ? length : u8String->length;
+        int64_t ii = FirstDifference(text, u8String->text, len, false);
+        return ii < len && (Byte)text[ii] < (Byte)u8String->text[ii];
     }
     else if ( l1 < l2 )
     {
@@ -112,72 +617,135 @@ bool U8String::IsLess(U8String *u8String)
     return false;
 }
 
-bool U8String::push_back(u8chr ch)
+bool U8String::Reserve(int64_t bytes)
 {
-    if ( !buffer->push_back(ch) )
+    if ( bytes <= capacity )
     {
-        return false;
-    }
-    if ( !buffer->Set(Count(), U8_NULL_CHR) )
-    {
-        return false;
+        return true;
     }
 
-    if ( !ascii->push_back((char)ch) )
+    int64_t size = capacity * 2 > bytes ? capacity * 2 : bytes;
+    auto *tmp = (char *)malloc(size + 1);
+    if ( tmp == nullptr )
     {
+        PrintIssue(2505, true, false, "Failed to increase memory for string.");
         return false;
     }
-    if ( !ascii->Set(Count(), '\0') )
+    memcpy(tmp, text, length + 1);
+    if ( text != small )
     {
-        return false;
+        free(text);
     }
+    text = tmp;
+    capacity = size;
 
     return true;
 }
 
-bool U8String::push_back(U8String *u8String)
+bool U8String::AppendBytes(const char *bytes, int64_t len, int64_t characters)
 {
-    for(int64_t ii=0; ii< u8String->Count(); ++ii)
+    //The bytes can be this string's own text which is moved if the buffer grows.
+    int64_t own = bytes >= text && bytes <= text + length ? bytes - text : -1;
+    if ( !Reserve(length + len) )
+    {
+        return false;
+    }
+    if ( own >= 0 )
+    {
+        bytes = text + own;
+    }
+
+    if ( offsets != nullptr )
     {
-        if ( !push_back(u8String->get(ii)) )
+        if ( characters == len )
         {
-            return false;
+            for(int64_t ii=0; ii<len; ++ii)
+            {
+                offsets->push_back(length + ii);
+            }
+        }
+        else if ( characters == 1 )
+        {
+            offsets->push_back(length);
+        }
+        else
+        {
+            ClearOffsets();
         }
     }
 
+    memmove(text + length, bytes, len);
+    length += len;
+    count += characters;
+    text[length] = '\0';
+    hashed = false;
+
     return true;
 }
 
-U8String::U8String(const char *cString)
+bool U8String::BuildOffsets()
 {
-    buffer = new List<u8chr>();
-    ascii = new List<char>();
-    size_t length = strlen(cString);
+    if ( offsets != nullptr )
+    {
+        return true;
+    }
+
+    offsets = new List<int64_t>();
+    if ( !offsets->Reserve(count) )
+    {
+        return false;
+    }
     for(int64_t ii=0; ii<length; ++ii)
     {
-        if ( !push_back(cString[ii]) )
+        if ( !UTF8_IS_CONTINUATION((Byte)text[ii]) )
         {
-            //error handled in push_back.
-            return;
+            offsets->push_back(ii);
         }
     }
+
+    return true;
+}
+
+bool U8String::push_back(u8chr ch)
+{
+    char bytes[4];
+    int64_t len = EncodeCharacter(ch, bytes);
+
+    return AppendBytes(bytes, len, 1);
+}
+
+bool U8String::push_back(U8String *u8String)
+{
+    return AppendBytes(u8String->text, u8String->length, (int64_t)u8String->count);
+}
+
+U8String::U8String(const char *cString)
+{
+    Initialize();
+    Append(cString);
 }
 
 U8String::U8String(U8String *u8String)
 {
-    buffer = new List<u8chr>();
-    ascii = new List<char>();
-    auto count = (int64_t) u8String->Count();
-    for(int64_t ii=0; ii<count; ++ii)
-    {
-        push_back(u8String->get(ii));
-    }
+    Initialize();
+    AppendBytes(u8String->text, u8String->length, u8String->count);
 }
 
 bool U8String::CopyFromCString(const char *cString)
 {
     Clear();
 
+    auto len = (int64_t)strlen(cString);
+    int64_t ii = 0;
+    while( ii < len && (Byte)cString[ii] < 0x80 )
+    {
+        ++ii;
+    }
+    if ( ii == len )
+    {
+        return AppendBytes(cString, len, len);
+    }
+
     //convert cString (char *null terminated) to a UTF8 string null terminated.
     Byte *pIn = (Byte *)cString;
     u8chr ch;
@@ -232,74 +800,121 @@ bool U8String::CopyFromDouble(double d)
 
 u8chr U8String::get(size_t index)
 {
-    if (index < Count())
+    if ( index >= Count() )
+    {
+        return U8_NULL_CHR;
+    }
+    if ( IsAscii() )
     {
-        return buffer->get((int64_t) index);
+        return (Byte)text[index];
     }
+    if ( !BuildOffsets() )
+    {
+        return U8_NULL_CHR;
+    }
+
+    u8chr ch;
+    DecodeCharacter(text + offsets->At((int64_t)index), &ch);
 
-    return U8_NULL_CHR;
+    return ch;
 }
 
 bool U8String::set(size_t index, u8chr ch)
 {
-    if ( !buffer->Set(index, ch) )
+    if ( index == Count() )
     {
-        return false;
+        return push_back(ch);
     }
-    if ( !buffer->Set(index+1, U8_NULL_CHR) )
+    if ( index > Count() )
     {
         return false;
     }
-    if ( !ascii->Set(index, (char)ch) )
+
+    int64_t start = (int64_t)index;
+    if ( !IsAscii() )
     {
-        return false;
+        if ( !BuildOffsets() )
+        {
+            return false;
+        }
+        start = offsets->At((int64_t)index);
     }
+    u8chr old;
+    int64_t oldLen = DecodeCharacter(text + start, &old);
+    char bytes[4];
+    int64_t len = EncodeCharacter(ch, bytes);
 
-    if ( !ascii->Set(index+1, '\0') )
+    if ( len != oldLen )
     {
-        return false;
+        if ( !Reserve(length + len - oldLen) )
+        {
+            return false;
+        }
+        memmove(text + start + len, text + start + oldLen, length - start - oldLen + 1);
+        length += len - oldLen;
+        ClearOffsets();
     }
+    memcpy(text + start, bytes, len);
+    hashed = false;
+
     return true;
 }
 
 int64_t U8String::IndexOf(u8chr ch)
 {
-   for(int64_t ii=0; ii < Count(); ++ii)
-   {
-       if (buffer->get(ii) == ch )
-       {
-           return ii;
-       }
-   }
+    if ( IsAscii() )
+    {
+        auto *found = ch < 0x80 ? (char *)memchr(text, (int)ch, length) : nullptr;
+        return found == nullptr ? -1 : found - text;
+    }
 
-   return -1;
+    char bytes[4];
+    int64_t found = FindText(text, length, bytes, EncodeCharacter(ch, bytes), false);
+
+    return found < 0 ? -1 : CharacterIndex(found);
 }
 
 bool U8String::Append(U8String *u8String)
 {
-    for(int ii=0; ii< u8String->Count(); ++ii)
-    {
-        if ( !push_back(u8String->get(ii)) )
-        {
-            return false;
-        }
-    }
-    return true;
+    return push_back(u8String);
 }
 
 bool U8String::Append(const char *cStr)
 {
-    char *ptr = (char *)cStr;
-    while( *ptr != '\0' )
+    return Append(cStr, (int64_t)strlen(cStr));
+}
+
+bool U8String::Append(const char *cStr, int64_t len)
+{
+    auto *bytes = (const Byte *)cStr;
+    int64_t start = 0;
+    int64_t characters = 0;
+    int64_t ii = 0;
+    while( ii < len )
     {
-        if (!push_back(*ptr) )
+        if ( bytes[ii] < 0x80 )
+        {
+            ++ii;
+            ++characters;
+            continue;
+        }
+        int64_t charLen = ValidCharacterLength(bytes + ii, len - ii);
+        if ( charLen > 0 )
+        {
+            ii += charLen;
+            ++characters;
+            continue;
+        }
+        if ( !AppendBytes(cStr + start, ii - start, characters) || !push_back(bytes[ii]) )
         {
             return false;
         }
-        ++ptr;
+        ++ii;
+        start = ii;
+        characters = 0;
     }
 
-    return true;
+    return AppendBytes(cStr + start, ii - start, characters);
 }
 
 bool U8String::Append(int64_t i)
@@ -309,15 +924,31 @@ bool U8String::Append(int64_t i)
     return push_back(&tmp);
 }
 
+bool U8String::GetBuffer(u8chr *data)
+{
+    for(int64_t ii=0; ii<length;)
+    {
+        ii += DecodeCharacter(text + ii, data++);
+    }
+
+    return true;
+}
+
 bool U8String::printf(bool append, char *format, ...)
 {
+    //Most text fits in the stack buffer so it only has to be formatted once.
+    char formatted[256];
     va_list length_args;
     va_start(length_args, format);
     va_list result_args;
     va_copy(result_args, length_args);
-    const auto length = vsnprintf(nullptr, 0U, format, length_args);
-    char *tmp = (char *)calloc(length+1, sizeof(char));
-    vsprintf((char *)tmp, format, result_args);
+    const auto length = vsnprintf(formatted, sizeof(formatted), format, length_args);
+    char *tmp = formatted;
+    if ( length >= (int)sizeof(formatted) )
+    {
+        tmp = (char *)calloc(length+1, sizeof(char));
+        vsprintf((char *)tmp, format, result_args);
+    }
     va_end(result_args);
     va_end(length_args);
 
@@ -330,7 +961,10 @@ bool U8String::printf(bool append, char *format, ...)
         CopyFromCString(tmp);
     }
 
-    free(tmp);
+    if ( tmp != formatted )
+    {
+        free(tmp);
+    }
 
     return true;
 }
@@ -341,6 +975,13 @@ bool U8String::CompareAt(const char *cString, bool ignoreCase, int64_t len, int6
     {
         return false;
     }
+    if ( IsAscii() && s + len <= length )
+    {
+        //A null in cString never matches a character so only the bytes before it are compared.
+        auto end = (const char *)memchr(cString, '\0', len);
+        int64_t compare = end == nullptr ? len : end - cString;
+        return FirstDifference(text + s, cString, compare, ignoreCase) == compare && compare == len;
+    }
     for(int64_t ii=0; ii<len; ++ii)
     {
         u8chr ch = get(s+ii);
@@ -364,36 +1005,89 @@ bool U8String::CompareAt(const char *cString, bool ignoreCase, int64_t len, int6
     return true;
 }
 
-int64_t U8String::IndexOf(U8String *u8String, bool ignoreCase)
+int64_t U8String::IndexOf(U8String *u8String, bool ignoreCase, int64_t start)
 {
-    auto s = (int64_t)0;
-    auto l = (int64_t)u8String->Count();
+    if ( start < 0 || start > Count() )
+    {
+        return -1;
+    }
+
+    int64_t offset = ByteOffset(start);
+    int64_t found = FindText(text + offset, length - offset, u8String->text, u8String->length, ignoreCase);
 
-    for(int64_t ii=0; ii<Count(); ++ii)
+    return found < 0 ? -1 : CharacterIndex(offset + found);
+}
+
+void U8String::ToLower()
+{
+    FlipCase(text, length, 'A');
+    hashed = false;
+}
+
+void U8String::ToUpper()
+{
+    FlipCase(text, length, 'a');
+    hashed = false;
+}
+
+int64_t U8String::SpanStart(const char *set)
+{
+    //The set is ASCII so each byte skipped is a character.
+    return ::SpanStart(text, length, set);
+}
+
+int64_t U8String::SpanEnd(const char *set)
+{
+    return ::SpanEnd(text, length, set);
+}
+
+bool U8String::CopyFrom(U8String *u8String, int64_t start, int64_t characters)
+{
+    Clear();
+    if ( start < 0 || characters <= 0 || start >= u8String->Count() )
     {
-        u8chr ch = get(ii);
-        u8chr ch1 = u8String->get(s);
+        return true;
+    }
+    if ( characters > u8String->Count() - start )
+    {
+        characters = u8String->Count() - start;
+    }
 
-        if ( ignoreCase )
-        {
-            ch = tolower((int)ch);
-            ch1 = tolower((int)ch1);
-        }
-        if ( ch == ch1 )
-        {
-            s++;
-            if ( s == l)
-            {
-                return true;
-            }
-        }
-        else
-        {
-            s = 0;
-        }
+    int64_t offset = u8String->ByteOffset(start);
+    int64_t end = u8String->ByteOffset(start + characters);
+
+    return AppendBytes(u8String->text + offset, end - offset, characters);
+}
+
+int64_t U8String::ByteOffset(int64_t index)
+{
+    if ( IsAscii() || index >= Count() )
+    {
+        return index >= Count() ? length : index;
+    }
+    if ( !BuildOffsets() )
+    {
+        return length;
     }
 
-    return true;
+    return offsets->At(index);
+}
+
+int64_t U8String::CharacterIndex(int64_t offset)
+{
+    if ( IsAscii() )
+    {
+        return offset;
+    }
+
+    //Counts the bytes that start characters, continuation bytes are 10xxxxxx.
+    int64_t index = 0;
+    for(int64_t ii=0; ii<offset; ++ii)
+    {
+        index += ((Byte)text[ii] & 0xC0) != 0x80;
+    }
+
+    return index;
 }
 
 bool U8String::fwrite(const char *file, bool isAscii)
@@ -403,13 +1097,16 @@ bool U8String::fwrite(const char *file, bool isAscii)
     {
         return false;
     }
-    if ( isAscii )
+    if ( isAscii && !IsAscii() )
     {
-        ::fwrite(ascii->Array(), ascii->Count(), 1, fp);
+        for(int64_t ii=0; ii<Count(); ++ii)
+        {
+            fputc((char)get(ii), fp);
+        }
     }
     else
     {
-        ::fwrite(buffer->Array(), buffer->Count(), 1, fp);
+        ::fwrite(text, length, 1, fp);
     }
 
     fclose(fp);
@@ -438,12 +1135,7 @@ bool U8String::fread(const char *file, bool isAscii)
     }
     else
     {
-        int64_t dwordLen = (int64_t)len/4;
-        auto *p1 = (int32_t *)tmp;
-        for(int64_t ii=0; ii<dwordLen; ++ii)
-        {
-            push_back(p1[ii]);
-        }
+        Append((const char *)tmp);
     }
 
     free(tmp);
@@ -143,7 +143,14 @@ const char *tokenNames[] =
     "COLON",
     "INVALID_EXPRESSION",
     "EVENT_RETURN",
-    "COMPONENT"
+    "COMPONENT",
+    "FOREACH",
+    "FOREACH_COND_BEGIN",
+    "FOREACH_COND_END",
+    "FOREACH_KEY",
+    "FOREACH_VALUE",
+    "FOREACH_BLOCK_BEGIN",
+    "FOREACH_BLOCK_END"
 };
 
 /// \desc Displays the token type along with its index and _n.
@@ -181,6 +188,14 @@ enum CMD_ARGS
     , OutputFile     = 19
     , Assembly       = 20
     , SymbolFileName = 21
+    , EngineZero     = 22
+    , EngineOne      = 23
+    , CallDepth      = 24
+    , EventInterval  = 25
+    , RealTime       = 26
+    , VirtualTime    = 27
+    , MaxSpeed       = 28
+    , TickRate       = 29
 };
 
 /// \desc parses the input string and returns the command line argument.
@@ -205,6 +220,9 @@ CMD_ARGS GetCommand(char *arg)
         case 'a':
         case 'A':
             return Assembly;
+        case 'c':
+        case 'C':
+            return CallDepth;
         case 's':
         case 'S':
             return SymbolFileName;
@@ -224,9 +242,29 @@ CMD_ARGS GetCommand(char *arg)
                 case '2':
                     return DisplayArgTwo;
             }
+        case 'e':
+        case 'E':
+            if (len < 3)
+            {
+                return EngineZero;
+            }
+            switch (arg[2])
+            {
+                default:
+                case '0':
+                    return EngineZero;
+                case '1':
+                    return EngineOne;
+            }
+        case 'f':
+        case 'F':
+            return TickRate;
         case 'h':
         case 'H':
             return HelpArg;
+        case 'i':
+        case 'I':
+            return EventInterval;
         case 'l':
         case 'L':
 
@@ -287,6 +325,22 @@ CMD_ARGS GetCommand(char *arg)
                 case '1':
                     return TraceOne;
             }
+        case 'v':
+        case 'V':
+            if (len < 3)
+            {
+                return VirtualTime;
+            }
+            switch (arg[2])
+            {
+                default:
+                case '0':
+                    return RealTime;
+                case '1':
+                    return VirtualTime;
+                case '2':
+                    return MaxSpeed;
+            }
         case 'w':
         case 'W':
             if (len < 3)
@@ -318,13 +372,15 @@ void Help()
     printf("Note:   Command lines options are not case sensitive.\n");
     printf("Note:   Any command line entry that is not an option is considered to be a script file.\n");
     printf("--------------------------------------defaults---------------------------------------\n");
-    printf("default -d0 -l0 -p0 -r0 -t0 -w3\n");
+    printf("default -d0 -e0 -l0 -p0 -r0 -t0 -v0 -w3\n");
     printf("display off, Run time, lexer, parser, trace information are not displayed.\n");
     printf("Warning Treated as error.\n");
     printf("---------------------------------------options---------------------------------------\n");
     printf("-d0     Do not display the time the script takes to run. Default option.\n");
     printf("-d1     Display the time the script takes to run in seconds.\n");
     printf("-d2     Display the time the script takes to run in milliseconds.\n");
+    printf("-e0     Run with the switch dispatch engine. Default option.\n");
+    printf("-e1     Run with the direct threaded dispatch engine, GCC and Clang builds only.\n");
     printf("-h      This help page.\n");
     printf("-l0     Hide lexer token output. Default option.\n");
     printf("-l1     Show lexer token output.\n");
@@ -338,11 +394,19 @@ void Help()
     printf("-s1     Strict mode. Variables cannot be promoted to collections.\n");
     printf("-t0     No trace information. Default option.\n");
     printf("-t1     Run time trace information.\n");
+    printf("-v0     On tick events use the real time clock. Default option.\n");
+    printf("-v1     On tick events use a simulated clock that advances one tick per event check,\n");
+    printf("        throttled to real time. Runs are reproducible.\n");
+    printf("-v2     Same as -v1 but the simulated clock runs as fast as the program.\n");
     printf("-w0     Ignore all warnings.\n");
     printf("-w1     Ignore informational warnings.\n");
     printf("-w2     Show all warnings.\n");
     printf("-w3     Warnings are treated as errors. Default option.\n");
     printf("-a      Show disassembly.\n");
+    printf("-c n    Set the maximum script function call depth, default is %d.\n", DEFAULT_MAX_CALL_DEPTH);
+    printf("-i n    Set the number of jumps and calls run between on tick timer checks, default is %d.\n",
+           EVENT_CHECK_INTERVAL);
+    printf("-f n    Set the number of on tick events per second, default is %d.\n", TICKS_PER_SECOND);
     printf("-o name Set output program file, Default is output.il\n");
     printf("-s name Set output symbol file, needed for debugger, default output.sym. Setting the\n");
     printf("        symbol file to "" will prevent it from being written. This is commonly known as\n");
@@ -437,10 +501,17 @@ void Serialize(BinaryFileWriter *file)
                     file->AddInt(dslValue->cases[tt]->location);
                 }
                 break;
-            case DCS:
+            case DCS: case ITK: case ITV:
                 file->AddInt(dslValue->operand);
                 file->AddInt(dslValue->iValue);
                 break;
+            case ITS:
+                file->AddInt(dslValue->operand);
+                break;
+            case ITN:
+                file->AddInt(dslValue->operand);
+                file->AddInt(dslValue->location);
+                break;
             case CID:
                 file->AddInt(dslValue->moduleId);
                 break;
@@ -459,6 +530,14 @@ void Serialize(BinaryFileWriter *file)
                     file->AddString(&dslValue->component->slots[tt]->color);
                     file->AddString(&dslValue->component->slots[tt]->variable);
                 }
+                file->AddInt(dslValue->location);
+                break;
+            case AVI: case AVV: case SVI: case LOI: case CVI: case CVV: case CLI:
+            case ADD_II: case SUB_II: case MUL_II: case TEQ_II: case TNE_II: case TGR_II: case TGE_II:
+            case TLS_II: case TLE_II: case ADD_DD: case SUB_DD: case MUL_DD: case DIV_DD: case TEQ_DD:
+            case TNE_DD: case TGR_DD: case TGE_DD: case TLS_DD: case TLE_DD:
+                //Fused and quickened instructions are only created by the CPU, when it loads
+                //and runs the program.
                 break;
         }
     }
@@ -505,6 +584,12 @@ int main(int argc, char *argv[])
     int64_t runLevel = 0;
     int64_t displayLevel    = 0;
     bool    displayAssembly = false;
+    bool    threadedDispatch = false;
+    int64_t maxCallDepth    = DEFAULT_MAX_CALL_DEPTH;
+    int64_t eventInterval   = EVENT_CHECK_INTERVAL;
+    int64_t ticksPerSecond  = TICKS_PER_SECOND;
+    bool    virtualTime     = false;
+    bool    maxSpeed        = false;
 
     outputFile.CopyFromCString("output.il");
     symbolFile.CopyFromCString("output.sym");
@@ -600,6 +685,51 @@ int main(int argc, char *argv[])
             case Assembly:
                 displayAssembly = true;
                 break;
+            case EngineZero:
+                threadedDispatch = false;
+                break;
+            case EngineOne:
+                threadedDispatch = true;
+                break;
+            case CallDepth:
+                if ( ii + 1 >= argc || atoll(argv[ii + 1]) < 1 )
+                {
+                    Help();
+                    return -7;
+                }
+                ++ii;
+                maxCallDepth = atoll(argv[ii]);
+                break;
+            case EventInterval:
+                if ( ii + 1 >= argc || atoll(argv[ii + 1]) < 0 )
+                {
+                    Help();
+                    return -8;
+                }
+                ++ii;
+                eventInterval = atoll(argv[ii]);
+                break;
+            case RealTime:
+                virtualTime = false;
+                maxSpeed = false;
+                break;
+            case VirtualTime:
+                virtualTime = true;
+                maxSpeed = false;
+                break;
+            case MaxSpeed:
+                virtualTime = true;
+                maxSpeed = true;
+                break;
+            case TickRate:
+                if ( ii + 1 >= argc || atoll(argv[ii + 1]) < 1 )
+                {
+                    Help();
+                    return -9;
+                }
+                ++ii;
+                ticksPerSecond = atoll(argv[ii]);
+                break;
         }
     }
 
@@ -700,12 +830,22 @@ int main(int argc, char *argv[])
     {
         auto *cpu = new CPU();
 
-        cpu->Init(&outputFile, &symbolFile);
+        if ( !cpu->Init(&outputFile, &symbolFile) )
+        {
+            delete cpu;
+            return -1;
+        }
+        cpu->threadedDispatch = threadedDispatch;
+        cpu->maxCallDepth = maxCallDepth;
+        cpu->eventCheckInterval = eventInterval;
+        cpu->ticksPerSecond = ticksPerSecond;
+        cpu->virtualTime = virtualTime;
+        cpu->maxSpeed = maxSpeed;
 
         if ( displayAssembly )
         {
             printf("\n<<<< IL Assembly Code >>>>\n");
-            CPU::DisplayASMCodeLines(program);
+            cpu->DisplayASMCodeLines();
         }
 
         double start = (double)clock()/(double)CLOCKS_PER_SEC;
@@ -721,6 +861,8 @@ int main(int argc, char *argv[])
                 break;
             case 2:
                 printf("\nRun Time : %f\n", (end - start) * 1000);
+                printf("Event Checks : %lld\n", (long long)cpu->eventChecks);
+                printf("Simulated Time : %f\n", (double)cpu->simulatedTime / 1000000000.0);
                 break;
         }
 
@@ -733,9 +875,13 @@ int main(int argc, char *argv[])
     {
         //Assembly requested without running the program requested.
         auto *cpu = new CPU();
-        cpu->Init(&outputFile, &symbolFile);
+        if ( !cpu->Init(&outputFile, &symbolFile) )
+        {
+            delete cpu;
+            return -1;
+        }
         printf("\n<<<< IL Assembly Code >>>>\n");
-        CPU::DisplayASMCodeLines(program);
+        cpu->DisplayASMCodeLines();
         delete cpu;
     }
 
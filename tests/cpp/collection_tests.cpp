@@ -0,0 +1,635 @@
+#include <cstdio>
+#include <ctime>
+#include "../../Includes/DslValue.h"
+#include "../../Includes/ParseData.h"
+
+/// \desc The collection table used before the open addressing table, 512 buckets that are each a
+///       list of keys. Only used to compare memory and lookups with Collection.
+class BucketCollection
+{
+public:
+    ~BucketCollection()
+    {
+        for(auto & bucket : buckets)
+        {
+            for(int64_t ii=0; ii<bucket.Count(); ++ii)
+            {
+                delete bucket[ii];
+            }
+        }
+    }
+
+    bool Set(U8String *key, void *data)
+    {
+        List<KeyData *> *bucket = &buckets[HashFunction(key)];
+        for(int64_t ii=0; ii<bucket->Count(); ++ii)
+        {
+            if ( (*bucket)[ii]->Key()->IsEqual(key) )
+            {
+                (*bucket)[ii]->Data(data);
+                return true;
+            }
+        }
+        auto *keyData = new KeyData(key, keys.Count(), data);
+        return bucket->push_back(keyData) && keys.push_back(keyData->Key());
+    }
+
+    KeyData *Get(U8String *key)
+    {
+        List<KeyData *> *bucket = &buckets[HashFunction(key)];
+        for(int64_t ii=0; ii<bucket->Count(); ++ii)
+        {
+            if ( (*bucket)[ii]->Key()->IsEqual(key) )
+            {
+                return (*bucket)[ii];
+            }
+        }
+        return nullptr;
+    }
+
+    /// \desc Bytes used counted the same way as CollectionTable::Bytes.
+    int64_t Bytes()
+    {
+        int64_t bytes = sizeof(BucketCollection) + keys.Size() * (int64_t)sizeof(U8String *) +
+                        keys.Count() * (int64_t)(sizeof(KeyData) + sizeof(U8String));
+        for(auto & bucket : buckets)
+        {
+            bytes += bucket.Size() * (int64_t)sizeof(KeyData *);
+        }
+        return bytes;
+    }
+
+private:
+    static uint32_t HashFunction(U8String *key)
+    {
+        uint32_t hash = 0;
+        for (int64_t ii = 0; ii < key->Count(); ++ii)
+        {
+            hash += key->get(ii);
+            hash += hash << 10;
+            hash ^= hash >> 6;
+        }
+        hash += hash << 3;
+        hash ^= hash >> 11;
+        hash += hash << 15;
+
+        return hash % 512;
+    }
+
+    List<KeyData *> buckets[512];
+    List<U8String *> keys;
+};
+
+/// \desc Creates the keys name.0, name.1, ...
+static U8String *MakeKeys(int64_t total)
+{
+    auto *keys = new U8String[total];
+    for(int64_t ii=0; ii<total; ++ii)
+    {
+        keys[ii].CopyFromCString("name.");
+        keys[ii].Append(ii);
+    }
+    return keys;
+}
+
+/// \desc Creates a collection of integer elements with the keys name.0, name.1, ...
+/// \param collection DslValue that receives the collection.
+/// \param elements Number of elements, element ii has the value ii.
+static void MakeCollection(DslValue *collection, int64_t elements)
+{
+    collection->type = COLLECTION;
+    collection->variableScriptName.CopyFromCString("name");
+    for(int64_t ii=0; ii<elements; ++ii)
+    {
+        U8String key;
+        key.CopyFromCString("name.");
+        key.Append(ii);
+        collection->indexes.Set(&key, new DslValue(ii));
+    }
+}
+
+/// \desc Gets an element of a collection by the order it was added in.
+static DslValue *Element(DslValue *collection, int64_t index)
+{
+    return (DslValue *)collection->indexes.Get(collection->indexes.Key(index))->Data();
+}
+
+bool CopySharesElements()
+{
+    total_run++;
+    printf("Copy shares elements test.\n");
+
+    DslValue a;
+    MakeCollection(&a, 3);
+    DslValue b;
+    b.SAV(&a);
+
+    if ( !a.indexes.IsShared() || b.indexes.Count() != 3 || Element(&b, 2)->iValue != 2 )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool SetDetachesCopy()
+{
+    total_run++;
+    printf("Set detaches copy test.\n");
+
+    DslValue a;
+    MakeCollection(&a, 3);
+    DslValue b;
+    b.SAV(&a);
+
+    b.indexes.Set(a.indexes.Key(0), new DslValue((int64_t)9));
+    U8String key("name.3");
+    b.indexes.Set(&key, new DslValue((int64_t)3));
+
+    if ( a.indexes.IsShared() || b.indexes.IsShared() || a.indexes.Count() != 3 ||
+         Element(&a, 0)->iValue != 0 || Element(&b, 0)->iValue != 9 || b.indexes.Count() != 4 )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool ChangeElementsOfCopy()
+{
+    total_run++;
+    printf("Change elements of copy test.\n");
+
+    DslValue a;
+    MakeCollection(&a, 3);
+    DslValue b;
+    b.SAV(&a);
+
+    DslValue five((int64_t)5);
+    b.ADD(&five);
+    b.INC();
+
+    for(int64_t ii=0; ii<3; ++ii)
+    {
+        if ( Element(&a, ii)->iValue != ii || Element(&b, ii)->iValue != ii + 6 )
+        {
+            total_failed++;
+            return false;
+        }
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool NestedCopyOnWrite()
+{
+    total_run++;
+    printf("Nested copy on write test.\n");
+
+    DslValue a;
+    MakeCollection(&a, 2);
+    auto *inner = new DslValue();
+    MakeCollection(inner, 2);
+    U8String key("inner");
+    a.indexes.Set(&key, inner);
+
+    DslValue b;
+    b.SAV(&a);
+
+    //Changing the outer collection copies its elements, the inner collection stays shared.
+    b.indexes.Detach();
+    auto *innerCopy = (DslValue *)b.indexes.Get(&key)->Data();
+    if ( innerCopy == inner || !inner->indexes.IsShared() )
+    {
+        total_failed++;
+        return false;
+    }
+
+    innerCopy->indexes.Detach();
+    Element(innerCopy, 1)->iValue = 100;
+    if ( Element(inner, 1)->iValue != 1 || inner->indexes.IsShared() )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool CopyLargeCollection()
+{
+    total_run++;
+    printf("Copy large collection test.\n");
+
+    int64_t elements = 10000;
+    int64_t copies = 1000;
+
+    DslValue a;
+    MakeCollection(&a, elements);
+
+    auto *values = new DslValue[copies];
+    double start = (double)clock()/(double)CLOCKS_PER_SEC;
+    for(int64_t ii=0; ii<copies; ++ii)
+    {
+        values[ii].SAV(&a);
+    }
+    double end = (double)clock()/(double)CLOCKS_PER_SEC;
+    printf("%lld copies of %lld elements : %f\n", copies, elements, end - start);
+
+    bool passed = values[copies-1].indexes.Count() == elements &&
+                  Element(&values[copies-1], elements-1)->iValue == elements-1;
+    delete []values;
+
+    if ( !passed || a.indexes.IsShared() )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool KeepInsertionOrder()
+{
+    total_run++;
+    printf("Keep insertion order test.\n");
+
+    int64_t total = 1000;
+    U8String *keys = MakeKeys(total);
+    Collection collection;
+
+    //Added backwards so the order differs from any order the hash would give.
+    for(int64_t ii=total-1; ii>=0; --ii)
+    {
+        collection.Set(&keys[ii], &keys[ii]);
+    }
+    collection.Remove(&keys[total-1]);
+    collection.Set(&keys[total/2], nullptr);
+
+    bool passed = collection.Count() == total - 1;
+    for(int64_t ii=0; ii<collection.Count() && passed; ++ii)
+    {
+        KeyData *keyData = collection.Get(&keys[total-2-ii]);
+        passed = keyData == collection.Entry(ii) && keyData->KeyIndex() == ii &&
+                 collection.Key(ii)->IsEqual(&keys[total-2-ii]);
+    }
+    passed = passed && !collection.Exists(&keys[total-1]) && collection.Get(&keys[total/2])->Data() == nullptr;
+    delete []keys;
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool CollectionMemory()
+{
+    total_run++;
+    printf("Collection memory test.\n");
+
+    int64_t sizes[] = { 0, 1, 8, 9, 100, 10000 };
+    U8String *keys = MakeKeys(10000);
+
+    bool passed = true;
+    for(int64_t size : sizes)
+    {
+        Collection collection;
+        auto *buckets = new BucketCollection();
+        for(int64_t ii=0; ii<size; ++ii)
+        {
+            collection.Set(&keys[ii]);
+            buckets->Set(&keys[ii], nullptr);
+        }
+        printf("%lld keys : collection %lld bytes, buckets %lld bytes\n",
+               size, collection.Bytes(), buckets->Bytes());
+        passed = passed && collection.Bytes() < buckets->Bytes();
+        delete buckets;
+    }
+    delete []keys;
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool CollectionLookup()
+{
+    total_run++;
+    printf("Collection lookup test.\n");
+
+    int64_t sizes[] = { 4, 8, 100, 10000, 100000 };
+    int64_t lookups = 1000000;
+    U8String *keys = MakeKeys(100000);
+
+    bool passed = true;
+    for(int64_t size : sizes)
+    {
+        Collection collection;
+        auto *buckets = new BucketCollection();
+        for(int64_t ii=0; ii<size; ++ii)
+        {
+            collection.Set(&keys[ii], &keys[ii]);
+            buckets->Set(&keys[ii], &keys[ii]);
+        }
+
+        double start = (double)clock()/(double)CLOCKS_PER_SEC;
+        for(int64_t ii=0; ii<lookups; ++ii)
+        {
+            passed = passed && collection.Get(&keys[ii % size])->Data() == &keys[ii % size];
+        }
+        double middle = (double)clock()/(double)CLOCKS_PER_SEC;
+        for(int64_t ii=0; ii<lookups; ++ii)
+        {
+            passed = passed && buckets->Get(&keys[ii % size])->Data() == &keys[ii % size];
+        }
+        double end = (double)clock()/(double)CLOCKS_PER_SEC;
+        printf("%lld lookups in %lld keys : collection %f, buckets %f\n",
+               lookups, size, middle - start, end - middle);
+        delete buckets;
+    }
+    delete []keys;
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool AppendByPosition()
+{
+    total_run++;
+    printf("Append by position test.\n");
+
+    int64_t total = 1000;
+    U8String *keys = MakeKeys(total);
+    Collection collection;
+
+    for(int64_t ii=0; ii<total/2; ++ii)
+    {
+        collection.Append(&keys[ii], &keys[ii]);
+    }
+
+    //Searching by key indexes the appended keys, keys appended after that are indexed as added.
+    bool passed = collection.Get(&keys[total/4])->Data() == &keys[total/4];
+    for(int64_t ii=total/2; ii<total; ++ii)
+    {
+        collection.Append(&keys[ii], &keys[ii]);
+    }
+    collection.Append(&keys[0], nullptr);
+
+    passed = passed && collection.Count() == total && collection.Entry(0)->Data() == nullptr;
+    for(int64_t ii=1; ii<total && passed; ++ii)
+    {
+        passed = collection.Entry(ii)->Data() == &keys[ii] && collection.Get(&keys[ii]) == collection.Entry(ii);
+    }
+    delete []keys;
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool IndexByPosition()
+{
+    total_run++;
+    printf("Index by position test.\n");
+
+    int64_t total = 10000;
+    int64_t lookups = 1000000;
+    U8String *keys = MakeKeys(total);
+
+    Collection collection;
+    for(int64_t ii=0; ii<total; ++ii)
+    {
+        collection.Append(&keys[ii], &keys[ii]);
+    }
+
+    bool passed = true;
+    double start = (double)clock()/(double)CLOCKS_PER_SEC;
+    for(int64_t ii=0; ii<lookups; ++ii)
+    {
+        passed = passed && collection.Entry(ii % total)->Data() == &keys[ii % total];
+    }
+    double middle = (double)clock()/(double)CLOCKS_PER_SEC;
+    for(int64_t ii=0; ii<lookups; ++ii)
+    {
+        passed = passed && collection.Get(collection.Key(ii % total))->Data() == &keys[ii % total];
+    }
+    double end = (double)clock()/(double)CLOCKS_PER_SEC;
+    printf("%lld lookups in %lld elements : by position %f, by key %f\n",
+           lookups, total, middle - start, end - middle);
+    delete []keys;
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool InternKeys()
+{
+    total_run++;
+    printf("Intern keys test.\n");
+
+    int64_t total = 100;
+    U8String *keys = MakeKeys(total);
+    Collection first;
+    Collection second;
+
+    for(int64_t ii=0; ii<total; ++ii)
+    {
+        first.Set(&keys[ii], &keys[ii]);
+        second.Set(first.Entry(ii));
+    }
+
+    //Equal keys share one symbol and the symbol finds the key without comparing its text.
+    bool passed = second.Count() == total;
+    for(int64_t ii=0; ii<total && passed; ++ii)
+    {
+        Symbol *symbol = SymbolTable::Intern(&keys[ii]);
+        passed = symbol == first.Entry(ii)->KeySymbol() && symbol == second.Entry(ii)->KeySymbol()
+                 && first.Get(symbol) == first.Entry(ii) && second.Get(symbol)->Data() == &keys[ii]
+                 && symbol->hash == keys[ii].Hash();
+        SymbolTable::Release(symbol);
+    }
+    U8String missing("missing key");
+    Symbol *missingSymbol = SymbolTable::Intern(&missing);
+    passed = passed && first.Get(missingSymbol) == nullptr;
+    SymbolTable::Release(missingSymbol);
+    delete []keys;
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool LookupBySymbol()
+{
+    total_run++;
+    printf("Lookup by symbol test.\n");
+
+    int64_t total = 10000;
+    int64_t lookups = 1000000;
+    U8String *keys = MakeKeys(total);
+    auto **symbols = new Symbol *[total];
+
+    Collection collection;
+    for(int64_t ii=0; ii<total; ++ii)
+    {
+        collection.Set(&keys[ii], &keys[ii]);
+        symbols[ii] = SymbolTable::Intern(&keys[ii]);
+    }
+
+    bool passed = true;
+    double start = (double)clock()/(double)CLOCKS_PER_SEC;
+    for(int64_t ii=0; ii<lookups; ++ii)
+    {
+        passed = passed && collection.Get(symbols[ii % total])->Data() == &keys[ii % total];
+    }
+    double middle = (double)clock()/(double)CLOCKS_PER_SEC;
+    for(int64_t ii=0; ii<lookups; ++ii)
+    {
+        passed = passed && collection.Get(&keys[ii % total])->Data() == &keys[ii % total];
+    }
+    double end = (double)clock()/(double)CLOCKS_PER_SEC;
+    printf("%lld lookups in %lld keys : by symbol %f, by text %f\n",
+           lookups, total, middle - start, end - middle);
+
+    //Copying the keys of a changed copy only copies their symbols.
+    Collection keysOnly;
+    for(int64_t ii=0; ii<total; ++ii)
+    {
+        keysOnly.Set(symbols[ii]);
+    }
+    Collection copy = keysOnly;
+    start = (double)clock()/(double)CLOCKS_PER_SEC;
+    copy.Detach();
+    end = (double)clock()/(double)CLOCKS_PER_SEC;
+    printf("Detach copy of %lld keys : %f\n", total, end - start);
+    passed = passed && copy.Entry(total-1)->KeySymbol() == symbols[total-1];
+
+    for(int64_t ii=0; ii<total; ++ii)
+    {
+        SymbolTable::Release(symbols[ii]);
+    }
+    delete []symbols;
+    delete []keys;
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool ReleaseSymbols()
+{
+    total_run++;
+    printf("Release symbols test.\n");
+
+    int64_t total = 5000;
+    auto *keys = new U8String[total];
+    for(int64_t ii=0; ii<total; ++ii)
+    {
+        keys[ii].CopyFromCString("released.");
+        keys[ii].Append(ii);
+    }
+    int64_t before = SymbolTable::Count();
+
+    auto *even = new Collection();
+    Collection odd;
+    for(int64_t ii=0; ii<total; ++ii)
+    {
+        (ii % 2 == 0 ? even : &odd)->Set(&keys[ii]);
+    }
+    Collection copy = odd;
+    copy.Detach();
+    bool passed = SymbolTable::Count() == before + total;
+
+    //Freeing the even keys removes their symbols, the odd keys are still found by their text.
+    delete even;
+    passed = passed && SymbolTable::Count() == before + total / 2;
+    for(int64_t ii=1; ii<total && passed; ii+=2)
+    {
+        Symbol *symbol = SymbolTable::Intern(&keys[ii]);
+        passed = symbol == odd.Get(&keys[ii])->KeySymbol() && symbol == copy.Get(&keys[ii])->KeySymbol();
+        SymbolTable::Release(symbol);
+    }
+
+    odd.Clear();
+    passed = passed && SymbolTable::Count() == before + total / 2;
+    copy.Clear();
+    passed = passed && SymbolTable::Count() == before;
+    delete []keys;
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool RunAllCollectionTests()
+{
+    total_passed = 0;
+    total_failed = 0;
+    total_run = 0;
+
+    CopySharesElements();
+    SetDetachesCopy();
+    ChangeElementsOfCopy();
+    NestedCopyOnWrite();
+    CopyLargeCollection();
+    KeepInsertionOrder();
+    CollectionMemory();
+    CollectionLookup();
+    AppendByPosition();
+    IndexByPosition();
+    InternKeys();
+    LookupBySymbol();
+    ReleaseSymbols();
+
+    printf("Total Collection Tests Run: %lld, Total Passed: %lld, Total Failed: %lld\n", total_run, total_passed, total_failed);
+
+    return true;
+}
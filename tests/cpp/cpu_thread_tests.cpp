@@ -0,0 +1,436 @@
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "../../Includes/CPU.h"
+#include "../../Includes/ComponentScheduler.h"
+#include "../../Includes/ComponentGraph.h"
+#include "../../Includes/ParseData.h"
+
+/// \desc Runs a compiled program on a new CPU and gets the value of one of its global variables.
+/// \param ilFile Compiled program to run.
+/// \param symFile Symbol file of the program, needed to find variables by name.
+/// \param variable Full name of the global variable, for example TMScriptScope.script.result.
+/// \param value Set to the integer value of the variable after the program ends.
+/// \return True if the program ran and the variable exists.
+static bool RunProgram(U8String *ilFile, U8String *symFile, const char *variable, int64_t &value)
+{
+    auto *cpu = new CPU();
+
+    DslValue *result = nullptr;
+    if ( cpu->Init(ilFile, symFile) && cpu->Run() )
+    {
+        result = cpu->FindVariable(variable);
+        if ( result != nullptr )
+        {
+            value = result->iValue;
+        }
+    }
+
+    delete cpu;
+    return result != nullptr;
+}
+
+/// \desc Runs the same compiled program on many CPUs from a pool of threads and checks every
+///       CPU ends with the same result as a single CPU. Use tests/dsl_scripts/cpu_thread_stress.dsl,
+///       it uses the random number generator and function calls so any state shared between
+///       CPUs changes the result.
+/// \param ilFile Compiled program to run.
+/// \param symFile Symbol file of the program.
+/// \param variable Full name of the global variable holding the result.
+/// \param cpus Number of CPUs to run.
+/// \param threads Number of threads in the pool.
+bool RunConcurrentCPUs(U8String *ilFile, U8String *symFile, const char *variable, int64_t cpus,
+                       int64_t threads)
+{
+    printf("Run %ld CPUs on %ld threads test.\n", (long)cpus, (long)threads);
+
+    total_run++;
+
+    int64_t expected = 0;
+    if ( !RunProgram(ilFile, symFile, variable, expected) )
+    {
+        total_failed++;
+        return false;
+    }
+
+    std::atomic<int64_t> next(0);
+    std::atomic<int64_t> failed(0);
+    List<std::thread *> pool;
+
+    for(int64_t ii=0; ii<threads; ++ii)
+    {
+        pool.push_back(new std::thread([&]()
+        {
+            for(int64_t job = next++; job < cpus; job = next++)
+            {
+                int64_t value = 0;
+                if ( !RunProgram(ilFile, symFile, variable, value) || value != expected )
+                {
+                    failed++;
+                }
+            }
+        }));
+    }
+
+    for(int64_t ii=0; ii<pool.Count(); ++ii)
+    {
+        pool[ii]->join();
+        delete pool[ii];
+    }
+
+    if ( failed != 0 )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+/// \desc Loads a compiled program once and runs it on many CPUs that share its code image from a
+///       pool of threads. Every CPU has its own global variables so each one must end with the
+///       same result as a CPU that loaded the program by itself.
+/// \param ilFile Compiled program to run.
+/// \param symFile Symbol file of the program.
+/// \param variable Full name of the global variable holding the result.
+/// \param cpus Number of CPUs to run.
+/// \param threads Number of threads in the pool.
+bool RunSharedImageCPUs(U8String *ilFile, U8String *symFile, const char *variable, int64_t cpus,
+                        int64_t threads)
+{
+    printf("Run %ld CPUs sharing one image on %ld threads test.\n", (long)cpus, (long)threads);
+
+    total_run++;
+
+    int64_t expected = 0;
+    auto *loader = new CPU();
+    if ( !RunProgram(ilFile, symFile, variable, expected) || !loader->Init(ilFile, symFile) )
+    {
+        delete loader;
+        total_failed++;
+        return false;
+    }
+
+    std::atomic<int64_t> next(0);
+    std::atomic<int64_t> failed(0);
+    List<std::thread *> pool;
+
+    for(int64_t ii=0; ii<threads; ++ii)
+    {
+        pool.push_back(new std::thread([&]()
+        {
+            for(int64_t job = next++; job < cpus; job = next++)
+            {
+                auto *cpu = new CPU();
+                DslValue *result = nullptr;
+                if ( cpu->Init(loader->Image()) && cpu->Run() )
+                {
+                    result = cpu->FindVariable(variable);
+                }
+                if ( result == nullptr || result->iValue != expected )
+                {
+                    failed++;
+                }
+                delete cpu;
+            }
+        }));
+    }
+
+    for(int64_t ii=0; ii<pool.Count(); ++ii)
+    {
+        pool[ii]->join();
+        delete pool[ii];
+    }
+
+    //The image is deleted with the last CPU using it.
+    delete loader;
+
+    if ( failed != 0 )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+/// \desc Runs the Step and Bump components of tests/dsl_scripts/component_scheduler.dsl on many
+///       CPUs for a number of frames with the component scheduler. Each frame adds 11 to every
+///       CPU's total so after the frames each total must be 11 times the number of frames.
+/// \param ilFile Compiled program to run.
+/// \param symFile Symbol file of the program.
+/// \param cpus Number of CPUs to run the components on.
+/// \param workers Number of scheduler worker threads.
+/// \param frames Number of frames to run.
+bool RunComponentFrames(U8String *ilFile, U8String *symFile, int64_t cpus, int64_t workers, int64_t frames)
+{
+    printf("Run components on %ld CPUs with %ld workers for %ld frames test.\n", (long)cpus,
+           (long)workers, (long)frames);
+
+    total_run++;
+
+    auto *loader = new CPU();
+    if ( !loader->Init(ilFile, symFile) )
+    {
+        delete loader;
+        total_failed++;
+        return false;
+    }
+
+    U8String step("TMScriptScope.component_scheduler.step");
+    U8String bump("TMScriptScope.component_scheduler.bump");
+    List<CPU *> cpuList;
+    auto *scheduler = new ComponentScheduler(workers);
+    bool passed = true;
+
+    for(int64_t ii=0; ii<cpus; ++ii)
+    {
+        auto *cpu = new CPU();
+        cpuList.push_back(cpu);
+        if ( !cpu->Init(loader->Image()) || !cpu->Run()
+             || scheduler->Add(cpu, &step) < 0 || scheduler->Add(cpu, &bump) < 0 )
+        {
+            passed = false;
+        }
+    }
+
+    for(int64_t ii=0; ii<frames && passed; ++ii)
+    {
+        scheduler->RunFrame();
+        for(int64_t tt=0; tt<scheduler->Jobs(); ++tt)
+        {
+            if ( !scheduler->Job(tt).ran || scheduler->Job(tt).worker < 0 )
+            {
+                passed = false;
+            }
+        }
+    }
+
+    for(int64_t ii=0; ii<cpuList.Count(); ++ii)
+    {
+        DslValue *total = cpuList[ii]->FindVariable("TMScriptScope.component_scheduler.total");
+        if ( total == nullptr || total->iValue != frames * 11 )
+        {
+            passed = false;
+        }
+    }
+
+    delete scheduler;
+    for(int64_t ii=0; ii<cpuList.Count(); ++ii)
+    {
+        delete cpuList[ii];
+    }
+    delete loader;
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+/// \desc Runs tests/dsl_scripts/component_graph.dsl as a component graph. Produce adds one to
+///       source each frame, Twice and Square run in parallel on the copies of source they get
+///       and Add combines their outputs, so after the frames Add's total must be
+///       2 * frames + frames * frames.
+/// \param ilFile Compiled program to run.
+/// \param symFile Symbol file of the program.
+/// \param workers Number of scheduler worker threads.
+/// \param frames Number of frames to run.
+bool RunComponentGraph(U8String *ilFile, U8String *symFile, int64_t workers, int64_t frames)
+{
+    printf("Run component graph with %ld workers for %ld frames test.\n", (long)workers, (long)frames);
+
+    total_run++;
+
+    auto *loader = new CPU();
+    auto *graph = new ComponentGraph(workers);
+    bool passed = loader->Init(ilFile, symFile) && graph->Init(loader->Image()) && graph->Nodes() == 4;
+
+    for(int64_t ii=0; ii<frames && passed; ++ii)
+    {
+        graph->RunFrame();
+    }
+
+    if ( passed )
+    {
+        DslValue *source = graph->Node(0)->FindVariable("TMScriptScope.component_graph.source");
+        DslValue *total = graph->Node(3)->FindVariable("TMScriptScope.component_graph.total");
+        passed = source != nullptr && source->iValue == frames
+                 && total != nullptr && total->iValue == 2 * frames + frames * frames;
+    }
+
+    delete graph;
+    delete loader;
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+/// \desc Checks components of tests/dsl_scripts/component_graph.dsl are found by their function
+///       and the component manifest is the same each time it is asked for, also from a CPU
+///       sharing the program's image.
+/// \param ilFile Compiled program.
+/// \param symFile Symbol file of the program.
+bool ComponentLookup(U8String *ilFile, U8String *symFile)
+{
+    printf("Component lookup and manifest test.\n");
+
+    total_run++;
+
+    const char *functions[] = { "TMScriptScope.component_graph.produce", "TMScriptScope.component_graph.twice",
+                                "TMScriptScope.component_graph.square", "TMScriptScope.component_graph.add" };
+
+    auto *cpu = new CPU();
+    auto *shared = new CPU();
+    bool passed = cpu->Init(ilFile, symFile) && shared->Init(cpu->Image());
+
+    for(int64_t ii=0; ii<4 && passed; ++ii)
+    {
+        U8String function(functions[ii]);
+        passed = cpu->FindComponent(&function) == ii;
+    }
+
+    U8String missing("TMScriptScope.component_graph.missing");
+    passed = passed && cpu->FindComponent(&missing) == -1 && !cpu->RunComponent(&missing);
+
+    U8String first;
+    U8String second;
+    if ( passed )
+    {
+        cpu->GetComponents(first);
+        shared->GetComponents(second);
+        U8String title("\"title\":\"Produce\"");
+        passed = first.IsEqual(&second) && first.Contains(&title);
+    }
+
+    delete shared;
+    delete cpu;
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+/// \desc Runs tests/dsl_scripts/on_tick.dsl with an on tick event after every 10 jumps and calls
+///       on the simulated clock and again with no on tick events. The handler interrupts Sum
+///       while its locals and the values of the expression calling it are on the stack, so both
+///       runs must end with the same results and the same top of stack.
+/// \param ilFile Compiled program to run.
+/// \param symFile Symbol file of the program.
+bool RunOnTickHandler(U8String *ilFile, U8String *symFile)
+{
+    printf("On tick handler restores the interrupted frame test.\n");
+
+    total_run++;
+
+    const char *variables[] = { "TMScriptScope.on_tick.first", "TMScriptScope.on_tick.second",
+                                "TMScriptScope.on_tick.ticks" };
+    int64_t values[2][3] = {};
+    int64_t tops[2] = {};
+    bool passed = true;
+
+    for(int64_t run=0; run<2 && passed; ++run)
+    {
+        auto *cpu = new CPU();
+        cpu->virtualTime = true;
+        cpu->maxSpeed = true;
+        cpu->eventCheckInterval = run == 0 ? INT64_MAX : 10;
+        passed = cpu->Init(ilFile, symFile) && cpu->Run();
+
+        for(int64_t ii=0; ii<3 && passed; ++ii)
+        {
+            DslValue *variable = cpu->FindVariable(variables[ii]);
+            passed = variable != nullptr;
+            if ( passed )
+            {
+                values[run][ii] = variable->iValue;
+            }
+        }
+        tops[run] = cpu->top;
+
+        delete cpu;
+    }
+
+    passed = passed && values[0][0] == 4950 && values[0][1] == 9910 && values[0][2] == 0
+             && values[1][0] == 4950 && values[1][1] == 9910 && values[1][2] > 0 && tops[0] == tops[1];
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+/// \desc Runs tests/dsl_scripts/on_tick.dsl on the simulated clock with an event check after every
+///       10 jumps and calls. Each check is one tick, so the handler must run the same number of
+///       times at any tick rate, throttled or not, and the simulated clock must have advanced one
+///       tick interval per handler call. A throttled run cannot end before its simulated time.
+/// \param ilFile Compiled program to run.
+/// \param symFile Symbol file of the program.
+bool RunVirtualClock(U8String *ilFile, U8String *symFile)
+{
+    printf("Virtual clock tick count test.\n");
+
+    total_run++;
+
+    const int64_t rates[] = { 10, 1000, 1000 };
+    const bool fast[] = { true, true, false };
+    int64_t ticks[3] = {};
+    bool passed = true;
+
+    for(int64_t run=0; run<3 && passed; ++run)
+    {
+        auto *cpu = new CPU();
+        cpu->virtualTime = true;
+        cpu->maxSpeed = fast[run];
+        cpu->ticksPerSecond = rates[run];
+        cpu->eventCheckInterval = 10;
+
+        auto start = std::chrono::steady_clock::now();
+        passed = cpu->Init(ilFile, symFile) && cpu->Run();
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+        DslValue *variable = passed ? cpu->FindVariable("TMScriptScope.on_tick.ticks") : nullptr;
+        passed = variable != nullptr && variable->iValue > 0
+                 && cpu->simulatedTime == variable->iValue * (1000000000LL / rates[run])
+                 && (fast[run] || elapsed.count() >= cpu->simulatedTime);
+        if ( passed )
+        {
+            ticks[run] = variable->iValue;
+        }
+
+        delete cpu;
+    }
+
+    passed = passed && ticks[0] == ticks[1] && ticks[1] == ticks[2];
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
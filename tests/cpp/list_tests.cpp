@@ -82,6 +82,39 @@ void CreateStringListElements(int64_t elements)
 }
 #pragma clang diagnostic pop
 
+/// \desc Pushes strings into a list of U8String until it grows several times. Short strings are
+///       kept inside the U8String, so the list must copy them and not move their bytes.
+void CreateU8StringListElements(int64_t elements)
+{
+    total_run++;
+    List<U8String> list;
+
+    char sz[64];
+    for(int64_t ii=0; ii<elements; ++ii)
+    {
+        snprintf(sz, sizeof(sz), ii % 7 == 0 ? "a longer string kept on the heap %ld" : "s%ld", (long)ii);
+        if ( !list.push_back(U8String(sz)) )
+        {
+            total_failed++;
+            return;
+        }
+    }
+
+    list.Remove(0);
+
+    for(int64_t ii=1; ii<elements; ++ii)
+    {
+        snprintf(sz, sizeof(sz), ii % 7 == 0 ? "a longer string kept on the heap %ld" : "s%ld", (long)ii);
+        if ( list.Count() != elements - 1 || !list[ii-1].IsEqual(sz) )
+        {
+            total_failed++;
+            return;
+        }
+    }
+
+    total_passed++;
+}
+
 [[maybe_unused]] void TestIntOne()
 {
     CreateIntListElements(1);
@@ -102,12 +135,37 @@ void CreateStringListElements(int64_t elements)
     CreateStringListElements(5000);
 }
 
+[[maybe_unused]] void TestU8StringGrow()
+{
+    CreateU8StringListElements(ALLOC_BLOCK_SIZE * 3);
+}
+
+/// \desc Reading outside the list raises a run time error in debug builds and gets an empty element.
+[[maybe_unused]] void TestAtOutside()
+{
+#ifndef NDEBUG
+    total_run++;
+    List<int64_t> list;
+    list.push_back(5);
+
+    if ( list.At(list.Size()) != 0 || list.At(-1) != 0 || list.At(0) != 5 )
+    {
+        total_failed++;
+        return;
+    }
+
+    total_passed++;
+#endif
+}
+
 [[maybe_unused]] bool RunAllListTests()
 {
     TestIntOne();
     TestIntLots();
     TestStringOne();
     TestStringLots();
+    TestU8StringGrow();
+    TestAtOutside();
 
     printf("Total List Tests Run: %d, Total Passed: %d, Total Failed: %d\n", total_run, total_passed, total_failed);
 
@@ -0,0 +1,258 @@
+#include <cstdio>
+#include <ctime>
+#include <cmath>
+#include "../../Includes/DslValue.h"
+#include "../../Includes/NumericArray.h"
+#include "../../Includes/ParseData.h"
+
+/// \desc Creates a collection of numbers with the keys name.0, name.1, ...
+/// \param collection DslValue that receives the collection.
+/// \param elements Number of elements, element ii has the value ii.
+/// \param type INTEGER_VALUE or DOUBLE_VALUE.
+static void MakeNumbers(DslValue *collection, int64_t elements, TokenTypes type)
+{
+    collection->type = COLLECTION;
+    collection->variableScriptName.CopyFromCString("name");
+    for(int64_t ii=0; ii<elements; ++ii)
+    {
+        U8String key;
+        key.CopyFromCString("name.");
+        key.Append(ii);
+        auto *element = new DslValue(ii);
+        element->Convert(type);
+        collection->indexes.Append(&key, element);
+    }
+}
+
+/// \desc Gets an element of a collection by the order it was added in.
+static DslValue *Number(DslValue *collection, int64_t index)
+{
+    return (DslValue *)collection->indexes.Entry(index)->Data();
+}
+
+/// \desc The element by element path DslValue::BinaryOperation used for collections before the
+///       vector loops, only used to compare times with NumericArray.
+static void ElementByElement(DslValue *left, OPCODES op, DslValue *right)
+{
+    List<KeyData *> keyDataLeft = left->indexes.GetKeyData();
+    if ( right->type != COLLECTION )
+    {
+        for (int ii = 0; ii < keyDataLeft.Count(); ++ii)
+        {
+            ((DslValue *) keyDataLeft[ii]->Data())->BinaryOperation(op, right);
+        }
+        return;
+    }
+    List<KeyData *> keyDataRight = right->indexes.GetKeyData();
+    for(int ii=0; ii<keyDataLeft.Count(); ++ii)
+    {
+        if ( ((DslValue *)keyDataLeft[ii]->Data())->type != ((DslValue *)keyDataRight[ii]->Data())->type )
+        {
+            return;
+        }
+    }
+    for(int ii=0; ii<keyDataLeft.Count(); ++ii)
+    {
+        ((DslValue *)keyDataLeft[ii]->Data())->BinaryOperation(op, (DslValue *)keyDataRight[ii]->Data());
+    }
+}
+
+bool IntegerOperations()
+{
+    total_run++;
+    printf("Integer operations test.\n");
+
+    //Odd sizes leave elements for the scalar loop after the vector loop.
+    DslValue a;
+    MakeNumbers(&a, 11, INTEGER_VALUE);
+    DslValue b;
+    MakeNumbers(&b, 11, INTEGER_VALUE);
+    DslValue three((int64_t)3);
+
+    a.BinaryOperation(ADD, &b);
+    a.BinaryOperation(MUL, &three);
+    a.BinaryOperation(BND, &three);
+
+    bool passed = true;
+    for(int64_t ii=0; ii<11; ++ii)
+    {
+        passed = passed && Number(&a, ii)->type == INTEGER_VALUE && Number(&a, ii)->iValue == ((ii * 6) & 3)
+                 && Number(&b, ii)->iValue == ii;
+    }
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool DoubleOperations()
+{
+    total_run++;
+    printf("Double operations test.\n");
+
+    DslValue a;
+    MakeNumbers(&a, 13, DOUBLE_VALUE);
+    DslValue b;
+    b.SAV(&a);
+    DslValue two((int64_t)2);
+
+    //The integer is converted to the type of the elements the same as for each element.
+    a.BinaryOperation(DIV, &two);
+    a.BinaryOperation(SUB, &b);
+
+    bool passed = two.type == DOUBLE_VALUE;
+    for(int64_t ii=0; ii<13; ++ii)
+    {
+        passed = passed && Number(&a, ii)->type == DOUBLE_VALUE && Number(&a, ii)->dValue == -(double)ii / 2.0
+                 && Number(&b, ii)->dValue == (double)ii;
+    }
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool MixedOperations()
+{
+    total_run++;
+    printf("Mixed operations test.\n");
+
+    //Elements after the first one of another type are changed element by element.
+    int64_t total = NUMERIC_ARRAY_BLOCK + 10;
+    DslValue a;
+    MakeNumbers(&a, total, INTEGER_VALUE);
+    Number(&a, NUMERIC_ARRAY_BLOCK + 4)->Convert(DOUBLE_VALUE);
+    DslValue one((int64_t)1);
+    a.BinaryOperation(ADD, &one);
+
+    NumericArray values;
+    bool passed = values.Load(&a.indexes, 0, INTEGER_VALUE) == NUMERIC_ARRAY_BLOCK
+                  && values.Load(&a.indexes, NUMERIC_ARRAY_BLOCK, INTEGER_VALUE) == 4
+                  && values.Load(&a.indexes, NUMERIC_ARRAY_BLOCK, DOUBLE_VALUE) == 0;
+    for(int64_t ii=0; ii<total; ++ii)
+    {
+        TokenTypes type = ii == NUMERIC_ARRAY_BLOCK + 4 ? DOUBLE_VALUE : INTEGER_VALUE;
+        passed = passed && Number(&a, ii)->type == type
+                 && (type == INTEGER_VALUE ? Number(&a, ii)->iValue == ii + 1 : Number(&a, ii)->dValue == (double)(ii + 1));
+    }
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool MathFunctions()
+{
+    total_run++;
+    printf("Math functions test.\n");
+
+    DslValue a;
+    MakeNumbers(&a, 9, INTEGER_VALUE);
+    a.BinaryOperation(MUL, &a);
+    a.indexes.Detach();
+    NumericArray::Apply(&a, NumericArray::SquareRoot);
+
+    DslValue b;
+    MakeNumbers(&b, 9, DOUBLE_VALUE);
+    DslValue four((int64_t)4);
+    b.BinaryOperation(SUB, &four);
+    NumericArray::Apply(&b, NumericArray::Absolute);
+
+    DslValue c;
+    MakeNumbers(&c, 9, DOUBLE_VALUE);
+    NumericArray::Apply(&c, sin);
+
+    bool passed = true;
+    for(int64_t ii=0; ii<9; ++ii)
+    {
+        passed = passed && Number(&a, ii)->type == DOUBLE_VALUE && Number(&a, ii)->dValue == (double)ii
+                 && Number(&b, ii)->dValue == fabs((double)ii - 4.0) && Number(&c, ii)->dValue == sin((double)ii);
+    }
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool NumericArraySpeed()
+{
+    total_run++;
+    printf("Numeric array speed test.\n");
+
+    int64_t total = 100000;
+    DslValue a;
+    MakeNumbers(&a, total, DOUBLE_VALUE);
+    DslValue b;
+    MakeNumbers(&b, total, DOUBLE_VALUE);
+    DslValue c;
+    MakeNumbers(&c, total, DOUBLE_VALUE);
+    DslValue scale((int64_t)3);
+    scale.Convert(DOUBLE_VALUE);
+
+    double start = (double)clock()/(double)CLOCKS_PER_SEC;
+    a.BinaryOperation(MUL, &scale);
+    a.BinaryOperation(ADD, &b);
+    double middle = (double)clock()/(double)CLOCKS_PER_SEC;
+    ElementByElement(&c, MUL, &scale);
+    ElementByElement(&c, ADD, &b);
+    double end = (double)clock()/(double)CLOCKS_PER_SEC;
+    printf("a * 3 + b on %lld doubles : numeric array %f, element by element %f\n",
+           total, middle - start, end - middle);
+
+    bool passed = true;
+    for(int64_t ii=0; ii<total; ++ii)
+    {
+        passed = passed && Number(&a, ii)->dValue == 4.0 * (double)ii && Number(&c, ii)->dValue == 4.0 * (double)ii;
+    }
+
+    start = (double)clock()/(double)CLOCKS_PER_SEC;
+    NumericArray::Apply(&a, NumericArray::SquareRoot);
+    end = (double)clock()/(double)CLOCKS_PER_SEC;
+    printf("sqrt on %lld doubles : %f\n", total, end - start);
+
+    if ( !passed )
+    {
+        total_failed++;
+        return false;
+    }
+
+    total_passed++;
+    return true;
+}
+
+bool RunAllNumericArrayTests()
+{
+    total_passed = 0;
+    total_failed = 0;
+    total_run = 0;
+
+    IntegerOperations();
+    DoubleOperations();
+    MixedOperations();
+    MathFunctions();
+    NumericArraySpeed();
+
+    printf("Total Numeric Array Tests Run: %lld, Total Passed: %lld, Total Failed: %lld\n", total_run, total_passed, total_failed);
+
+    return true;
+}
@@ -6,6 +6,7 @@
 #include <cstdio>
 #include "../../Includes/Hashmap.h"
 #include <cstdlib>
+#include <ctime>
 
 extern int64_t total_passed;
 extern int64_t total_failed;
@@ -40,6 +41,254 @@ void CreateMany()
     total_passed++;
 }
 
+void SmallAndLarge()
+{
+    total_run++;
+
+    //U8STRING_INLINE_SIZE bytes fit inside the string, one more moves them to the heap.
+    U8String u8String;
+    char sz[U8STRING_INLINE_SIZE + 2] = {};
+    for(int64_t ii=0; ii<U8STRING_INLINE_SIZE + 1; ++ii)
+    {
+        sz[ii] = (char)('a' + ii);
+        u8String.push_back((u8chr)sz[ii]);
+        if ( !u8String.IsEqual(sz) || u8String.Count() != ii + 1 || !u8String.IsAscii() )
+        {
+            total_failed++;
+            return;
+        }
+    }
+
+    //Appending a string to itself reads the text that is moved when the buffer grows.
+    U8String copy(u8String);
+    u8String.Append(&u8String);
+    if ( u8String.Count() != 2 * (U8STRING_INLINE_SIZE + 1) || u8String.IndexOf(&copy, false) != 0
+         || u8String.get(U8STRING_INLINE_SIZE + 1) != 'a' || !copy.IsEqual(sz) )
+    {
+        total_failed++;
+        return;
+    }
+
+    u8String.Clear();
+    if ( !u8String.IsEmpty() || u8String.cStr()[0] != '\0' )
+    {
+        total_failed++;
+        return;
+    }
+
+    total_passed++;
+}
+
+void Utf8Characters()
+{
+    total_run++;
+
+    //Characters of one to four bytes are counted as one character each.
+    U8String u8String("a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80z");
+    if ( u8String.Count() != 5 || u8String.Length() != 11 || u8String.IsAscii()
+         || u8String.get(1) != 0xE9 || u8String.get(2) != 0x20AC || u8String.get(3) != 0x1F600
+         || u8String.get(4) != 'z' || u8String.IndexOf((u8chr)0x20AC) != 2 )
+    {
+        total_failed++;
+        return;
+    }
+
+    //Replacing a character with one of another length moves the characters after it.
+    u8String.set(2, 'e');
+    u8String.set(0, 0xE9);
+    u8String.set(5, '!');
+    if ( !u8String.IsEqual("\xC3\xA9\xC3\xA9" "e\xF0\x9F\x98\x80z!") || u8String.Count() != 6
+         || u8String.get(3) != 0x1F600 || u8String.set(7, 'x') )
+    {
+        total_failed++;
+        return;
+    }
+
+    //A byte that does not start a valid character is added as the character with its value.
+    U8String invalid("a\xE9z");
+    u8chr characters[3];
+    invalid.GetBuffer(characters);
+    if ( invalid.Count() != 3 || characters[1] != 0xE9 || !invalid.IsEqual("a\xC3\xA9z") )
+    {
+        total_failed++;
+        return;
+    }
+
+    total_passed++;
+}
+
+void BuildLargeString()
+{
+    total_run++;
+
+    //10MB built from 100 byte lines, the buffer doubles as it grows so each byte is copied a
+    //small number of times.
+    U8String line("0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789");
+    U8String u8String;
+    double start = (double)clock()/(double)CLOCKS_PER_SEC;
+    for(int64_t ii=0; ii<100000; ++ii)
+    {
+        u8String.Append(&line);
+    }
+    double middle = (double)clock()/(double)CLOCKS_PER_SEC;
+    U8String formatted;
+    for(int64_t ii=0; ii<1000000; ++ii)
+    {
+        formatted.printf(true, (char *)"%06lld,\n", ii);
+    }
+    double end = (double)clock()/(double)CLOCKS_PER_SEC;
+    printf("10MB by Append %f, 8MB by printf %f\n", middle - start, end - middle);
+
+    if ( u8String.Length() != 10000000 || u8String.get(9999999) != '9' || formatted.Length() != 8000000
+         || !formatted.CompareAt("999999,", false, 7, 7999992) )
+    {
+        total_failed++;
+        return;
+    }
+
+    total_passed++;
+}
+
+/// \desc Gets the index of a string in another one a character at a time, only used to check
+///       and compare times with IndexOf.
+static int64_t IndexOfByCharacter(U8String *u8String, U8String *search, bool ignoreCase)
+{
+    for(int64_t ii=0; ii + search->Count() <= u8String->Count(); ++ii)
+    {
+        int64_t jj = 0;
+        for(; jj<search->Count(); ++jj)
+        {
+            u8chr ch = u8String->get(ii + jj);
+            u8chr ch1 = search->get(jj);
+            if ( ignoreCase )
+            {
+                ch = ch < 0x80 ? tolower((int)ch) : ch;
+                ch1 = ch1 < 0x80 ? tolower((int)ch1) : ch1;
+            }
+            if ( ch != ch1 )
+            {
+                break;
+            }
+        }
+        if ( jj == search->Count() )
+        {
+            return ii;
+        }
+    }
+
+    return -1;
+}
+
+void VectorOperations()
+{
+    total_run++;
+
+    //Lengths that are not multiples of the vector size leave bytes for the scalar loops, the
+    //match is moved through every position of the blocks.
+    bool passed = true;
+    for(int64_t len=1; len<80 && passed; len += 3)
+    {
+        for(int64_t at=0; at<len && passed; ++at)
+        {
+            U8String u8String;
+            for(int64_t ii=0; ii<len; ++ii)
+            {
+                u8String.push_back(ii == at ? 'Q' : 'a' + (ii % 7));
+            }
+            U8String other(&u8String);
+            other.set(at, 'R');
+            U8String search;
+            search.CopyFrom(&u8String, at, 3);
+            U8String upper(&search);
+            upper.ToUpper();
+
+            passed = !u8String.IsEqual(&other) && u8String.IsLess(&other) && other.IsGreater(&u8String)
+                     && u8String.IndexOf(&search, false) == IndexOfByCharacter(&u8String, &search, false)
+                     && u8String.IndexOf(&upper, true) == IndexOfByCharacter(&u8String, &upper, true)
+                     && u8String.IndexOf((u8chr)'Q') == at
+                     && u8String.CompareAt(upper.cStr(), true, upper.Count(), at)
+                     && !u8String.CompareAt("R", false, 1, at);
+        }
+    }
+
+    //Characters of more than one byte are searched as their bytes and the index is converted
+    //back to a character index.
+    U8String u8String("  \t\xE2\x82\xAC abc \xC3\xA9 ABC \xE2\x82\xAC\t  ");
+    U8String search("ABC");
+    U8String euro("C \xE2\x82\xAC");
+    U8String lower(&u8String);
+    lower.ToLower();
+    if ( !passed || u8String.IndexOf(&search, false) != 11 || u8String.IndexOf(&search, true) != 5
+         || u8String.IndexOf(&search, true, 6) != 11 || u8String.IndexOf(&euro, false) != 13
+         || u8String.IndexOf((u8chr)0x20AC) != 3
+         || !lower.IsEqual("  \t\xE2\x82\xAC abc \xC3\xA9 abc \xE2\x82\xAC\t  ")
+         || u8String.SpanStart(" \t") != 3 || u8String.SpanEnd(" \t") != 3 )
+    {
+        total_failed++;
+        return;
+    }
+
+    total_passed++;
+}
+
+void VectorSpeed()
+{
+    total_run++;
+
+    //1MB strings that only differ in the last character and a search for the end of the one
+    //with a character the other does not have.
+    U8String u8String;
+    for(int64_t ii=0; ii<1000000; ++ii)
+    {
+        u8String.push_back(' ' + (ii % 90));
+    }
+    U8String other(&u8String);
+    other.set(999999, '~');
+    U8String search;
+    search.CopyFrom(&other, 999990, 10);
+    U8String spaces;
+    for(int64_t ii=0; ii<1000000; ++ii)
+    {
+        spaces.push_back(ii == 999999 ? 'x' : ' ');
+    }
+
+    double start = (double)clock()/(double)CLOCKS_PER_SEC;
+    bool equal = u8String.IsEqual(&other);
+    int64_t index = other.IndexOf(&search, true);
+    int64_t span = spaces.SpanStart(" \t");
+    U8String lower(&u8String);
+    lower.ToLower();
+    double middle = (double)clock()/(double)CLOCKS_PER_SEC;
+    bool equal1 = true;
+    for(int64_t ii=0; ii<u8String.Count() && equal1; ++ii)
+    {
+        equal1 = u8String.get(ii) == other.get(ii);
+    }
+    int64_t index1 = IndexOfByCharacter(&other, &search, true);
+    int64_t span1 = 0;
+    while( spaces.get(span1) == ' ' || spaces.get(span1) == '\t' )
+    {
+        ++span1;
+    }
+    U8String lower1;
+    for(int64_t ii=0; ii<u8String.Count(); ++ii)
+    {
+        lower1.push_back(tolower((int)u8String.get(ii)));
+    }
+    double end = (double)clock()/(double)CLOCKS_PER_SEC;
+    printf("IsEqual, IndexOf, SpanStart and ToLower on 1MB : vector %f, character by character %f\n",
+           middle - start, end - middle);
+
+    if ( equal || equal1 || index != 999990 || index1 != index || span != 999999 || span1 != span
+         || !lower.IsEqual(&lower1) )
+    {
+        total_failed++;
+        return;
+    }
+
+    total_passed++;
+}
+
 [[maybe_unused]] void RunAllStringTests()
 {
     total_passed = 0;
@@ -47,6 +296,11 @@ void CreateMany()
     total_run = 0;
 
     CreateMany();
+    SmallAndLarge();
+    Utf8Characters();
+    BuildLargeString();
+    VectorOperations();
+    VectorSpeed();
 
     printf("Total String Tests Run: %d, Total Passed: %d, Total Failed: %d\n", total_run, total_passed, total_failed);
 }
\ No newline at end of file
@@ -1,104 +1,124 @@
-dsl empty_program.dsl
-dsl test_hello_world_no_ext
-dsl assignsinglebackslash.dsl
-dsl assignsinglequote.dsl
-dsl assignstring.dsl
-dsl backspace.dsl
-dsl carriagereturn.dsl
-dsl closeblock.dsl
-dsl collection_access.dsl
-dsl constlocalassignvar.dsl
-dsl constvar.dsl
-dsl createglobalfun.dsl
-dsl createscriptfun.dsl
-dsl createsinglenamedparam.dsl
-dsl defaultassign.dsl
-dsl fact.dsl
-dsl failcreatelocalfun.dsl
-dsl failpostdecnumber.dsl
-dsl failpostincnumber.dsl
-dsl failpredecnumber.dsl
-dsl failpreincnumber.dsl
-dsl forcountdownpost.dsl
-dsl forcountuppost.dsl
-dsl forcountuppreinc.dsl
-dsl formfeed.dsl
-dsl for_post_inc.dsl
-dsl fun_return_test.dsl
-dsl globalvar.dsl
-dsl ifelsefalse.dsl
-dsl ifelseif1.dsl
-dsl ifelseif2.dsl
-dsl ifelseif3.dsl
-dsl ifelseparser001.dsl
-dsl ifelsetrue.dsl
-dsl iffalse.dsl
-dsl iftrue.dsl
-dsl instringnumber.dsl
-dsl invalidvarname.dsl
-dsl localvar.dsl
-dsl missingendparam.dsl
-dsl missingopenparam.dsl
-dsl missingstartparam.dsl
-dsl multiline1.dsl
-dsl multiline2.dsl
-dsl multiline3.dsl
-dsl multvardef.dsl
-dsl newline.dsl
-dsl openblock.dsl
-dsl parserpostincaddnumber.dsl
-dsl postdefadd2ints.dsl
-dsl postincvar.dsl
-dsl predecvar.dsl
-dsl preincwhilemultspaceinblock.dsl
-dsl simple.dsl
-dsl singlelineifelse.dsl
-dsl sub_collection.dsl
-dsl switchneg.dsl
-dsl switch1.dsl
-dsl switch2.dsl
-dsl switch3.dsl
-dsl switch4.dsl
-dsl tab.dsl
-dsl whilewithvariablelimit.dsl
-dsl findexpression.dsl
-dsl string_len.dsl
-dsl string_sub.dsl
-dsl string_replace.dsl
-dsl string_toupper.dsl
-dsl string_tolower.dsl
-dsl string_trimStart.dsl
-dsl string_trimEnd.dsl
-dsl test_dollar_double_quote_strings.dsl
-dsl collection_to_string.dsl
-dsl variable_address.dsl
-dsl read_directory.dsl
-dsl dynamically_initialize_collection.dsl
-dsl create_empty_collection.dsl
-dsl no_keys_dbl_two_ints.dsl
-dsl create_collection_three_no_key_strings.dsl
-dsl create_absolute_index_collection.dsl
-dsl create_collection_absolute_indexes_in_reverse_order.dsl
-dsl create_multiple_collections_1.dsl
-dsl create_collection_string_keys_bools_char.dsl
-dsl create_collection_3_auto_keys_3_strings.dsl
-dsl create_collection_with_empty_placeholder_elements.dsl
-dsl define_multiple_collections_inside_collection.dsl
-dsl create_collection_referencing_other_collections.dsl
-dsl collection_pass_by_value.dsl
-dsl invalid_key_specification_missing_comma_last_key.dsl
-dsl create_new_collection_from_existing_collection.dsl
-dsl json_with_neg_exponent.dsl
-dsl airfield.dsl
-dsl lookup_sample.dsl
-dsl continue_while_loop.dsl
-dsl continue_for_loop.dsl
-dsl break_while_loop.dsl
-dsl break_with_for.dsl
-dsl complex_exp_with_recursive_function_call.dsl
-dsl ifelseifelse.dsl
-dsl multi_level_switch_case.dsl
-dsl test_rtl_post_inc.dsl
-dsl test_post_dec_rtl_assoc.dsl
-dsl test_on_error_with_0_return.dsl
-dsl test_on_tick.dsl
\ No newline at end of file
+@echo off
+rem Runs every script, a script fails if its output has a parser error since the
+rem parser only reports those for code it could not compile correctly.
+set failed=0
+call :run empty_program.dsl
+call :run test_hello_world_no_ext
+call :run assignsinglebackslash.dsl
+call :run assignsinglequote.dsl
+call :run assignstring.dsl
+call :run backspace.dsl
+call :run carriagereturn.dsl
+call :run closeblock.dsl
+call :run collection_access.dsl
+call :run constlocalassignvar.dsl
+call :run constvar.dsl
+call :run createglobalfun.dsl
+call :run createscriptfun.dsl
+call :run createsinglenamedparam.dsl
+call :run defaultassign.dsl
+call :run fact.dsl
+call :run failcreatelocalfun.dsl
+call :run failpostdecnumber.dsl
+call :run failpostincnumber.dsl
+call :run failpredecnumber.dsl
+call :run failpreincnumber.dsl
+call :run forcountdownpost.dsl
+call :run forcountuppost.dsl
+call :run forcountuppreinc.dsl
+call :run formfeed.dsl
+call :run for_post_inc.dsl
+call :run fun_return_test.dsl
+call :run globalvar.dsl
+call :run ifelsefalse.dsl
+call :run ifelseif1.dsl
+call :run ifelseif2.dsl
+call :run ifelseif3.dsl
+call :run ifelseparser001.dsl
+call :run ifelsetrue.dsl
+call :run iffalse.dsl
+call :run iftrue.dsl
+call :run instringnumber.dsl
+call :run invalidvarname.dsl
+call :run localvar.dsl
+call :run missingendparam.dsl
+call :run missingopenparam.dsl
+call :run missingstartparam.dsl
+call :run multiline1.dsl
+call :run multiline2.dsl
+call :run multiline3.dsl
+call :run multvardef.dsl
+call :run newline.dsl
+call :run openblock.dsl
+call :run parserpostincaddnumber.dsl
+call :run postdefadd2ints.dsl
+call :run postincvar.dsl
+call :run predecvar.dsl
+call :run preincwhilemultspaceinblock.dsl
+call :run simple.dsl
+call :run singlelineifelse.dsl
+call :run sub_collection.dsl
+call :run switchneg.dsl
+call :run switch1.dsl
+call :run switch2.dsl
+call :run switch3.dsl
+call :run switch4.dsl
+call :run tab.dsl
+call :run whilewithvariablelimit.dsl
+call :run findexpression.dsl
+call :run string_len.dsl
+call :run string_sub.dsl
+call :run string_replace.dsl
+call :run string_toupper.dsl
+call :run string_tolower.dsl
+call :run string_trimStart.dsl
+call :run string_trimEnd.dsl
+call :run test_dollar_double_quote_strings.dsl
+call :run collection_to_string.dsl
+call :run variable_address.dsl
+call :run read_directory.dsl
+call :run dynamically_initialize_collection.dsl
+call :run create_empty_collection.dsl
+call :run no_keys_dbl_two_ints.dsl
+call :run create_collection_three_no_key_strings.dsl
+call :run create_absolute_index_collection.dsl
+call :run create_collection_absolute_indexes_in_reverse_order.dsl
+call :run create_multiple_collections_1.dsl
+call :run create_collection_string_keys_bools_char.dsl
+call :run create_collection_3_auto_keys_3_strings.dsl
+call :run create_collection_with_empty_placeholder_elements.dsl
+call :run define_multiple_collections_inside_collection.dsl
+call :run create_collection_referencing_other_collections.dsl
+call :run collection_pass_by_value.dsl
+call :run invalid_key_specification_missing_comma_last_key.dsl
+call :run create_new_collection_from_existing_collection.dsl
+call :run json_with_neg_exponent.dsl
+call :run airfield.dsl
+call :run lookup_sample.dsl
+call :run continue_while_loop.dsl
+call :run continue_for_loop.dsl
+call :run break_while_loop.dsl
+call :run break_with_for.dsl
+call :run complex_exp_with_recursive_function_call.dsl
+call :run ifelseifelse.dsl
+call :run multi_level_switch_case.dsl
+call :run test_rtl_post_inc.dsl
+call :run test_post_dec_rtl_assoc.dsl
+call :run test_on_error_with_0_return.dsl
+call :run test_on_tick.dsl
+call :run foreach_collection.dsl
+call :run on_tick.dsl -v2 -i 10
+call :run on_tick.dsl -v1 -f 1000 -i 10
+call :run collection_defined_after_change.dsl
+call :run on_error_in_function.dsl
+echo %failed% script(s) with parser errors
+exit /b %failed%
+
+:run
+dsl %* > "%TEMP%\dsl_script_output.txt" 2>&1
+type "%TEMP%\dsl_script_output.txt"
+findstr /C:"Parser error" "%TEMP%\dsl_script_output.txt" > nul && (
+    echo FAILED %1
+    set /a failed+=1
+)
+exit /b 0
\ No newline at end of file